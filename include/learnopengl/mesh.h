@@ -7,7 +7,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/GLExt.h>
+#include <rg/GpuResources.h>
+#include <rg/Material.h>
+#include <rg/Profiler.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 using namespace std;
@@ -27,10 +32,18 @@ struct Vertex {
 
 
 
+// per-instance data read by instanced shaders from vertex attributes 5-8 (model matrix columns) and 9 (tint)
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec4 tint;
+};
+
 struct Texture {
     unsigned int id;
     string type;
     string path;
+    // keeps the texture alive while any mesh or model still refers to it
+    rg::GpuRef resource;
 };
 
 class Mesh {
@@ -39,9 +52,12 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    // per-vertex irradiance from rg::LightBaker with alpha 1, empty when the mesh was not baked
+    vector<glm::vec4>    bakedLight;
 
-    unsigned int VAO;
-    std::string glslIdentifierPrefix;
+    rg::GpuRef VAO;
+    // shared with every other mesh that uses the same textures, see rg::MaterialLibrary
+    std::shared_ptr<const rg::Material> material;
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
     {
@@ -51,59 +67,115 @@ public:
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
+        setupMaterial();
     }
 
     // render the mesh
     void Draw(Shader &shader)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
-
-
+        material->Bind();
 
         // draw mesh
         glBindVertexArray(VAO);
         glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        rg::frameStats.drawCalls++;
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // render instanceCount copies of the mesh in one draw call, reading InstanceData from the buffer attached with
+    // SetInstanceBuffer
+    void DrawInstanced(Shader &shader, unsigned int instanceCount)
+    {
+        material->Bind();
+
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, instanceCount);
+        rg::frameStats.drawCalls++;
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // like DrawInstanced, but the instance count comes from the DrawElementsIndirectCommand at indirectOffset in the
+    // bound GL_DRAW_INDIRECT_BUFFER, written on the GPU
+    void DrawIndirect(Shader &shader, GLintptr indirectOffset)
+    {
+        material->Bind();
+
+        glBindVertexArray(VAO);
+        glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)indirectOffset);
+        rg::frameStats.drawCalls++;
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // points the per-instance attributes of this mesh's VAO at a buffer of InstanceData
+    void SetInstanceBuffer(unsigned int buffer)
+    {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        // a mat4 attribute takes four consecutive locations, one column each
+        for (unsigned int column = 0; column < 4; column++) {
+            glEnableVertexAttribArray(5 + column);
+            glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + column, 1);
+        }
+        glEnableVertexAttribArray(9);
+        glVertexAttribPointer(9, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, tint));
+        glVertexAttribDivisor(9, 1);
+        glBindVertexArray(0);
+    }
+
+    // stores the baked light and feeds it to vertex attribute 10; meshes without it read the attribute's current
+    // value, which main sets to zero
+    void SetBakedLight(const vector<glm::vec4> &light)
+    {
+        bakedLight = light;
+        bakedLightVBO = rg::GpuRef(rg::GPU_BUFFER);
+        bakedLightVBO.SetBytes(light.size() * sizeof(glm::vec4));
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, bakedLightVBO);
+        glBufferData(GL_ARRAY_BUFFER, light.size() * sizeof(glm::vec4), light.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(10);
+        glVertexAttribPointer(10, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+        glBindVertexArray(0);
+    }
+
 private:
     // render data
-    unsigned int VBO, EBO;
+    rg::GpuRef VBO, EBO, bakedLightVBO;
+
+    // the first texture of each type is the one shaders sample as texture_<type>1
+    void setupMaterial()
+    {
+        rg::Material textureSet;
+        for (int i = textures.size() - 1; i >= 0; i--) {
+            const string &type = textures[i].type;
+            if (type == "texture_diffuse")
+                textureSet.textures[rg::DIFFUSE_UNIT] = textures[i].id;
+            else if (type == "texture_specular")
+                textureSet.textures[rg::SPECULAR_UNIT] = textures[i].id;
+            else if (type == "texture_normal")
+                textureSet.textures[rg::NORMAL_UNIT] = textures[i].id;
+            else if (type == "texture_height")
+                textureSet.textures[rg::HEIGHT_UNIT] = textures[i].id;
+        }
+        material = rg::materialLibrary.Get(textureSet);
+    }
 
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
         // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        VAO = rg::GpuRef(rg::GPU_VERTEX_ARRAY);
+        VBO = rg::GpuRef(rg::GPU_BUFFER);
+        EBO = rg::GpuRef(rg::GPU_BUFFER);
+        VBO.SetBytes(vertices.size() * sizeof(Vertex));
+        EBO.SetBytes(indices.size() * sizeof(unsigned int));
 
         glBindVertexArray(VAO);
         // load data into vertex buffers
@@ -21,7 +21,7 @@
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+rg::GpuRef TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
 
 
@@ -32,10 +32,12 @@ public:
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
     string directory;
+    string path;
     bool gammaCorrection;
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // constructor, expects a filepath to a 3D model. The GL objects of the model are released with the last copy of
+    // its meshes and textures (see rg::GpuResourceManager)
+    Model(string const &path, bool gamma = false) : path(path), gammaCorrection(gamma)
     {
         loadModel(path);
     }
@@ -47,12 +49,60 @@ public:
             meshes[i].Draw(shader);
     }
 
-    void SetShaderTextureNamePrefix(std::string prefix) {
-        for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+    // draws count copies of the model with one draw call per mesh; the shader reads InstanceData from vertex
+    // attributes 5-9 (see model_lighting_instanced.vs)
+    void DrawInstanced(Shader &shader, const InstanceData *instances, unsigned int count)
+    {
+        if (count == 0)
+            return;
+        // orphan the previous contents so the upload never waits for draws still reading them
+        glBindBuffer(GL_ARRAY_BUFFER, InstanceBuffer());
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+        instanceBuffer.SetBytes(count * sizeof(InstanceData));
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), instances);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, count);
+    }
+
+    void DrawInstanced(Shader &shader, const vector<InstanceData> &instances)
+    {
+        DrawInstanced(shader, instances.data(), instances.size());
+    }
+
+    // draws count instances of every mesh without uploading anything: the first count instances of the last upload
+    // again (e.g. with a depth-only shader), or one copy per view for multi-view shaders (see view.glsl)
+    void DrawInstanced(Shader &shader, unsigned int count)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, count);
+    }
+
+    // draws every mesh with the instance count of its own command in commandBuffer (one DrawElementsIndirectCommand
+    // per mesh, in mesh order); used when the instances in InstanceBuffer() were written on the GPU
+    void DrawInstancedIndirect(Shader &shader, unsigned int commandBuffer)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawIndirect(shader, i * sizeof(rg::DrawElementsIndirectCommand));
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    // buffer of InstanceData read by the instanced draws, created and attached to every mesh on first use
+    const rg::GpuRef &InstanceBuffer()
+    {
+        if (instanceBuffer == 0) {
+            instanceBuffer = rg::GpuRef(rg::GPU_BUFFER);
+            for (Mesh &mesh: meshes)
+                mesh.SetInstanceBuffer(instanceBuffer);
         }
+        return instanceBuffer;
     }
 private:
+    // per-instance data for DrawInstanced, created on first use
+    rg::GpuRef instanceBuffer;
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
@@ -205,7 +255,8 @@ private:
             if(!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                texture.resource = TextureFromFile(str.C_Str(), this->directory);
+                texture.id = texture.resource;
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
@@ -217,13 +268,12 @@ private:
 };
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+rg::GpuRef TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    rg::GpuRef textureID(rg::GPU_TEXTURE);
 
     int width, height, nrComponents;
     unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
@@ -240,6 +290,7 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
         glBindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
+        textureID.SetBytes(rg::TextureBytes(width, height, nrComponents, 1, true));
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
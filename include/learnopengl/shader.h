@@ -9,6 +9,9 @@
 #include <sstream>
 #include <iostream>
 #include <common.h>
+#include <rg/GLExt.h>
+#include <rg/GpuResources.h>
+#include <rg/Profiler.h>
 class Shader
 {
 public:
@@ -26,38 +29,17 @@ public:
         std::string vertexCode;
         std::string fragmentCode;
         std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
         try 
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
+            // read files, expanding #include directives
+            vertexCode = readShaderSource(vertexPath);
+            fragmentCode = readShaderSource(fragmentPath);
             // if geometry shader path is present, also load a geometry shader
             if(geometryPath != nullptr)
             {
                 std::string geometryPathString(geometryPath);
                 geometryPath = geometryPathString.c_str();
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
+                geometryCode = readShaderSource(geometryPath);
             }
         }
         catch (std::ifstream::failure& e)
@@ -89,7 +71,8 @@ public:
             checkCompileErrors(geometry, "GEOMETRY");
         }
         // shader Program
-        ID = glCreateProgram();
+        program = rg::GpuRef(rg::GPU_PROGRAM);
+        ID = program;
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
         if(geometryPath != nullptr)
@@ -103,6 +86,31 @@ public:
             glDeleteShader(geometry);
 
     }
+    // compute shader program, needs GL 4.3 (rg::glCaps.computeShader)
+    // ------------------------------------------------------------------------
+    explicit Shader(const char* computePath)
+    {
+        std::string computeCode;
+        try
+        {
+            computeCode = readShaderSource(computePath);
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        }
+        const char* cShaderCode = computeCode.c_str();
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, NULL);
+        glCompileShader(compute);
+        checkCompileErrors(compute, "COMPUTE");
+        program = rg::GpuRef(rg::GPU_PROGRAM);
+        ID = program;
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        glDeleteShader(compute);
+    }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
@@ -114,61 +122,128 @@ public:
     void setBool(const std::string &name, bool value) const
     {         
         glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        rg::frameStats.uniformCalls++;
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
         glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        rg::frameStats.uniformCalls++;
+    }
+    // ------------------------------------------------------------------------
+    void setUInt(const std::string &name, unsigned int value) const
+    {
+        glUniform1ui(glGetUniformLocation(ID, name.c_str()), value);
+        rg::frameStats.uniformCalls++;
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
         glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        rg::frameStats.uniformCalls++;
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
         glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        rg::frameStats.uniformCalls++;
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
         glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        rg::frameStats.uniformCalls++;
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
         glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        rg::frameStats.uniformCalls++;
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
         glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        rg::frameStats.uniformCalls++;
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
         glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        rg::frameStats.uniformCalls++;
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
         glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        rg::frameStats.uniformCalls++;
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
         glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        rg::frameStats.uniformCalls++;
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
         glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        rg::frameStats.uniformCalls++;
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
         glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        rg::frameStats.uniformCalls++;
+    }
+
+    // ------------------------------------------------------------------------
+    // binds a uniform block of this program to a uniform buffer binding point; blocks the program doesn't use are skipped
+    void setBlockBinding(const std::string &name, unsigned int binding) const
+    {
+        unsigned int index = glGetUniformBlockIndex(ID, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
     }
 
 private:
+    // owns the program object, ID is its GL name
+    rg::GpuRef program;
+
+    // reads a shader file and recursively inlines lines of the form #include "file", resolved relative to the
+    // including file, so that lighting code can be shared between shader variants.
+    // ------------------------------------------------------------------------
+    static std::string readShaderSource(const std::string &path, int depth = 0)
+    {
+        std::ifstream shaderFile;
+        // ensure ifstream objects can throw exceptions:
+        shaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        shaderFile.open(path);
+        std::stringstream shaderStream;
+        shaderStream << shaderFile.rdbuf();
+        shaderFile.close();
+
+        std::string directory = path.substr(0, path.find_last_of('/') + 1);
+        std::string source;
+        std::string line;
+        while (std::getline(shaderStream, line))
+        {
+            size_t directive = line.find("#include");
+            if (directive != std::string::npos && directive == line.find_first_not_of(" \t") && depth < 8)
+            {
+                size_t begin = line.find('"', directive);
+                size_t end = line.find('"', begin + 1);
+                source += readShaderSource(directory + line.substr(begin + 1, end - begin - 1), depth + 1);
+            }
+            else if (depth > 0 && line.compare(0, 8, "#version") == 0)
+            {
+                // a whole shader included by a variant that defines macros first keeps the variant's version line
+            }
+            else
+            {
+                source += line + '\n';
+            }
+        }
+        return source;
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
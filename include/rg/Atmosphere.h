@@ -0,0 +1,655 @@
+#ifndef PROJECT_BASE_ATMOSPHERE_H
+#define PROJECT_BASE_ATMOSPHERE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/Cubemap.h>
+#include <rg/GpuResources.h>
+#include <rg/Profiler.h>
+#include <rg/ShaderConstants.h>
+#include <rg/SkyIrradiance.h>
+#include <rg/SpecularEnvironment.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace rg {
+
+// Sky from a physically based atmosphere (Hillaire, "A Scalable and Production Ready Sky and Atmosphere Rendering
+// Technique"): Rayleigh and Mie scattering and ozone absorption over a planet, with the sun anywhere in the sky. Its
+// lookup tables are built on the CPU, spread over every hardware thread, on a background thread whenever the sun or
+// the haze changes:
+//   - transmittance to the top of the atmosphere by height and zenith angle (Bruneton's parameterization)
+//   - multiple scattering of every order by height and sun zenith angle, from second order scattering with an
+//     isotropic phase function and the geometric series of its energy transfer
+//   - the sky seen from the camera by azimuth from the sun and elevation, squeezed towards the horizon; the scene is
+//     a few hundred metres across, so the camera height is fixed at CAMERA_HEIGHT
+// Only the last depends on the sun, the first two are built again only when the haze changes. atmosphere.vs/fs draw
+// the sky as a fullscreen triangle behind the scene with one fetch of the sky view table, plus the sun's disk.
+// The same job renders a CUBE_SIZE sky cubemap from the sky view table and turns it into the ambient irradiance
+// (SkyIrradiance::Project) and the prefiltered reflections (SpecularEnvironment::Prefilter); Update uploads them a
+// face per frame and the irradiance after the last face.
+// All radiance is relative to a sun of illuminance SUN_ILLUMINANCE, which puts a clear noon sky around 1.
+class Atmosphere {
+public:
+    struct Parameters {
+        // degrees above the horizon, and around the vertical from +z towards +x
+        float sunElevation = 51.0f;
+        float sunAzimuth = 60.0f;
+        // aerosol (Mie) density relative to a clear day
+        float turbidity = 1.0f;
+
+        bool operator==(const Parameters &other) const {
+            return sunElevation == other.sunElevation && sunAzimuth == other.sunAzimuth &&
+                   turbidity == other.turbidity;
+        }
+
+        bool operator!=(const Parameters &other) const {
+            return !(*this == other);
+        }
+    };
+
+    static const int TRANSMITTANCE_WIDTH = 256;
+    static const int TRANSMITTANCE_HEIGHT = 64;
+    static const int MULTIPLE_SCATTERING_SIZE = 32;
+    static const int SKY_VIEW_WIDTH = 192;
+    static const int SKY_VIEW_HEIGHT = 108;
+    static const int CUBE_SIZE = 32;
+    // units of the sky view table while the sky is drawn, the shader binds nothing else
+    static const int SKY_VIEW_UNIT = 0;
+
+    // kilometres
+    static constexpr float GROUND_RADIUS = 6360.0f;
+    static constexpr float TOP_RADIUS = 6460.0f;
+    static constexpr float CAMERA_HEIGHT = 0.2f;
+    static constexpr float SUN_ILLUMINANCE = 30.0f;
+    // angular radius of the sun's disk; its radiance is far below the real sun's, just enough to bloom
+    static constexpr float SUN_ANGULAR_RADIUS = 0.0047f;
+    static constexpr float SUN_DISK_RADIANCE = 40.0f;
+
+    ~Atmosphere() {
+        if (worker.joinable())
+            worker.join();
+    }
+
+    // threads 0 uses one per hardware thread
+    void Init(unsigned threads = 0) {
+        threadCount = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+        skyView = createTexture(GL_TEXTURE_2D, SKY_VIEW_WIDTH, SKY_VIEW_HEIGHT);
+        skyCubemap = GpuRef(GPU_TEXTURE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, skyCubemap);
+        for (int face = 0; face < 6; face++) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB16F, CUBE_SIZE, CUBE_SIZE, 0, GL_RGB,
+                         GL_FLOAT, nullptr);
+        }
+        setLinear(GL_TEXTURE_CUBE_MAP);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        skyCubemap.SetBytes(TextureBytes(CUBE_SIZE, CUBE_SIZE, 8) * 6);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        // the fullscreen triangle comes from gl_VertexID, core profiles still need a vertex array bound
+        emptyVAO = GpuRef(GPU_VERTEX_ARRAY);
+    }
+
+    static void SetSamplers(Shader &shader) {
+        shader.use();
+        shader.setInt("skyView", SKY_VIEW_UNIT);
+    }
+
+    // called every frame the atmosphere is in use: takes a finished build (true when it did, the sun may have
+    // moved), starts one when parameters differ from the last one started, and uploads the next face of the sky
+    // cubemap and reflections, or the irradiance after the last face
+    bool Update(const Parameters &parameters, SkyIrradiance &irradiance, const SpecularEnvironment &environment) {
+        bool taken = false;
+        if (building && jobDone) {
+            worker.join();
+            building = false;
+            current = std::move(job);
+            hasResult = true;
+            nextFace = 0;
+            taken = true;
+            glBindTexture(GL_TEXTURE_2D, skyView);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SKY_VIEW_WIDTH, SKY_VIEW_HEIGHT, GL_RGB, GL_FLOAT,
+                            current.skyView.data());
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        if (!building && (!hasResult || parameters != current.parameters))
+            start(parameters, environment);
+        if (hasResult && nextFace < 6) {
+            glBindTexture(GL_TEXTURE_CUBE_MAP, skyCubemap);
+            glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + nextFace, 0, 0, 0, CUBE_SIZE, CUBE_SIZE, GL_RGB,
+                            GL_FLOAT, &current.cube[(size_t) nextFace * CUBE_SIZE * CUBE_SIZE * 3]);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+            environment.UploadFace(current.environment, nextFace);
+            if (++nextFace == 6)
+                irradiance.Upload(current.irradiance);
+        }
+        return taken;
+    }
+
+    // the skybox's irradiance and reflections are back in use; the next Update uploads the atmosphere's again
+    void Suspend() {
+        nextFace = 0;
+    }
+
+    // whether a build finished, before that there is nothing to draw
+    bool Ready() const {
+        return hasResult;
+    }
+
+    // writes the sun and horizon atmosphere.fs reads from FrameBlock; they only change with a build taken
+    void SetFrameConstants(FrameConstants &frame) const {
+        frame.skySun = glm::vec4(current.sunDirection, horizonElevation());
+        frame.sunDisk = glm::vec4(current.sunColor * SUN_DISK_RADIANCE, std::cos(SUN_ANGULAR_RADIUS));
+    }
+
+    // draws the sky behind everything drawn so far in every view, with the shader's FrameBlock (SetFrameConstants)
+    void Draw(Shader &shader, int viewCount) const {
+        shader.use();
+        glActiveTexture(GL_TEXTURE0 + SKY_VIEW_UNIT);
+        glBindTexture(GL_TEXTURE_2D, skyView);
+        glDepthFunc(GL_LEQUAL);
+        glBindVertexArray(emptyVAO);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 3, viewCount);
+        frameStats.drawCalls++;
+        glBindVertexArray(0);
+        glDepthFunc(GL_LESS);
+    }
+
+    // the sky as a cubemap in the skybox's orientation, for draws that use the skybox shader
+    GLuint SkyCubemap() const {
+        return skyCubemap;
+    }
+
+    // towards the sun, of the last build taken
+    glm::vec3 SunDirection() const {
+        return current.sunDirection;
+    }
+
+    // sunlight at the camera relative to a sun at the zenith, black below the horizon
+    glm::vec3 SunColor() const {
+        return current.sunColor;
+    }
+
+    // average luminance of the sky above the horizon relative to the sky under a sun at the zenith
+    float SkyBrightness() const {
+        return current.skyBrightness;
+    }
+
+    bool Building() const {
+        return building;
+    }
+
+    // faces of the sky cubemap still to upload
+    int FacesPending() const {
+        return hasResult ? 6 - nextFace : 0;
+    }
+
+    // times of the last build taken: the two sun independent tables (0 when they were reused), the sky view table,
+    // and the cubemap with its irradiance and reflections
+    float TablesMilliseconds() const {
+        return current.tablesMilliseconds;
+    }
+
+    float SkyViewMilliseconds() const {
+        return current.skyViewMilliseconds;
+    }
+
+    float CubemapMilliseconds() const {
+        return current.cubemapMilliseconds;
+    }
+
+    unsigned Threads() const {
+        return threadCount;
+    }
+
+private:
+    static constexpr float PI = 3.14159265f;
+    static constexpr float RAYLEIGH_HEIGHT = 8.0f;
+    static constexpr float MIE_HEIGHT = 1.2f;
+    static constexpr float MIE_SCATTERING = 3.996e-3f;
+    static constexpr float MIE_EXTINCTION = 4.44e-3f;
+    static constexpr float MIE_G = 0.8f;
+    static constexpr float GROUND_ALBEDO = 0.3f;
+    static const int TRANSMITTANCE_STEPS = 40;
+    static const int MULTIPLE_SCATTERING_STEPS = 20;
+    // directions of the multiple scattering integral, a square number
+    static const int MULTIPLE_SCATTERING_DIRECTIONS = 64;
+    static const int SKY_VIEW_STEPS = 32;
+
+    // RGB table, sampled bilinearly with clamped coordinates in [0, 1]
+    struct Table {
+        int width = 0;
+        int height = 0;
+        std::vector<float> texels;
+
+        void Resize(int w, int h) {
+            width = w;
+            height = h;
+            texels.assign((size_t) w * h * 3, 0.0f);
+        }
+
+        void Set(int x, int y, const glm::vec3 &value) {
+            float *texel = &texels[((size_t) y * width + x) * 3];
+            texel[0] = value.r;
+            texel[1] = value.g;
+            texel[2] = value.b;
+        }
+
+        glm::vec3 Sample(float u, float v) const {
+            float x = glm::clamp(u * width - 0.5f, 0.0f, width - 1.0f);
+            float y = glm::clamp(v * height - 0.5f, 0.0f, height - 1.0f);
+            int x0 = (int) x, y0 = (int) y;
+            int x1 = std::min(x0 + 1, width - 1), y1 = std::min(y0 + 1, height - 1);
+            float fx = x - x0, fy = y - y0;
+            glm::vec3 top = glm::mix(texel(x0, y0), texel(x1, y0), fx);
+            glm::vec3 bottom = glm::mix(texel(x0, y1), texel(x1, y1), fx);
+            return glm::mix(top, bottom, fy);
+        }
+
+        glm::vec3 texel(int x, int y) const {
+            const float *t = &texels[((size_t) y * width + x) * 3];
+            return glm::vec3(t[0], t[1], t[2]);
+        }
+    };
+
+    // scattering and extinction per kilometre at a height
+    struct Medium {
+        glm::vec3 rayleigh;
+        float mie;
+        glm::vec3 extinction;
+    };
+
+    // everything a build needs and makes; a build only touches its own
+    struct Result {
+        Parameters parameters;
+        Table transmittance;
+        Table multipleScattering;
+        // average sky luminance under a sun at the zenith, the reference of skyBrightness
+        float zenithSkyLuminance = 0.0f;
+        Table skyViewTable;
+        std::vector<float> skyView;
+        std::vector<float> cube;
+        glm::vec3 irradiance[SH_COEFFICIENTS];
+        std::vector<std::vector<float>> environment;
+        glm::vec3 sunDirection = glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 sunColor = glm::vec3(1.0f);
+        float skyBrightness = 1.0f;
+        float tablesMilliseconds = 0.0f;
+        float skyViewMilliseconds = 0.0f;
+        float cubemapMilliseconds = 0.0f;
+    };
+
+    unsigned threadCount = 1;
+    GpuRef skyView;
+    GpuRef skyCubemap;
+    GpuRef emptyVAO;
+    Result current;
+    Result job;
+    std::thread worker;
+    std::atomic<bool> jobDone{false};
+    bool building = false;
+    bool hasResult = false;
+    int nextFace = 6;
+
+    void start(const Parameters &parameters, const SpecularEnvironment &environment) {
+        bool reuseTables = hasResult && parameters.turbidity == current.parameters.turbidity;
+        job.parameters = parameters;
+        if (reuseTables) {
+            job.transmittance = current.transmittance;
+            job.multipleScattering = current.multipleScattering;
+            job.zenithSkyLuminance = current.zenithSkyLuminance;
+        }
+        building = true;
+        jobDone = false;
+        const SpecularEnvironment *target = &environment;
+        worker = std::thread([this, reuseTables, target]() {
+            build(job, !reuseTables, *target, threadCount);
+            jobDone = true;
+        });
+    }
+
+    static float seconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // calls work(row) for every row on threads threads
+    template<typename Work>
+    static void parallelRows(int rows, unsigned threads, Work work) {
+        std::atomic<int> nextRow(0);
+        auto run = [&]() {
+            int row;
+            while ((row = nextRow.fetch_add(1)) < rows)
+                work(row);
+        };
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < threads; i++)
+            workers.emplace_back(run);
+        run();
+        for (std::thread &thread: workers)
+            thread.join();
+    }
+
+    static void build(Result &result, bool tables, const SpecularEnvironment &environment, unsigned threads) {
+        const Parameters &parameters = result.parameters;
+        float elevation = glm::radians(parameters.sunElevation), azimuth = glm::radians(parameters.sunAzimuth);
+        result.sunDirection = glm::vec3(std::cos(elevation) * std::sin(azimuth), std::sin(elevation),
+                                        std::cos(elevation) * std::cos(azimuth));
+
+        auto start = std::chrono::steady_clock::now();
+        result.tablesMilliseconds = 0.0f;
+        if (tables) {
+            buildTransmittance(result, threads);
+            buildMultipleScattering(result, threads);
+            // a small sky view under a sun at the zenith for the brightness reference
+            Table zenithSky;
+            buildSkyView(result, 1.0f, SKY_VIEW_WIDTH / 4, SKY_VIEW_HEIGHT / 4, threads, zenithSky);
+            result.zenithSkyLuminance = skyLuminance(zenithSky);
+            result.tablesMilliseconds = seconds(start);
+        }
+
+        start = std::chrono::steady_clock::now();
+        buildSkyView(result, result.sunDirection.y, SKY_VIEW_WIDTH, SKY_VIEW_HEIGHT, threads, result.skyViewTable);
+        result.skyView = result.skyViewTable.texels;
+        glm::vec3 sunTransmittance = transmittanceTo(result, GROUND_RADIUS + CAMERA_HEIGHT, result.sunDirection.y);
+        glm::vec3 zenithTransmittance = transmittanceTo(result, GROUND_RADIUS + CAMERA_HEIGHT, 1.0f);
+        result.sunColor = sunTransmittance / glm::max(zenithTransmittance, glm::vec3(1e-6f));
+        result.skyBrightness = result.zenithSkyLuminance > 0.0f ?
+                               skyLuminance(result.skyViewTable) / result.zenithSkyLuminance : 0.0f;
+        result.skyViewMilliseconds = seconds(start);
+
+        start = std::chrono::steady_clock::now();
+        buildCube(result);
+        SkyIrradiance::Project(result.cube, CUBE_SIZE, threads, result.irradiance);
+        environment.Prefilter(result.cube, CUBE_SIZE, threads, result.environment);
+        result.cubemapMilliseconds = seconds(start);
+    }
+
+    static Medium mediumAt(const Result &result, float height) {
+        height = std::max(height, 0.0f);
+        float rayleighDensity = std::exp(-height / RAYLEIGH_HEIGHT);
+        float mieDensity = std::exp(-height / MIE_HEIGHT) * result.parameters.turbidity;
+        float ozoneDensity = std::max(0.0f, 1.0f - std::abs(height - 25.0f) / 15.0f);
+        Medium medium;
+        medium.rayleigh = glm::vec3(5.802e-3f, 13.558e-3f, 33.1e-3f) * rayleighDensity;
+        medium.mie = MIE_SCATTERING * mieDensity;
+        medium.extinction = medium.rayleigh + glm::vec3(MIE_EXTINCTION * mieDensity) +
+                            glm::vec3(0.650e-3f, 1.881e-3f, 0.085e-3f) * ozoneDensity;
+        return medium;
+    }
+
+    // distance from radius r along a ray with zenith cosine mu to the top of the atmosphere
+    static float distanceToTop(float r, float mu) {
+        float discriminant = r * r * (mu * mu - 1.0f) + TOP_RADIUS * TOP_RADIUS;
+        return std::max(0.0f, -r * mu + std::sqrt(std::max(discriminant, 0.0f)));
+    }
+
+    // distance to the ground, negative when the ray misses it
+    static float distanceToGround(float r, float mu) {
+        float discriminant = r * r * (mu * mu - 1.0f) + GROUND_RADIUS * GROUND_RADIUS;
+        if (mu >= 0.0f || discriminant < 0.0f)
+            return -1.0f;
+        return -r * mu - std::sqrt(discriminant);
+    }
+
+    // Bruneton's mapping of (r, mu) for rays that reach the top of the atmosphere
+    static glm::vec2 transmittanceCoordinates(float r, float mu) {
+        float horizon = std::sqrt(TOP_RADIUS * TOP_RADIUS - GROUND_RADIUS * GROUND_RADIUS);
+        float rho = std::sqrt(std::max(0.0f, r * r - GROUND_RADIUS * GROUND_RADIUS));
+        float d = distanceToTop(r, mu);
+        float dMin = TOP_RADIUS - r, dMax = rho + horizon;
+        return glm::vec2((d - dMin) / std::max(dMax - dMin, 1e-6f), rho / horizon);
+    }
+
+    static void buildTransmittance(Result &result, unsigned threads) {
+        result.transmittance.Resize(TRANSMITTANCE_WIDTH, TRANSMITTANCE_HEIGHT);
+        float horizon = std::sqrt(TOP_RADIUS * TOP_RADIUS - GROUND_RADIUS * GROUND_RADIUS);
+        parallelRows(TRANSMITTANCE_HEIGHT, threads, [&](int y) {
+            float rho = horizon * (y + 0.5f) / TRANSMITTANCE_HEIGHT;
+            float r = std::sqrt(rho * rho + GROUND_RADIUS * GROUND_RADIUS);
+            for (int x = 0; x < TRANSMITTANCE_WIDTH; x++) {
+                float dMin = TOP_RADIUS - r, dMax = rho + horizon;
+                float d = dMin + (x + 0.5f) / TRANSMITTANCE_WIDTH * (dMax - dMin);
+                float mu = glm::clamp((horizon * horizon - rho * rho - d * d) / (2.0f * r * d), -1.0f, 1.0f);
+                float step = distanceToTop(r, mu) / TRANSMITTANCE_STEPS;
+                glm::vec3 depth(0.0f);
+                for (int i = 0; i < TRANSMITTANCE_STEPS; i++) {
+                    float t = (i + 0.5f) * step;
+                    float height = std::sqrt(r * r + t * t + 2.0f * r * mu * t) - GROUND_RADIUS;
+                    depth += mediumAt(result, height).extinction * step;
+                }
+                result.transmittance.Set(x, y, glm::exp(-depth));
+            }
+        });
+    }
+
+    // transmittance from radius r towards zenith cosine mu to space, black when the ground is in the way
+    static glm::vec3 transmittanceTo(const Result &result, float r, float mu) {
+        if (distanceToGround(r, mu) >= 0.0f)
+            return glm::vec3(0.0f);
+        glm::vec2 uv = transmittanceCoordinates(r, mu);
+        return result.transmittance.Sample(uv.x, uv.y);
+    }
+
+    static glm::vec3 multipleScatteringAt(const Result &result, float r, float sunMu) {
+        return result.multipleScattering.Sample(sunMu * 0.5f + 0.5f,
+                                                (r - GROUND_RADIUS) / (TOP_RADIUS - GROUND_RADIUS));
+    }
+
+    static void buildMultipleScattering(Result &result, unsigned threads) {
+        int size = MULTIPLE_SCATTERING_SIZE;
+        result.multipleScattering.Resize(size, size);
+        int rings = (int) std::sqrt((float) MULTIPLE_SCATTERING_DIRECTIONS);
+        parallelRows(size, threads, [&](int y) {
+            float r = GROUND_RADIUS + std::max((y + 0.5f) / size * (TOP_RADIUS - GROUND_RADIUS), 0.01f);
+            glm::vec3 position(0.0f, r, 0.0f);
+            for (int x = 0; x < size; x++) {
+                float sunMu = 2.0f * (x + 0.5f) / size - 1.0f;
+                glm::vec3 sun(std::sqrt(1.0f - sunMu * sunMu), sunMu, 0.0f);
+                glm::vec3 secondOrder(0.0f), transfer(0.0f);
+                for (int i = 0; i < rings; i++) {
+                    for (int j = 0; j < rings; j++) {
+                        float cosine = 1.0f - 2.0f * (i + 0.5f) / rings, sine = std::sqrt(1.0f - cosine * cosine);
+                        float phi = 2.0f * PI * (j + 0.5f) / rings;
+                        glm::vec3 direction(sine * std::cos(phi), cosine, sine * std::sin(phi));
+                        glm::vec3 light, energy;
+                        integrateRay(result, position, direction, sun, MULTIPLE_SCATTERING_STEPS, nullptr, light,
+                                     energy);
+                        secondOrder += light;
+                        transfer += energy;
+                    }
+                }
+                float count = (float) (rings * rings);
+                secondOrder /= count;
+                transfer /= count;
+                result.multipleScattering.Set(x, y, secondOrder / (glm::vec3(1.0f) - glm::min(transfer, glm::vec3(0.99f))));
+            }
+        });
+    }
+
+    // single scattering of a unit sun along a ray from position until it leaves the atmosphere or hits the ground,
+    // where the ground reflects sunlight. With phase set the phase functions are Rayleigh's and Mie's and multiple
+    // scattering is added; without, both are isotropic, light is the second order term and energy the fraction of
+    // light a unit isotropic source scatters along the ray (Hillaire's f_ms).
+    static void integrateRay(const Result &result, const glm::vec3 &position, const glm::vec3 &direction,
+                             const glm::vec3 &sun, int steps, const float *phase, glm::vec3 &light,
+                             glm::vec3 &energy) {
+        float r = glm::length(position);
+        float mu = glm::dot(position, direction) / r;
+        float ground = distanceToGround(r, mu);
+        float length = ground >= 0.0f ? ground : distanceToTop(r, mu);
+        float cosine = glm::dot(direction, sun);
+        float rayleighPhase = 3.0f / (16.0f * PI) * (1.0f + cosine * cosine);
+        float g2 = MIE_G * MIE_G;
+        float miePhase = (1.0f - g2) / (4.0f * PI * std::pow(1.0f + g2 - 2.0f * MIE_G * cosine, 1.5f));
+        float isotropic = 1.0f / (4.0f * PI);
+
+        light = glm::vec3(0.0f);
+        energy = glm::vec3(0.0f);
+        glm::vec3 throughput(1.0f);
+        float previous = 0.0f;
+        for (int i = 0; i < steps; i++) {
+            // samples packed towards the start of the ray, where the air is densest
+            float next = length * ((i + 1.0f) / steps) * ((i + 1.0f) / steps);
+            float step = next - previous;
+            float t = 0.5f * (previous + next);
+            previous = next;
+            glm::vec3 point = position + direction * t;
+            float pointRadius = glm::length(point);
+            Medium medium = mediumAt(result, pointRadius - GROUND_RADIUS);
+            float sunMu = glm::dot(point, sun) / pointRadius;
+            glm::vec3 sunlight = transmittanceTo(result, pointRadius, sunMu);
+            glm::vec3 scattering = medium.rayleigh + glm::vec3(medium.mie);
+            glm::vec3 source;
+            if (phase)
+                source = sunlight * (medium.rayleigh * rayleighPhase + glm::vec3(medium.mie * miePhase)) +
+                         multipleScatteringAt(result, pointRadius, sunMu) * scattering;
+            else
+                source = sunlight * scattering * isotropic;
+            // exact integral of the source over the step with the extinction held constant
+            glm::vec3 stepTransmittance = glm::exp(-medium.extinction * step);
+            glm::vec3 integral = (glm::vec3(1.0f) - stepTransmittance) / glm::max(medium.extinction, glm::vec3(1e-7f));
+            light += throughput * source * integral;
+            energy += throughput * scattering * integral;
+            throughput *= stepTransmittance;
+        }
+        if (ground >= 0.0f) {
+            glm::vec3 point = position + direction * ground;
+            glm::vec3 normal = glm::normalize(point);
+            float sunMu = glm::dot(normal, sun);
+            light += throughput * transmittanceTo(result, GROUND_RADIUS + 1e-3f, sunMu) *
+                     (std::max(sunMu, 0.0f) * GROUND_ALBEDO / PI);
+        }
+    }
+
+    // elevation of the horizon seen from the camera, slightly below zero
+    static float horizonElevation() {
+        return -std::acos(GROUND_RADIUS / (GROUND_RADIUS + CAMERA_HEIGHT));
+    }
+
+    // sky view table rows: half the rows above the horizon, half below, denser towards it (atmosphere.fs inverts it)
+    static float rowElevation(float v) {
+        float horizon = horizonElevation();
+        if (v >= 0.5f) {
+            float x = 2.0f * v - 1.0f;
+            return horizon + x * x * (0.5f * PI - horizon);
+        }
+        float x = 1.0f - 2.0f * v;
+        return horizon - x * x * (0.5f * PI + horizon);
+    }
+
+    static float elevationRow(float elevation) {
+        float horizon = horizonElevation();
+        if (elevation >= horizon)
+            return 0.5f + 0.5f * std::sqrt((elevation - horizon) / (0.5f * PI - horizon));
+        return 0.5f - 0.5f * std::sqrt((horizon - elevation) / (0.5f * PI + horizon));
+    }
+
+    // columns are the azimuth from the sun, 0 to pi (the sky is symmetric around the sun's vertical plane)
+    static void buildSkyView(const Result &result, float sunMu, int width, int height, unsigned threads,
+                             Table &table) {
+        table.Resize(width, height);
+        glm::vec3 position(0.0f, GROUND_RADIUS + CAMERA_HEIGHT, 0.0f);
+        glm::vec3 sun(std::sqrt(std::max(0.0f, 1.0f - sunMu * sunMu)), sunMu, 0.0f);
+        float phase = 1.0f;
+        parallelRows(height, threads, [&](int y) {
+            float elevation = rowElevation((y + 0.5f) / height);
+            for (int x = 0; x < width; x++) {
+                float azimuth = PI * (x + 0.5f) / width;
+                glm::vec3 direction(std::cos(elevation) * std::cos(azimuth), std::sin(elevation),
+                                    std::cos(elevation) * std::sin(azimuth));
+                glm::vec3 light, energy;
+                integrateRay(result, position, direction, sun, SKY_VIEW_STEPS, &phase, light, energy);
+                table.Set(x, y, light * SUN_ILLUMINANCE);
+            }
+        });
+    }
+
+    // radiance from a world direction, as atmosphere.fs looks it up
+    static glm::vec3 sampleSkyView(const Result &result, const glm::vec3 &direction) {
+        glm::vec3 d = glm::normalize(direction);
+        float elevation = std::asin(glm::clamp(d.y, -1.0f, 1.0f));
+        glm::vec2 horizontal(d.x, d.z), sunHorizontal(result.sunDirection.x, result.sunDirection.z);
+        float cosine = glm::length(horizontal) > 1e-6f && glm::length(sunHorizontal) > 1e-6f ?
+                       glm::dot(glm::normalize(horizontal), glm::normalize(sunHorizontal)) : 1.0f;
+        float azimuth = std::acos(glm::clamp(cosine, -1.0f, 1.0f));
+        return result.skyViewTable.Sample(azimuth / PI, elevationRow(elevation));
+    }
+
+    static float skyLuminance(const Table &table) {
+        // rows weighted by the solid angle of their band of the upper hemisphere
+        float sum = 0.0f, weight = 0.0f;
+        for (int y = 0; y < table.height; y++) {
+            float elevation = rowElevation((y + 0.5f) / table.height);
+            if (elevation < 0.0f)
+                continue;
+            float band = std::cos(elevation) * (rowElevation((y + 1.0f) / table.height) -
+                                                rowElevation((float) y / table.height));
+            for (int x = 0; x < table.width; x++) {
+                sum += glm::dot(table.texel(x, y), glm::vec3(0.2126f, 0.7152f, 0.0722f)) * band;
+                weight += band;
+            }
+        }
+        return weight > 0.0f ? sum / weight : 0.0f;
+    }
+
+    // the sky without the sun's disk (the directional light is the sun) in the skybox's orientation
+    static void buildCube(Result &result) {
+        result.cube.assign((size_t) 6 * CUBE_SIZE * CUBE_SIZE * 3, 0.0f);
+        for (int face = 0; face < 6; face++) {
+            glm::vec3 faceS, faceT, faceAxis;
+            CubemapFaceBasis(face, faceS, faceT, faceAxis);
+            for (int y = 0; y < CUBE_SIZE; y++) {
+                float t = 2.0f * (y + 0.5f) / CUBE_SIZE - 1.0f;
+                for (int x = 0; x < CUBE_SIZE; x++) {
+                    float s = 2.0f * (x + 0.5f) / CUBE_SIZE - 1.0f;
+                    glm::vec3 color = sampleSkyView(result, SkyboxLookup(faceS * s + faceT * t + faceAxis));
+                    float *texel = &result.cube[(((size_t) face * CUBE_SIZE + y) * CUBE_SIZE + x) * 3];
+                    texel[0] = color.r;
+                    texel[1] = color.g;
+                    texel[2] = color.b;
+                }
+            }
+        }
+    }
+
+    static GpuRef createTexture(GLenum target, int width, int height) {
+        GpuRef texture(GPU_TEXTURE);
+        glBindTexture(target, texture);
+        glTexImage2D(target, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
+        setLinear(target);
+        texture.SetBytes(TextureBytes(width, height, 8));
+        glBindTexture(target, 0);
+        return texture;
+    }
+
+    static void setLinear(GLenum target) {
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+};
+
+constexpr float Atmosphere::GROUND_RADIUS;
+constexpr float Atmosphere::TOP_RADIUS;
+constexpr float Atmosphere::CAMERA_HEIGHT;
+constexpr float Atmosphere::SUN_ILLUMINANCE;
+constexpr float Atmosphere::SUN_ANGULAR_RADIUS;
+constexpr float Atmosphere::SUN_DISK_RADIANCE;
+constexpr float Atmosphere::PI;
+constexpr float Atmosphere::RAYLEIGH_HEIGHT;
+constexpr float Atmosphere::MIE_HEIGHT;
+constexpr float Atmosphere::MIE_SCATTERING;
+constexpr float Atmosphere::MIE_EXTINCTION;
+constexpr float Atmosphere::MIE_G;
+constexpr float Atmosphere::GROUND_ALBEDO;
+
+};
+#endif //PROJECT_BASE_ATMOSPHERE_H
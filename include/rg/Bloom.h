@@ -0,0 +1,164 @@
+#ifndef PROJECT_BASE_BLOOM_H
+#define PROJECT_BASE_BLOOM_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+#include <rg/GpuResources.h>
+#include <rg/ShaderConstants.h>
+#include <rg/UniformRing.h>
+
+#include <algorithm>
+#include <iostream>
+
+namespace rg {
+
+// Bloom over a mip chain (Jimenez, "Next Generation Post Processing in Call of Duty: Advanced Warfare"). The
+// bright target is resolved (or, single-sample, copied) once with a blit; then:
+//   - bloom_down.fs halves it level by level down to MAX_LEVELS levels, each texel a weighted 13 tap average of
+//     bilinear fetches from the level above, which keeps small bright spots from flickering
+//   - bloom_up.fs goes back up with a 3x3 tent filter of bilinear fetches, each level added to the next larger one
+// The half resolution level ends up with every level's glow, wider ones coming from smaller levels; bloomFinal.fs
+// adds it to the scene with one bilinear fetch. The tent radius and the strength come from PostBlock.
+class Bloom {
+public:
+    static const int MAX_LEVELS = 7;
+    // the chain stops early at levels smaller than this
+    static const int MIN_SIZE = 4;
+    // texture unit of the level being read
+    static const int SOURCE_UNIT = 0;
+
+    // brightTexture is the scene's bright target, multisampled or not as brightTarget says; the resolved copy gets
+    // its format
+    void Init(GLsizei width, GLsizei height, GLenum brightTarget, GLuint brightTexture) {
+        screenWidth = width;
+        screenHeight = height;
+        glBindTexture(brightTarget, brightTexture);
+        glGetTexLevelParameteriv(brightTarget, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+        glBindTexture(brightTarget, 0);
+
+        resolved = createTarget(width, height, resolveFBO);
+        levelCount = 0;
+        for (int level = 0; level < MAX_LEVELS; level++) {
+            GLsizei levelWidth = std::max(1, width >> (level + 1));
+            GLsizei levelHeight = std::max(1, height >> (level + 1));
+            if (std::min(levelWidth, levelHeight) < MIN_SIZE)
+                break;
+            levelSizes[level][0] = levelWidth;
+            levelSizes[level][1] = levelHeight;
+            levels[level] = createTarget(levelWidth, levelHeight, levelFBO[level]);
+            levelCount++;
+        }
+    }
+
+    static void SetSamplers(Shader &shader) {
+        shader.use();
+        shader.setInt("bloomSource", SOURCE_UNIT);
+    }
+
+    // resolves colour attachment brightAttachment of sceneFBO and blurs it over the first levels of the chain (at
+    // most LevelCount()); drawQuad() draws a fullscreen quad. Leaves the framebuffer unbound.
+    template<typename DrawQuad>
+    void Render(GLuint sceneFBO, GLenum brightAttachment, int levels, Shader &downShader, Shader &upShader,
+                UniformRing &ring, GLintptr post, DrawQuad drawQuad) {
+        levels = std::max(1, std::min(levels, levelCount));
+        activeLevels = levels;
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+        glReadBuffer(brightAttachment);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFBO);
+        glBlitFramebuffer(0, 0, screenWidth, screenHeight, 0, 0, screenWidth, screenHeight, GL_COLOR_BUFFER_BIT,
+                          GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+        glDisable(GL_BLEND);
+        ring.BindRange(POST_BLOCK, post, sizeof(PostConstants));
+        glActiveTexture(GL_TEXTURE0 + SOURCE_UNIT);
+        downShader.use();
+        for (int level = 0; level < levels; level++) {
+            glBindTexture(GL_TEXTURE_2D, level == 0 ? resolved : this->levels[level - 1]);
+            setLevel(level);
+            drawQuad();
+        }
+
+        // each level is added to the one above it, so the smallest level's glow reaches the top
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        upShader.use();
+        for (int level = levels - 1; level > 0; level--) {
+            glBindTexture(GL_TEXTURE_2D, this->levels[level]);
+            setLevel(level - 1);
+            drawQuad();
+        }
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+
+    // half resolution glow of the last Render, for the composite
+    GLuint Result() const {
+        return levels[0];
+    }
+
+    // levels the screen size allows
+    int LevelCount() const {
+        return levelCount;
+    }
+
+    // levels of the last Render
+    int ActiveLevels() const {
+        return activeLevels;
+    }
+
+    GLsizei LevelWidth(int level) const {
+        return levelSizes[level][0];
+    }
+
+    GLsizei LevelHeight(int level) const {
+        return levelSizes[level][1];
+    }
+
+private:
+    GLsizei screenWidth = 0;
+    GLsizei screenHeight = 0;
+    GLint format = GL_RGBA16F;
+    int levelCount = 0;
+    int activeLevels = 0;
+    GpuRef resolved;
+    GpuRef resolveFBO;
+    GpuRef levels[MAX_LEVELS];
+    GpuRef levelFBO[MAX_LEVELS];
+    GLsizei levelSizes[MAX_LEVELS][2] = {};
+
+    void setLevel(int level) {
+        glBindFramebuffer(GL_FRAMEBUFFER, levelFBO[level]);
+        glViewport(0, 0, levelSizes[level][0], levelSizes[level][1]);
+    }
+
+    // every pass reads with bilinear filtering between texels, clamped at the edges
+    GpuRef createTarget(GLsizei width, GLsizei height, GpuRef &fbo) const {
+        GpuRef texture(GPU_TEXTURE);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+        texture.SetBytes(TextureBytes(width, height, 8));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        fbo = GpuRef(GPU_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Bloom framebuffer not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    }
+};
+
+};
+#endif //PROJECT_BASE_BLOOM_H
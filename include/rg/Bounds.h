@@ -0,0 +1,83 @@
+#ifndef PROJECT_BASE_BOUNDS_H
+#define PROJECT_BASE_BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/model.h>
+
+namespace rg {
+
+// axis aligned bounding box, empty until the first Extend
+struct Aabb {
+    glm::vec3 minimum = glm::vec3(1e30f);
+    glm::vec3 maximum = glm::vec3(-1e30f);
+
+    void Extend(const glm::vec3 &point) {
+        minimum = glm::min(minimum, point);
+        maximum = glm::max(maximum, point);
+    }
+
+    bool Empty() const {
+        return minimum.x > maximum.x;
+    }
+
+    glm::vec3 Center() const {
+        return (minimum + maximum) * 0.5f;
+    }
+
+    // radius of the sphere around Center() that encloses the box
+    float Radius() const {
+        return glm::length(maximum - minimum) * 0.5f;
+    }
+
+    glm::vec3 Corner(int i) const {
+        return glm::vec3(i & 1 ? maximum.x : minimum.x, i & 2 ? maximum.y : minimum.y, i & 4 ? maximum.z : minimum.z);
+    }
+
+    // box around the transformed corners
+    Aabb Transformed(const glm::mat4 &transform) const {
+        Aabb result;
+        if (!Empty()) {
+            for (int i = 0; i < 8; i++)
+                result.Extend(glm::vec3(transform * glm::vec4(Corner(i), 1.0f)));
+        }
+        return result;
+    }
+};
+
+// planes of a projection * view matrix (Gribb and Hartmann), normalised and facing inwards
+struct Frustum {
+    glm::vec4 planes[6];
+
+    Frustum() = default;
+
+    explicit Frustum(const glm::mat4 &viewProjection) {
+        glm::mat4 rows = glm::transpose(viewProjection);
+        for (int i = 0; i < 3; i++) {
+            planes[2 * i] = rows[3] + rows[i];
+            planes[2 * i + 1] = rows[3] - rows[i];
+        }
+        for (glm::vec4 &plane: planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
+
+    bool IntersectsSphere(const glm::vec3 &center, float radius) const {
+        for (const glm::vec4 &plane: planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        }
+        return true;
+    }
+};
+
+// model space bounds of every vertex of every mesh
+Aabb ModelBounds(const Model &model) {
+    Aabb bounds;
+    for (const Mesh &mesh: model.meshes)
+        for (const Vertex &vertex: mesh.vertices)
+            bounds.Extend(vertex.Position);
+    return bounds;
+}
+
+};
+#endif //PROJECT_BASE_BOUNDS_H
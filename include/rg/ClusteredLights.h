@@ -0,0 +1,302 @@
+#ifndef PROJECT_BASE_CLUSTEREDLIGHTS_H
+#define PROJECT_BASE_CLUSTEREDLIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/Bounds.h>
+#include <rg/GpuResources.h>
+#include <rg/ShaderConstants.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RG_CLUSTER_SSE 1
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace rg {
+
+// depth of the first cluster slice; starting the exponential split this far out keeps the near slices usable
+const float CLUSTER_NEAR_SLICE_DEPTH = 2.0f;
+
+// Clustered forward lighting. Every view's frustum is split into GRID_X x GRID_Y screen tiles and GRID_Z depth slices
+// (the first one up to CLUSTER_NEAR_SLICE_DEPTH, the rest exponential up to the far plane). Each frame the CPU bins
+// the point lights into the clusters their sphere touches and uploads three texture buffers (GL 3.3, no SSBOs):
+//   clusterLights   RGBA32F, four texels per light (PointLightConstants)
+//   clusterRanges   RG32UI, first index and light count of every cluster
+//   clusterIndices  R32UI, the light indices of all clusters back to back
+// lighting.glsl finds the fragment's cluster and only loops over its lights, so the cost per fragment follows the
+// local light density instead of the total light count.
+class ClusteredLights {
+public:
+    static const int GRID_X = 16;
+    static const int GRID_Y = 9;
+    static const int GRID_Z = 24;
+    static const int CLUSTERS_PER_VIEW = GRID_X * GRID_Y * GRID_Z;
+    // texture units of the buffers, above the material units
+    static const int LIGHT_UNIT = 8;
+    static const int RANGE_UNIT = 9;
+    static const int INDEX_UNIT = 10;
+
+    void Init() {
+        GLint maxTexels;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        maxIndices = maxTexels;
+        for (glm::vec3 &key: sliceProjection)
+            key = glm::vec3(0.0f);
+
+        const GLenum formats[BUFFER_COUNT] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+        for (int i = 0; i < BUFFER_COUNT; i++) {
+            buffers[i] = GpuRef(GPU_BUFFER);
+            textures[i] = GpuRef(GPU_TEXTURE);
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            buffers[i].SetBytes(16);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // points the cluster samplers of a shader that includes lighting.glsl at the buffer units
+    static void SetSamplers(Shader &shader) {
+        shader.use();
+        shader.setInt("clusterLights", LIGHT_UNIT);
+        shader.setInt("clusterRanges", RANGE_UNIT);
+        shader.setInt("clusterIndices", INDEX_UNIT);
+    }
+
+    // bins lights (world space, PointLightConstants::radius set) into the clusters of every view in frame and fills
+    // frame's cluster fields; the views and their projections must already be set
+    void Build(const std::vector<PointLightConstants> &lights, FrameConstants &frame, float farPlane) {
+        int viewCount = frame.viewCount;
+        depthScale = (GRID_Z - 1) / std::log(farPlane / CLUSTER_NEAR_SLICE_DEPTH);
+        counts.assign(CLUSTERS_PER_VIEW * viewCount, 0);
+        hitClusters.clear();
+        hitLights.clear();
+        visibleLights = 0;
+
+        for (int v = 0; v < viewCount; v++) {
+            updateSliceBounds(v, frame.projections[v], farPlane);
+            Frustum frustum(frame.projections[v] * frame.views[v]);
+            for (unsigned int i = 0; i < lights.size(); i++) {
+                const PointLightConstants &light = lights[i];
+                if (!frustum.IntersectsSphere(light.position, light.radius))
+                    continue;
+                visibleLights++;
+                glm::vec3 center = glm::vec3(frame.views[v] * glm::vec4(light.position, 1.0f));
+                binLight(v, i, center, light.radius);
+            }
+        }
+
+        // counting sort of the hits by cluster: prefix sums give every cluster its range of the index list
+        unsigned indexCount = std::min<size_t>(hitClusters.size(), maxIndices);
+        ranges.resize(counts.size() * 2);
+        unsigned offset = 0;
+        maxLightsPerCluster = 0;
+        for (unsigned c = 0; c < counts.size(); c++) {
+            ranges[2 * c] = offset;
+            ranges[2 * c + 1] = 0;
+            maxLightsPerCluster = std::max(maxLightsPerCluster, counts[c]);
+            offset += counts[c];
+        }
+        indices.resize(indexCount);
+        for (unsigned h = 0; h < hitClusters.size(); h++) {
+            uint32_t cluster = hitClusters[h];
+            uint32_t slot = ranges[2 * cluster] + ranges[2 * cluster + 1];
+            // when the index buffer would exceed GL_MAX_TEXTURE_BUFFER_SIZE the last clusters lose lights
+            if (slot >= indexCount)
+                continue;
+            indices[slot] = hitLights[h];
+            ranges[2 * cluster + 1]++;
+        }
+        overflowed = hitClusters.size() > indexCount;
+        lightCount = lights.size();
+        this->indexCount = indexCount;
+
+        upload(LIGHT_BUFFER, lights.data(), lights.size() * sizeof(PointLightConstants));
+        upload(RANGE_BUFFER, ranges.data(), ranges.size() * sizeof(uint32_t));
+        upload(INDEX_BUFFER, indices.data(), indices.size() * sizeof(uint32_t));
+
+        frame.pointLightCount = lights.size();
+        frame.clusterGrid = glm::ivec4(GRID_X, GRID_Y, GRID_Z, CLUSTERS_PER_VIEW);
+        frame.clusterDepth = glm::vec4(CLUSTER_NEAR_SLICE_DEPTH, depthScale, 0.0f, 0.0f);
+    }
+
+    // binds the buffers to their units; nothing else uses those units, so once per frame is enough
+    void Bind() const {
+        for (int i = 0; i < BUFFER_COUNT; i++) {
+            glActiveTexture(GL_TEXTURE0 + LIGHT_UNIT + i);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    unsigned LightCount() const {
+        return lightCount;
+    }
+
+    // lights inside a view frustum, counted once per view
+    unsigned VisibleLights() const {
+        return visibleLights;
+    }
+
+    unsigned IndexCount() const {
+        return indexCount;
+    }
+
+    unsigned MaxLightsPerCluster() const {
+        return maxLightsPerCluster;
+    }
+
+    bool Overflowed() const {
+        return overflowed;
+    }
+
+private:
+    enum { LIGHT_BUFFER, RANGE_BUFFER, INDEX_BUFFER, BUFFER_COUNT };
+
+    // view space bounds of one depth slice: x bounds per column, y bounds per row, depth shared by the whole slice.
+    // A cluster's box is the product of the three, which makes the sphere test separable.
+    struct SliceBounds {
+        float minX[GRID_X], maxX[GRID_X];
+        float minY[GRID_Y], maxY[GRID_Y];
+        float minDepth, maxDepth;
+    };
+
+    // a buffer texture stores nothing of its own, its bytes are the buffer's
+    GpuRef buffers[BUFFER_COUNT];
+    GpuRef textures[BUFFER_COUNT];
+    size_t maxIndices = 0;
+    float depthScale = 1.0f;
+
+    SliceBounds slices[MAX_VIEWS][GRID_Z];
+    // projection the slice bounds of a view were computed for
+    glm::vec3 sliceProjection[MAX_VIEWS];
+
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> hitClusters;
+    std::vector<uint32_t> hitLights;
+    std::vector<uint32_t> ranges;
+    std::vector<uint32_t> indices;
+
+    unsigned lightCount = 0;
+    unsigned visibleLights = 0;
+    unsigned indexCount = 0;
+    unsigned maxLightsPerCluster = 0;
+    bool overflowed = false;
+
+    float sliceNear(int z) const {
+        return z == 0 ? 0.0f : CLUSTER_NEAR_SLICE_DEPTH * std::exp((z - 1) / depthScale);
+    }
+
+    int slice(float depth) const {
+        if (depth < CLUSTER_NEAR_SLICE_DEPTH)
+            return 0;
+        return std::min(1 + (int) (std::log(depth / CLUSTER_NEAR_SLICE_DEPTH) * depthScale), GRID_Z - 1);
+    }
+
+    // the cluster boxes only depend on the projection, so they are rebuilt when it changes (zoom, split screen)
+    void updateSliceBounds(int view, const glm::mat4 &projection, float farPlane) {
+        glm::vec3 key = glm::vec3(projection[0][0], projection[1][1], farPlane);
+        if (key == sliceProjection[view])
+            return;
+        sliceProjection[view] = key;
+
+        for (int z = 0; z < GRID_Z; z++) {
+            SliceBounds &bounds = slices[view][z];
+            float nearDepth = sliceNear(z);
+            float farDepth = z == GRID_Z - 1 ? farPlane : sliceNear(z + 1);
+            bounds.minDepth = nearDepth;
+            bounds.maxDepth = farDepth;
+            // a point at NDC n and depth d lies at n * d / P in view space (symmetric perspective)
+            for (int x = 0; x < GRID_X; x++) {
+                float low = -1.0f + 2.0f * x / GRID_X, high = -1.0f + 2.0f * (x + 1) / GRID_X;
+                bounds.minX[x] = std::min(low * nearDepth, low * farDepth) / projection[0][0];
+                bounds.maxX[x] = std::max(high * nearDepth, high * farDepth) / projection[0][0];
+            }
+            for (int y = 0; y < GRID_Y; y++) {
+                float low = -1.0f + 2.0f * y / GRID_Y, high = -1.0f + 2.0f * (y + 1) / GRID_Y;
+                bounds.minY[y] = std::min(low * nearDepth, low * farDepth) / projection[1][1];
+                bounds.maxY[y] = std::max(high * nearDepth, high * farDepth) / projection[1][1];
+            }
+        }
+    }
+
+    static float axisDistance(float value, float minimum, float maximum) {
+        return std::max(0.0f, std::max(minimum - value, value - maximum));
+    }
+
+    // records a hit for every cluster of the view whose box is within radius of the view space center
+    void binLight(int view, uint32_t light, const glm::vec3 &center, float radius) {
+        float depth = -center.z;
+        if (depth + radius < 0.0f)
+            return;
+        int firstSlice = slice(std::max(depth - radius, 0.0f));
+        int lastSlice = slice(depth + radius);
+        float radius2 = radius * radius;
+
+        for (int z = firstSlice; z <= lastSlice; z++) {
+            const SliceBounds &bounds = slices[view][z];
+            float dz = axisDistance(depth, bounds.minDepth, bounds.maxDepth);
+            float remainingZ = radius2 - dz * dz;
+            if (remainingZ < 0.0f)
+                continue;
+            for (int y = 0; y < GRID_Y; y++) {
+                float dy = axisDistance(center.y, bounds.minY[y], bounds.maxY[y]);
+                float remaining = remainingZ - dy * dy;
+                if (remaining < 0.0f)
+                    continue;
+                uint32_t rowCluster = view * CLUSTERS_PER_VIEW + (z * GRID_Y + y) * GRID_X;
+#ifdef RG_CLUSTER_SSE
+                // four columns at a time: dx = max(0, min - x, x - max), hit when dx^2 <= remaining
+                __m128 x = _mm_set1_ps(center.x);
+                __m128 limit = _mm_set1_ps(remaining);
+                __m128 zero = _mm_setzero_ps();
+                for (int column = 0; column < GRID_X; column += 4) {
+                    __m128 below = _mm_sub_ps(_mm_loadu_ps(bounds.minX + column), x);
+                    __m128 above = _mm_sub_ps(x, _mm_loadu_ps(bounds.maxX + column));
+                    __m128 dx = _mm_max_ps(zero, _mm_max_ps(below, above));
+                    int mask = _mm_movemask_ps(_mm_cmple_ps(_mm_mul_ps(dx, dx), limit));
+                    for (int bit = 0; mask != 0; bit++, mask >>= 1) {
+                        if (mask & 1)
+                            addHit(rowCluster + column + bit, light);
+                    }
+                }
+#else
+                for (int column = 0; column < GRID_X; column++) {
+                    float dx = axisDistance(center.x, bounds.minX[column], bounds.maxX[column]);
+                    if (dx * dx <= remaining)
+                        addHit(rowCluster + column, light);
+                }
+#endif
+            }
+        }
+    }
+
+    void addHit(uint32_t cluster, uint32_t light) {
+        counts[cluster]++;
+        hitClusters.push_back(cluster);
+        hitLights.push_back(light);
+    }
+
+    // orphans the old contents so the upload never waits for last frame's draws; buffers never become empty
+    void upload(int buffer, const void *data, size_t bytes) {
+        size_t allocated = std::max<size_t>(bytes, 16);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[buffer]);
+        glBufferData(GL_TEXTURE_BUFFER, allocated, nullptr, GL_STREAM_DRAW);
+        buffers[buffer].SetBytes(allocated);
+        if (bytes > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+
+};
+#endif //PROJECT_BASE_CLUSTEREDLIGHTS_H
@@ -0,0 +1,151 @@
+#ifndef PROJECT_BASE_CUBEMAP_H
+#define PROJECT_BASE_CUBEMAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace rg {
+
+// CPU side of cubemaps for the load-time sky bakes (SkyIrradiance, SpecularEnvironment). Faces are RGB floats, size x
+// size each, stored one after another in GL order (+X, -X, +Y, -Y, +Z, -Z), rows in the texture's t direction.
+
+// direction of face coordinates (s, t) in [-1, 1] is faceS * s + faceT * t + faceAxis (unnormalized), as in the GL
+// cube map selection rules
+void CubemapFaceBasis(int face, glm::vec3 &faceS, glm::vec3 &faceT, glm::vec3 &faceAxis) {
+    static const float table[6][9] = {
+            {0, 0, -1, 0, -1, 0, 1, 0, 0},
+            {0, 0, 1, 0, -1, 0, -1, 0, 0},
+            {1, 0, 0, 0, 0, 1, 0, 1, 0},
+            {1, 0, 0, 0, 0, -1, 0, -1, 0},
+            {1, 0, 0, 0, -1, 0, 0, 0, 1},
+            {-1, 0, 0, 0, -1, 0, 0, 0, -1}
+    };
+    const float *row = table[face];
+    faceS = glm::vec3(row[0], row[1], row[2]);
+    faceT = glm::vec3(row[3], row[4], row[5]);
+    faceAxis = glm::vec3(row[6], row[7], row[8]);
+}
+
+// skybox.vs looks the sky up with y negated, so the world direction d sees the cubemap texel in direction
+// SkyboxLookup(d) and the other way around; the sky bakes work in world space through it
+glm::vec3 SkyboxLookup(const glm::vec3 &direction) {
+    return glm::vec3(direction.x, -direction.y, direction.z);
+}
+
+// all six faces of a cubemap texture's base level
+std::vector<float> ReadCubemapFaces(GLuint texture, int &size) {
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &size);
+    std::vector<float> faces((size_t) 6 * size * size * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    for (int face = 0; face < 6; face++) {
+        glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB, GL_FLOAT,
+                      &faces[(size_t) face * size * size * 3]);
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    return faces;
+}
+
+// 2x2 box filter of every face
+std::vector<float> DownsampleCubemapFaces(const std::vector<float> &faces, int size) {
+    int half = size / 2;
+    std::vector<float> result((size_t) 6 * half * half * 3);
+    for (int face = 0; face < 6; face++) {
+        const float *source = &faces[(size_t) face * size * size * 3];
+        float *target = &result[(size_t) face * half * half * 3];
+        for (int y = 0; y < half; y++) {
+            for (int x = 0; x < half; x++) {
+                for (int channel = 0; channel < 3; channel++) {
+                    const float *texel = source + ((2 * y) * size + 2 * x) * 3 + channel;
+                    target[(y * half + x) * 3 + channel] =
+                            0.25f * (texel[0] + texel[3] + texel[size * 3] + texel[size * 3 + 3]);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+// box-filtered mip chain of a cubemap, sampled trilinearly like a GL cubemap without seamless filtering. Read-only
+// after Build, so any number of threads can sample it.
+class CpuCubemap {
+public:
+    void Build(std::vector<float> faces, int size) {
+        levels.clear();
+        sizes.clear();
+        while (size >= 1) {
+            levels.push_back(faces);
+            sizes.push_back(size);
+            if (size == 1)
+                break;
+            faces = DownsampleCubemapFaces(faces, size);
+            size /= 2;
+        }
+    }
+
+    int Size() const {
+        return sizes.empty() ? 0 : sizes[0];
+    }
+
+    int Levels() const {
+        return sizes.size();
+    }
+
+    // direction does not have to be normalized; lod 0 is the base level
+    glm::vec3 Sample(const glm::vec3 &direction, float lod) const {
+        lod = glm::clamp(lod, 0.0f, (float) (Levels() - 1));
+        int level = (int) lod;
+        float blend = lod - level;
+        int face;
+        glm::vec2 st = faceCoordinates(direction, face);
+        glm::vec3 color = sampleLevel(level, face, st);
+        if (blend > 0.0f && level + 1 < Levels())
+            color += (sampleLevel(level + 1, face, st) - color) * blend;
+        return color;
+    }
+
+private:
+    std::vector<std::vector<float>> levels;
+    std::vector<int> sizes;
+
+    // face and (s, t) in [-1, 1] a direction points at
+    static glm::vec2 faceCoordinates(const glm::vec3 &d, int &face) {
+        glm::vec3 a = glm::abs(d);
+        if (a.x >= a.y && a.x >= a.z) {
+            face = d.x > 0.0f ? 0 : 1;
+            return glm::vec2(d.x > 0.0f ? -d.z : d.z, -d.y) / a.x;
+        }
+        if (a.y >= a.z) {
+            face = d.y > 0.0f ? 2 : 3;
+            return glm::vec2(d.x, d.y > 0.0f ? d.z : -d.z) / a.y;
+        }
+        face = d.z > 0.0f ? 4 : 5;
+        return glm::vec2(d.z > 0.0f ? d.x : -d.x, -d.y) / a.z;
+    }
+
+    // bilinear, clamped to the face's edge
+    glm::vec3 sampleLevel(int level, int face, const glm::vec2 &st) const {
+        int size = sizes[level];
+        const float *texels = &levels[level][(size_t) face * size * size * 3];
+        float u = glm::clamp((st.x * 0.5f + 0.5f) * size - 0.5f, 0.0f, size - 1.0f);
+        float v = glm::clamp((st.y * 0.5f + 0.5f) * size - 0.5f, 0.0f, size - 1.0f);
+        int x0 = (int) u, y0 = (int) v;
+        int x1 = std::min(x0 + 1, size - 1), y1 = std::min(y0 + 1, size - 1);
+        float fx = u - x0, fy = v - y0;
+        auto texel = [&](int x, int y) {
+            const float *t = texels + (y * size + x) * 3;
+            return glm::vec3(t[0], t[1], t[2]);
+        };
+        glm::vec3 top = texel(x0, y0) + (texel(x1, y0) - texel(x0, y0)) * fx;
+        glm::vec3 bottom = texel(x0, y1) + (texel(x1, y1) - texel(x0, y1)) * fx;
+        return top + (bottom - top) * fy;
+    }
+};
+
+};
+#endif //PROJECT_BASE_CUBEMAP_H
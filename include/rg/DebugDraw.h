@@ -0,0 +1,156 @@
+#ifndef PROJECT_BASE_DEBUGDRAW_H
+#define PROJECT_BASE_DEBUGDRAW_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/Bounds.h>
+#include <rg/Profiler.h>
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace rg {
+
+// Immediate-mode debug geometry. Lines, boxes, spheres and frusta recorded during a frame are collected on the CPU and
+// Flush uploads them into one dynamic vertex buffer and draws them with one GL_LINES and one GL_POINTS call, using
+// debug.vs/debug.fs. While disabled every call returns immediately and Flush does nothing.
+class DebugDraw {
+public:
+    bool enabled = false;
+
+    void Init() {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex), (void*)offsetof(DebugVertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex), (void*)offsetof(DebugVertex, color));
+        glBindVertexArray(0);
+    }
+
+    void Line(const glm::vec3 &from, const glm::vec3 &to, const glm::vec3 &color) {
+        if (!enabled)
+            return;
+        vertices.push_back({from, color});
+        vertices.push_back({to, color});
+    }
+
+    void Point(const glm::vec3 &position, const glm::vec3 &color) {
+        if (!enabled)
+            return;
+        points.push_back({position, color});
+    }
+
+    // box given in the space transform maps to world space
+    void Box(const Aabb &box, const glm::mat4 &transform, const glm::vec3 &color) {
+        if (!enabled || box.Empty())
+            return;
+        glm::vec3 corners[8];
+        for (int i = 0; i < 8; i++)
+            corners[i] = glm::vec3(transform * glm::vec4(box.Corner(i), 1.0f));
+        boxEdges(corners, color);
+    }
+
+    void Box(const Aabb &box, const glm::vec3 &color) {
+        Box(box, glm::mat4(1.0f), color);
+    }
+
+    // three great circles
+    void Sphere(const glm::vec3 &center, float radius, const glm::vec3 &color) {
+        if (!enabled)
+            return;
+        const int segments = 24;
+        for (int i = 0; i < segments; i++) {
+            float a0 = 6.2831853f * i / segments;
+            float a1 = 6.2831853f * (i + 1) / segments;
+            glm::vec2 p0(std::cos(a0) * radius, std::sin(a0) * radius);
+            glm::vec2 p1(std::cos(a1) * radius, std::sin(a1) * radius);
+            Line(center + glm::vec3(p0.x, p0.y, 0.0f), center + glm::vec3(p1.x, p1.y, 0.0f), color);
+            Line(center + glm::vec3(p0.x, 0.0f, p0.y), center + glm::vec3(p1.x, 0.0f, p1.y), color);
+            Line(center + glm::vec3(0.0f, p0.x, p0.y), center + glm::vec3(0.0f, p1.x, p1.y), color);
+        }
+    }
+
+    // the volume a projection * view matrix sees, by unprojecting the corners of the clip space cube
+    void Frustum(const glm::mat4 &viewProjection, const glm::vec3 &color) {
+        if (!enabled)
+            return;
+        glm::mat4 inverse = glm::inverse(viewProjection);
+        glm::vec3 corners[8];
+        for (int i = 0; i < 8; i++) {
+            glm::vec4 corner = inverse * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f);
+            corners[i] = glm::vec3(corner) / corner.w;
+        }
+        boxEdges(corners, color);
+    }
+
+    // draws and forgets everything recorded since the last Flush, once per view (see view.glsl); the shader must be
+    // in use
+    void Flush(Shader &shader, int viewCount = 1) {
+        lineVertexCount = vertices.size();
+        pointCount = points.size();
+        if (!enabled || (vertices.empty() && points.empty())) {
+            vertices.clear();
+            points.clear();
+            return;
+        }
+        vertices.insert(vertices.end(), points.begin(), points.end());
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(DebugVertex), vertices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glBindVertexArray(VAO);
+        if (lineVertexCount) {
+            glDrawArraysInstanced(GL_LINES, 0, lineVertexCount, viewCount);
+            frameStats.drawCalls++;
+        }
+        if (pointCount) {
+            glPointSize(6.0f);
+            glDrawArraysInstanced(GL_POINTS, lineVertexCount, pointCount, viewCount);
+            frameStats.drawCalls++;
+        }
+        glBindVertexArray(0);
+
+        vertices.clear();
+        points.clear();
+    }
+
+    // size of the last flushed batch
+    unsigned int LineCount() const {
+        return lineVertexCount / 2;
+    }
+
+    unsigned int PointCount() const {
+        return pointCount;
+    }
+
+private:
+    struct DebugVertex {
+        glm::vec3 position;
+        glm::vec3 color;
+    };
+
+    std::vector<DebugVertex> vertices;
+    std::vector<DebugVertex> points;
+    unsigned int lineVertexCount = 0, pointCount = 0;
+    unsigned int VAO = 0, VBO = 0;
+
+    // corners indexed by bits x=1, y=2, z=4
+    void boxEdges(const glm::vec3 *corners, const glm::vec3 &color) {
+        for (int i = 0; i < 8; i++) {
+            for (int axis = 1; axis < 8; axis <<= 1) {
+                if (!(i & axis))
+                    Line(corners[i], corners[i | axis], color);
+            }
+        }
+    }
+};
+
+};
+#endif //PROJECT_BASE_DEBUGDRAW_H
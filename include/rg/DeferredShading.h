@@ -0,0 +1,234 @@
+#ifndef PROJECT_BASE_DEFERREDSHADING_H
+#define PROJECT_BASE_DEFERREDSHADING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/GpuResources.h>
+#include <rg/Profiler.h>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace rg {
+
+// Deferred alternative to the forward lit pass. Opaque geometry is drawn once into a G-buffer (layout in
+// gbuffer.glsl) that shares the scene depth buffer; lights are then added up in their own target:
+//   - directional light and spotlight as one fullscreen pass (deferred_global.fs)
+//   - every point light as a sphere around its radius, all in one instanced draw (deferred_point.vs/fs). Only the
+//     back faces are drawn, with GL_GEQUAL against the scene depth, so pixels whose surface lies behind the light's
+//     volume or that show sky are rejected by the depth test; the shader discards what lies in front of it.
+// The composite (deferred_composite.fs) writes the sum into the HDR target with the bright pass, where the forward
+// chain (transparency, bloom) continues unchanged. Lighting reads the first sample of every pixel, so MSAA smooths
+// the geometry edges of the G-buffer but not the lighting across them. Single view only.
+// The G-buffer and light sum textures belong to the caller (the frame's RenderGraph), in the formats below; SetTargets
+// attaches them before the geometry pass.
+class DeferredShading {
+public:
+    static const GLenum ALBEDO_TARGET = GL_COLOR_ATTACHMENT0;
+    static const GLenum NORMAL_TARGET = GL_COLOR_ATTACHMENT1;
+    static const GLenum DEPTH_TARGET = GL_COLOR_ATTACHMENT2;
+    static const GLenum BAKED_TARGET = GL_COLOR_ATTACHMENT3;
+    // texture units of the G-buffer and the light sum while the lighting passes run
+    static const int ALBEDO_UNIT = 0;
+    static const int NORMAL_UNIT = 1;
+    static const int DEPTH_UNIT = 2;
+    static const int ACCUM_UNIT = 3;
+    static const int BAKED_UNIT = 4;
+    // formats and bytes per sample of the targets
+    static const GLenum ALBEDO_FORMAT = GL_RGBA8;
+    static const GLenum NORMAL_FORMAT = GL_RG16F;
+    static const GLenum DEPTH_FORMAT = GL_R32F;
+    static const GLenum BAKED_FORMAT = GL_RGBA16F;
+    static const GLenum ACCUM_FORMAT = GL_RGBA16F;
+    static const int ALBEDO_BYTES = 4;
+    static const int NORMAL_BYTES = 4;
+    static const int DEPTH_BYTES = 4;
+    static const int BAKED_BYTES = 8;
+    static const int ACCUM_BYTES = 8;
+
+    // depthRenderbuffer is the opaque pass depth attachment; the targets must have its size and sample count
+    void Init(GLuint depthRenderbuffer) {
+        gBufferFBO = GpuRef(GPU_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, gBufferFBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+        unsigned int attachments[4] = {ALBEDO_TARGET, NORMAL_TARGET, DEPTH_TARGET, BAKED_TARGET};
+        glDrawBuffers(4, attachments);
+
+        lightFBO = GpuRef(GPU_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, lightFBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        createSphere();
+    }
+
+    // textures of the G-buffer and the light sum, attached every frame: a pool texture the graph deleted can hand its
+    // name to a new one, so an unchanged name does not mean an unchanged attachment. textureTarget is
+    // GL_TEXTURE_2D_MULTISAMPLE for multisampled scene targets, GL_TEXTURE_2D for single-sample ones
+    void SetTargets(GLenum textureTarget, GLuint albedo, GLuint normal, GLuint depth, GLuint baked, GLuint accum) {
+        target = textureTarget;
+        albedoTexture = albedo;
+        normalTexture = normal;
+        depthTexture = depth;
+        bakedTexture = baked;
+        accumTexture = accum;
+        glBindFramebuffer(GL_FRAMEBUFFER, gBufferFBO);
+        const GLuint textures[4] = {albedo, normal, depth, baked};
+        for (int i = 0; i < 4; i++)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, ALBEDO_TARGET + i, target, textures[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "G-buffer framebuffer not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, lightFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target, accum, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Light accumulation framebuffer not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // points the G-buffer and light sum samplers of a deferred lighting shader at their units
+    static void SetSamplers(Shader &shader) {
+        shader.use();
+        shader.setInt("gAlbedo", ALBEDO_UNIT);
+        shader.setInt("gNormal", NORMAL_UNIT);
+        shader.setInt("gDepth", DEPTH_UNIT);
+        shader.setInt("gBaked", BAKED_UNIT);
+        shader.setInt("lightAccum", ACCUM_UNIT);
+    }
+
+    // binds and clears the G-buffer targets, keeping the shared depth; draw the opaque geometry with gbuffer*.fs
+    void BeginGeometry() {
+        glBindFramebuffer(GL_FRAMEBUFFER, gBufferFBO);
+        const GLfloat clear[] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 4; i++)
+            glClearBufferfv(GL_COLOR, i, clear);
+        // the alpha of the albedo target holds the specular intensity, it must not blend
+        glDisable(GL_BLEND);
+    }
+
+    void EndGeometry() {
+        glEnable(GL_BLEND);
+    }
+
+    // binds the light sum target and the G-buffer textures and sets additive blending without depth writes; draw
+    // the fullscreen lights, then DrawPointLights
+    void BeginLighting() {
+        glBindFramebuffer(GL_FRAMEBUFFER, lightFBO);
+        const GLfloat clear[] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, clear);
+
+        bindTexture(ALBEDO_UNIT, albedoTexture);
+        bindTexture(NORMAL_UNIT, normalTexture);
+        bindTexture(DEPTH_UNIT, depthTexture);
+        bindTexture(BAKED_UNIT, bakedTexture);
+        glActiveTexture(GL_TEXTURE0);
+
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glBlendFunc(GL_ONE, GL_ONE);
+    }
+
+    // draws lightCount light volumes with deferred_point.vs/fs, one instance per light of the cluster light buffer
+    void DrawPointLights(GLsizei lightCount) {
+        if (lightCount == 0)
+            return;
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_GEQUAL);
+        // the sphere is wound counter-clockwise seen from outside; drawing the far side keeps the volume visible
+        // when the camera is inside it, and depth clamping keeps it when it crosses the far plane
+        glFrontFace(GL_CCW);
+        glCullFace(GL_FRONT);
+        glEnable(GL_DEPTH_CLAMP);
+
+        glBindVertexArray(sphereVAO);
+        glDrawElementsInstanced(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0, lightCount);
+        frameStats.drawCalls++;
+        glBindVertexArray(0);
+
+        glDisable(GL_DEPTH_CLAMP);
+        glFrontFace(GL_CW);
+        glCullFace(GL_FRONT);
+        glDepthFunc(GL_LESS);
+        glDisable(GL_DEPTH_TEST);
+    }
+
+    // restores blending, binds targetFBO and the light sum for deferred_composite.fs; draw a fullscreen quad and
+    // call EndComposite
+    void BeginComposite(GLuint targetFBO) {
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+        bindTexture(ACCUM_UNIT, accumTexture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void EndComposite() {
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+private:
+    GpuRef gBufferFBO;
+    GpuRef lightFBO;
+    GLuint albedoTexture = 0;
+    GLuint normalTexture = 0;
+    GLuint depthTexture = 0;
+    GLuint bakedTexture = 0;
+    GLuint accumTexture = 0;
+    GLenum target = GL_TEXTURE_2D_MULTISAMPLE;
+    GpuRef sphereVAO;
+    GpuRef sphereVBO;
+    GpuRef sphereEBO;
+    GLsizei sphereIndexCount = 0;
+
+    void bindTexture(int unit, GLuint texture) const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+    }
+
+    // latitude/longitude sphere pushed out so that its flat faces still enclose the unit sphere
+    void createSphere() {
+        const int stacks = 8;
+        const int slices = 12;
+        const float pi = 3.14159265f;
+        float scale = 1.0f / (std::cos(pi / stacks) * std::cos(pi / slices));
+
+        std::vector<glm::vec3> vertices;
+        for (int i = 0; i <= stacks; i++) {
+            float theta = pi * i / stacks;
+            for (int j = 0; j <= slices; j++) {
+                float phi = 2.0f * pi * j / slices;
+                vertices.push_back(scale * glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta),
+                                                     std::sin(theta) * std::sin(phi)));
+            }
+        }
+        std::vector<unsigned int> indices;
+        for (int i = 0; i < stacks; i++) {
+            for (int j = 0; j < slices; j++) {
+                unsigned int current = i * (slices + 1) + j;
+                unsigned int below = current + slices + 1;
+                unsigned int quad[6] = {current, current + 1, below, current + 1, below + 1, below};
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+        sphereIndexCount = indices.size();
+
+        sphereVAO = GpuRef(GPU_VERTEX_ARRAY);
+        sphereVBO = GpuRef(GPU_BUFFER);
+        sphereEBO = GpuRef(GPU_BUFFER);
+        glBindVertexArray(sphereVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+        sphereVBO.SetBytes(vertices.size() * sizeof(glm::vec3));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        sphereEBO.SetBytes(indices.size() * sizeof(unsigned int));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *) 0);
+        glBindVertexArray(0);
+    }
+};
+
+};
+#endif //PROJECT_BASE_DEFERREDSHADING_H
@@ -0,0 +1,95 @@
+#ifndef PROJECT_BASE_DYNAMICRESOLUTION_H
+#define PROJECT_BASE_DYNAMICRESOLUTION_H
+
+#include <algorithm>
+#include <cmath>
+
+namespace rg {
+
+// Scales the 3D render resolution so the GPU time of a frame stays near a target. The controller works on the share
+// of the window's pixels that is rendered, since the frame's cost follows the pixel count more closely than the side
+// length: a PID controller in velocity form moves that share by the relative error (target - time) / target, its
+// change and its second difference, so clamping the share to the bounds never winds up an integral. Errors within
+// DEADBAND count as none. The share is applied as a resolution scale per side in steps of STEP, once it is a whole
+// step away from the current scale, so a target between two steps does not reallocate the targets every few frames.
+// After every change the controller waits SETTLE_FRAMES frames and restarts its smoothing, for timings of the new
+// size (GPU times arrive a few frames late and the new targets cost a frame to allocate).
+class DynamicResolution {
+public:
+    struct Settings {
+        // GPU time of the 3D frame to hold, in milliseconds
+        float targetMs = 12.0f;
+        // bounds of the scale per side
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+    };
+
+    // gains on the relative error
+    static constexpr float KP = 0.2f;
+    static constexpr float KI = 0.08f;
+    static constexpr float KD = 0.05f;
+    static constexpr float DEADBAND = 0.08f;
+    // the scale changes in steps of this size, so the targets are not reallocated every frame
+    static constexpr float STEP = 0.05f;
+    static const int SETTLE_FRAMES = 6;
+
+    // starts over at the given scale, e.g. when the controller is switched on
+    void Reset(float startScale) {
+        scale = startScale;
+        share = startScale * startScale;
+        error = previousError = 0.0f;
+        filteredMs = 0.0f;
+        settleFrames = SETTLE_FRAMES;
+    }
+
+    // feeds the GPU time of a frame; true when Scale() changed
+    bool Update(float gpuMs, const Settings &settings) {
+        if (gpuMs <= 0.0f)
+            return false;
+        filteredMs = filteredMs == 0.0f ? gpuMs : filteredMs + (gpuMs - filteredMs) * 0.3f;
+        if (settleFrames > 0) {
+            settleFrames--;
+            return false;
+        }
+
+        float newError = (settings.targetMs - filteredMs) / settings.targetMs;
+        if (std::abs(newError) < DEADBAND)
+            newError = 0.0f;
+        share += KP * (newError - error) + KI * newError + KD * (newError - 2.0f * error + previousError);
+        previousError = error;
+        error = newError;
+        float minShare = settings.minScale * settings.minScale;
+        float maxShare = settings.maxScale * settings.maxScale;
+        share = std::max(minShare, std::min(share, maxShare));
+
+        float wanted = std::sqrt(share);
+        bool inBounds = scale >= settings.minScale && scale <= settings.maxScale;
+        if (std::abs(wanted - scale) < STEP && inBounds)
+            return false;
+        scale = std::max(settings.minScale, std::min(std::round(wanted / STEP) * STEP, settings.maxScale));
+        settleFrames = SETTLE_FRAMES;
+        filteredMs = 0.0f;
+        return true;
+    }
+
+    // resolution scale per side
+    float Scale() const {
+        return scale;
+    }
+
+    // smoothed GPU time the controller sees
+    float FilteredMilliseconds() const {
+        return filteredMs;
+    }
+
+private:
+    float scale = 1.0f;
+    float share = 1.0f;
+    float error = 0.0f;
+    float previousError = 0.0f;
+    float filteredMs = 0.0f;
+    int settleFrames = SETTLE_FRAMES;
+};
+
+};
+#endif //PROJECT_BASE_DYNAMICRESOLUTION_H
@@ -0,0 +1,74 @@
+#ifndef PROJECT_BASE_FRAMEPACER_H
+#define PROJECT_BASE_FRAMEPACER_H
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+
+namespace rg {
+
+// Decides whether a frame has to be rendered at all. Anything that changes the image (input, resize, settings) calls
+// MarkDirty; continuous animations ask for frames at a capped rate through RequestAnimation. When neither applies the
+// loop skips the frame and sleeps in Wait until the next event or animation tick, so an idle scene costs nothing.
+class FramePacer {
+public:
+    // a couple of frames per change, so ImGui can react to the input that caused it (hover, release)
+    static const int DIRTY_FRAMES = 2;
+    // upper bound for one wait, so the window stays responsive to things GLFW does not report as events
+    static constexpr double MAX_WAIT = 0.5;
+
+    void MarkDirty() {
+        dirtyFrames = DIRTY_FRAMES;
+    }
+
+    // an animation running this frame wants to be redrawn at most rate times per second
+    void RequestAnimation(float rate) {
+        if (rate > 0.0f)
+            animationInterval = std::min(animationInterval, 1.0 / rate);
+    }
+
+    // true when the frame starting at now has to be rendered; consumes the dirty state
+    bool BeginFrame(double now) {
+        bool animate = animationInterval > 0.0 && now - lastAnimationFrame >= animationInterval;
+        if (dirtyFrames == 0 && !animate) {
+            skippedFrames++;
+            return false;
+        }
+        if (dirtyFrames > 0)
+            dirtyFrames--;
+        if (animate)
+            lastAnimationFrame = now;
+        // animations request again while they are drawn
+        animationInterval = MAX_INTERVAL;
+        renderedFrames++;
+        return true;
+    }
+
+    // blocks until an event arrives or the next animation frame is due
+    void Wait(double now) {
+        double timeout = MAX_WAIT;
+        if (animationInterval < MAX_INTERVAL)
+            timeout = std::min(timeout, lastAnimationFrame + animationInterval - now);
+        glfwWaitEventsTimeout(std::max(timeout, 0.0));
+    }
+
+    unsigned RenderedFrames() const {
+        return renderedFrames;
+    }
+
+    unsigned SkippedFrames() const {
+        return skippedFrames;
+    }
+
+private:
+    static constexpr double MAX_INTERVAL = 1.0e9;
+
+    int dirtyFrames = DIRTY_FRAMES;
+    double animationInterval = MAX_INTERVAL;
+    double lastAnimationFrame = 0.0;
+    unsigned renderedFrames = 0;
+    unsigned skippedFrames = 0;
+};
+
+};
+#endif //PROJECT_BASE_FRAMEPACER_H
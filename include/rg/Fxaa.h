@@ -0,0 +1,58 @@
+#ifndef PROJECT_BASE_FXAA_H
+#define PROJECT_BASE_FXAA_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+#include <rg/GpuResources.h>
+
+#include <iostream>
+
+namespace rg {
+
+// Post-process anti-aliasing, the cheaper alternative to multisampled scene targets: the scene is rendered with one
+// sample per pixel, the final composite writes the tonemapped image into an LDR target at the scene size instead of
+// the window, and fxaa.fs smooths its edges on the way to the window (upscaling like the composite would). The LDR
+// target belongs to the caller (the frame's RenderGraph), single-sample in LDR_FORMAT; BeginComposite attaches it.
+class Fxaa {
+public:
+    static const GLenum LDR_FORMAT = GL_RGBA8;
+    static const int LDR_BYTES = 4;
+    // texture unit of the LDR image while fxaa.fs runs
+    static const int SOURCE_UNIT = 0;
+
+    void Init() {
+        FBO = GpuRef(GPU_FRAMEBUFFER);
+    }
+
+    static void SetSamplers(Shader &shader) {
+        shader.use();
+        shader.setInt("source", SOURCE_UNIT);
+    }
+
+    // attaches the LDR target (every frame, the graph may have given its name to a new texture) and binds it as the
+    // composite's framebuffer
+    void BeginComposite(GLuint ldrTarget) {
+        ldrTexture = ldrTarget;
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ldrTexture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "FXAA framebuffer not complete!" << std::endl;
+    }
+
+    // draws the anti-aliased image into the bound framebuffer; drawQuad() draws a fullscreen quad
+    template<typename DrawQuad>
+    void Apply(Shader &shader, DrawQuad drawQuad) const {
+        glActiveTexture(GL_TEXTURE0 + SOURCE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, ldrTexture);
+        shader.use();
+        drawQuad();
+    }
+
+private:
+    GpuRef FBO;
+    GLuint ldrTexture = 0;
+};
+
+};
+#endif //PROJECT_BASE_FXAA_H
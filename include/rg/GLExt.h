@@ -0,0 +1,91 @@
+#ifndef PROJECT_BASE_GLEXT_H
+#define PROJECT_BASE_GLEXT_H
+
+#include <glad/glad.h>
+
+// The bundled glad loader is generated for GL 3.3 core only. The GL 4.x entry points the renderer can use when the
+// driver exposes them are declared and loaded here, in the same style glad uses for the core ones, and glCaps records
+// which optional paths are available so callers can fall back to the 3.3 code.
+
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+
+typedef void (APIENTRYP PFNGLDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect);
+PFNGLDRAWELEMENTSINDIRECTPROC rg_glDrawElementsIndirect = nullptr;
+#define glDrawElementsIndirect rg_glDrawElementsIndirect
+
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC rg_glMultiDrawElementsIndirect = nullptr;
+#define glMultiDrawElementsIndirect rg_glMultiDrawElementsIndirect
+
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+PFNGLBUFFERSTORAGEPROC rg_glBufferStorage = nullptr;
+#define glBufferStorage rg_glBufferStorage
+
+typedef void (APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z);
+PFNGLDISPATCHCOMPUTEPROC rg_glDispatchCompute = nullptr;
+#define glDispatchCompute rg_glDispatchCompute
+
+typedef void (APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+PFNGLMEMORYBARRIERPROC rg_glMemoryBarrier = nullptr;
+#define glMemoryBarrier rg_glMemoryBarrier
+
+namespace rg {
+
+// layout defined by GL for the records read by glDrawElementsIndirect and glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+struct GLCaps {
+    int major = 0;
+    int minor = 0;
+    // GL 4.3: glMultiDrawElementsIndirect with baseInstance and shader storage buffers
+    bool multiDrawIndirect = false;
+    // GL 4.4: immutable buffer storage that can stay mapped while the GPU reads it
+    bool bufferStorage = false;
+    // GL 4.3: compute shaders writing shader storage buffers that feed glDrawElementsIndirect
+    bool computeShader = false;
+
+    bool AtLeast(int maj, int min) const {
+        return major > maj || (major == maj && minor >= min);
+    }
+};
+
+GLCaps glCaps;
+
+// call once after gladLoadGLLoader, with the same loader function
+void LoadGLExtensions(GLADloadproc load) {
+    glCaps.major = GLVersion.major;
+    glCaps.minor = GLVersion.minor;
+
+    if (glCaps.AtLeast(4, 0)) {
+        rg_glDrawElementsIndirect = (PFNGLDRAWELEMENTSINDIRECTPROC) load("glDrawElementsIndirect");
+    }
+    if (glCaps.AtLeast(4, 3)) {
+        rg_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC) load("glMultiDrawElementsIndirect");
+        rg_glDispatchCompute = (PFNGLDISPATCHCOMPUTEPROC) load("glDispatchCompute");
+        rg_glMemoryBarrier = (PFNGLMEMORYBARRIERPROC) load("glMemoryBarrier");
+    }
+    if (glCaps.AtLeast(4, 4)) {
+        rg_glBufferStorage = (PFNGLBUFFERSTORAGEPROC) load("glBufferStorage");
+    }
+    glCaps.multiDrawIndirect = rg_glMultiDrawElementsIndirect != nullptr;
+    glCaps.bufferStorage = rg_glBufferStorage != nullptr;
+    glCaps.computeShader = rg_glDispatchCompute != nullptr && rg_glMemoryBarrier != nullptr &&
+                           rg_glDrawElementsIndirect != nullptr;
+}
+
+};
+#endif //PROJECT_BASE_GLEXT_H
@@ -0,0 +1,245 @@
+#ifndef PROJECT_BASE_GPURESOURCES_H
+#define PROJECT_BASE_GPURESOURCES_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace rg {
+
+enum GpuResourceType {
+    GPU_BUFFER,
+    GPU_TEXTURE,
+    GPU_VERTEX_ARRAY,
+    GPU_PROGRAM,
+    GPU_FRAMEBUFFER,
+    GPU_RENDERBUFFER,
+    GPU_RESOURCE_TYPES
+};
+
+// index into the manager's slot table plus the generation the slot had when the handle was made; a handle whose
+// resource was released no longer matches its slot and resolves to GL name 0
+struct GpuHandle {
+    uint32_t index = 0;
+    uint32_t generation = 0;
+};
+
+// Owns every GL object created through it. Resources are reference counted by GpuRef; when the last reference goes
+// away the object is not deleted right away but queued for FRAMES_IN_FLIGHT frames, so draws already submitted with
+// it finish first (the same window UniformRing waits for). Releasing never calls GL, so references may outlive the
+// context. Live bytes are tracked per type from the sizes callers report with SetBytes.
+class GpuResourceManager {
+public:
+    static const int FRAMES_IN_FLIGHT = 3;
+
+    GpuHandle Create(GpuResourceType type) {
+        GLuint name = 0;
+        switch (type) {
+            case GPU_BUFFER: glGenBuffers(1, &name); break;
+            case GPU_TEXTURE: glGenTextures(1, &name); break;
+            case GPU_VERTEX_ARRAY: glGenVertexArrays(1, &name); break;
+            case GPU_PROGRAM: name = glCreateProgram(); break;
+            case GPU_FRAMEBUFFER: glGenFramebuffers(1, &name); break;
+            case GPU_RENDERBUFFER: glGenRenderbuffers(1, &name); break;
+            default: break;
+        }
+
+        uint32_t index;
+        if (freeSlots.empty()) {
+            index = slots.size();
+            slots.push_back(Slot());
+        } else {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        Slot &slot = slots[index];
+        slot.name = name;
+        slot.type = type;
+        slot.references = 1;
+        slot.bytes = 0;
+        counts[type]++;
+
+        GpuHandle handle;
+        handle.index = index;
+        handle.generation = slot.generation;
+        return handle;
+    }
+
+    GLuint Name(GpuHandle handle) const {
+        const Slot *slot = find(handle);
+        return slot ? slot->name : 0;
+    }
+
+    // size of the object's storage, for the per-type totals; call again when the storage is reallocated
+    void SetBytes(GpuHandle handle, size_t bytes) {
+        if (Slot *slot = find(handle)) {
+            liveBytes[slot->type] += bytes - slot->bytes;
+            slot->bytes = bytes;
+        }
+    }
+
+    void AddReference(GpuHandle handle) {
+        if (Slot *slot = find(handle))
+            slot->references++;
+    }
+
+    void Release(GpuHandle handle) {
+        Slot *slot = find(handle);
+        if (!slot || --slot->references > 0)
+            return;
+        pending.push_back({slot->name, slot->type, slot->bytes, frame});
+        liveBytes[slot->type] -= slot->bytes;
+        counts[slot->type]--;
+        pendingBytes += slot->bytes;
+        slot->generation++;
+        slot->name = 0;
+        freeSlots.push_back(handle.index);
+    }
+
+    // deletes what was released FRAMES_IN_FLIGHT frames ago; call once per frame, after the last draw
+    void EndFrame() {
+        frame++;
+        deletePending(frame - FRAMES_IN_FLIGHT);
+    }
+
+    // deletes everything released so far; only when the GPU is known to be idle (glFinish, shutdown)
+    void DeleteReleased() {
+        deletePending(frame);
+    }
+
+    size_t LiveBytes(GpuResourceType type) const {
+        return liveBytes[type];
+    }
+
+    size_t TotalLiveBytes() const {
+        size_t total = 0;
+        for (size_t bytes: liveBytes)
+            total += bytes;
+        return total;
+    }
+
+    unsigned Count(GpuResourceType type) const {
+        return counts[type];
+    }
+
+    size_t PendingBytes() const {
+        return pendingBytes;
+    }
+
+    unsigned PendingCount() const {
+        return pending.size();
+    }
+
+private:
+    struct Slot {
+        GLuint name = 0;
+        GpuResourceType type = GPU_BUFFER;
+        uint32_t generation = 0;
+        uint32_t references = 0;
+        size_t bytes = 0;
+    };
+
+    struct PendingDelete {
+        GLuint name;
+        GpuResourceType type;
+        size_t bytes;
+        uint64_t frame;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<PendingDelete> pending;
+    size_t liveBytes[GPU_RESOURCE_TYPES] = {};
+    unsigned counts[GPU_RESOURCE_TYPES] = {};
+    size_t pendingBytes = 0;
+    uint64_t frame = FRAMES_IN_FLIGHT;
+
+    Slot *find(GpuHandle handle) {
+        if (handle.index >= slots.size() || slots[handle.index].generation != handle.generation ||
+            slots[handle.index].references == 0)
+            return nullptr;
+        return &slots[handle.index];
+    }
+
+    const Slot *find(GpuHandle handle) const {
+        return const_cast<GpuResourceManager *>(this)->find(handle);
+    }
+
+    // deletes every pending object released at or before lastFrame; the queue is in release order
+    void deletePending(uint64_t lastFrame) {
+        size_t deleted = 0;
+        while (deleted < pending.size() && pending[deleted].frame <= lastFrame) {
+            PendingDelete &object = pending[deleted++];
+            switch (object.type) {
+                case GPU_BUFFER: glDeleteBuffers(1, &object.name); break;
+                case GPU_TEXTURE: glDeleteTextures(1, &object.name); break;
+                case GPU_VERTEX_ARRAY: glDeleteVertexArrays(1, &object.name); break;
+                case GPU_PROGRAM: glDeleteProgram(object.name); break;
+                case GPU_FRAMEBUFFER: glDeleteFramebuffers(1, &object.name); break;
+                case GPU_RENDERBUFFER: glDeleteRenderbuffers(1, &object.name); break;
+                default: break;
+            }
+            pendingBytes -= object.bytes;
+        }
+        pending.erase(pending.begin(), pending.begin() + deleted);
+    }
+};
+
+GpuResourceManager gpuResources;
+
+// Counted reference to a resource in gpuResources. Copies share the resource, the last one to go releases it.
+// Converts to the GL name, so it can be passed straight to glBind* and friends.
+class GpuRef {
+public:
+    GpuRef() = default;
+
+    explicit GpuRef(GpuResourceType type) : handle(gpuResources.Create(type)), valid(true) {}
+
+    GpuRef(const GpuRef &other) : handle(other.handle), valid(other.valid) {
+        if (valid)
+            gpuResources.AddReference(handle);
+    }
+
+    GpuRef(GpuRef &&other) noexcept : handle(other.handle), valid(other.valid) {
+        other.valid = false;
+    }
+
+    GpuRef &operator=(GpuRef other) noexcept {
+        std::swap(handle, other.handle);
+        std::swap(valid, other.valid);
+        return *this;
+    }
+
+    ~GpuRef() {
+        if (valid)
+            gpuResources.Release(handle);
+    }
+
+    GLuint Get() const {
+        return valid ? gpuResources.Name(handle) : 0;
+    }
+
+    operator GLuint() const {
+        return Get();
+    }
+
+    void SetBytes(size_t bytes) const {
+        if (valid)
+            gpuResources.SetBytes(handle, bytes);
+    }
+
+private:
+    GpuHandle handle;
+    bool valid = false;
+};
+
+// storage of a texture level 0 of width x height texels, plus a third for the mip chain
+size_t TextureBytes(int width, int height, int bytesPerTexel, int samples = 1, bool mipmapped = false) {
+    size_t bytes = (size_t) width * height * bytesPerTexel * samples;
+    return mipmapped ? bytes * 4 / 3 : bytes;
+}
+
+};
+#endif //PROJECT_BASE_GPURESOURCES_H
@@ -0,0 +1,172 @@
+#ifndef PROJECT_BASE_INSTANCECULLER_H
+#define PROJECT_BASE_INSTANCECULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/Bounds.h>
+#include <rg/GLExt.h>
+#include <rg/GpuResources.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace rg {
+
+// Frustum culls the instances of one model on the GPU. instance_cull.comp tests a bounding sphere per instance against
+// the FrameBlock frustum and compacts the survivors into the model's instance buffer, counting them into one indirect
+// command per mesh. Drawing is then a fixed Model::DrawInstancedIndirect (one draw per mesh) no matter how many
+// instances there are, and the CPU never touches per-instance data after Init.
+// Requires GL 4.3 (rg::glCaps.computeShader). The buffers are GpuRefs; the readback fences are deleted by Release,
+// which has to run while the context is current (the destructor only covers fences left over before that).
+class InstanceCuller {
+public:
+    static const GLuint INPUT_BINDING = 1;
+    static const GLuint OUTPUT_BINDING = 2;
+    static const GLuint COMMAND_BINDING = 3;
+    static const GLuint GROUP_SIZE = 64;
+    // frames between writing a visible count and reading it back, so the read normally never waits
+    static const int READBACK_LATENCY = 3;
+
+    void Init(Model &instancedModel, const std::vector<InstanceData> &instances, Shader &cullShader) {
+        model = &instancedModel;
+        capacity = instances.size();
+
+        // bounding sphere around the model space AABB of all meshes
+        Aabb bounds = ModelBounds(*model);
+
+        cullShader.use();
+        cullShader.setVec4("boundingSphere", glm::vec4(bounds.Center(), bounds.Radius()));
+
+        inputBuffer = GpuRef(GPU_BUFFER);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, inputBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_STATIC_DRAW);
+        inputBuffer.SetBytes(instances.size() * sizeof(InstanceData));
+
+        for (const Mesh &mesh: model->meshes) {
+            DrawElementsIndirectCommand command;
+            command.count = mesh.indices.size();
+            command.instanceCount = 0;
+            command.firstIndex = 0;
+            command.baseVertex = 0;
+            command.baseInstance = 0;
+            commands.push_back(command);
+        }
+        commandBuffer = GpuRef(GPU_BUFFER);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_DYNAMIC_COPY);
+        commandBuffer.SetBytes(commands.size() * sizeof(DrawElementsIndirectCommand));
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        for (GpuRef &buffer: readbackBuffers) {
+            buffer = GpuRef(GPU_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), nullptr, GL_STREAM_READ);
+            buffer.SetBytes(sizeof(GLuint));
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    InstanceCuller() = default;
+    InstanceCuller(const InstanceCuller &) = delete;
+    InstanceCuller &operator=(const InstanceCuller &) = delete;
+
+    ~InstanceCuller() {
+        Release();
+    }
+
+    // deletes the readback fences and gives the buffers back; call before the context goes away
+    void Release() {
+        for (GLsync &fence: readbackFences) {
+            if (fence)
+                glDeleteSync(fence);
+            fence = nullptr;
+        }
+        inputBuffer = GpuRef();
+        commandBuffer = GpuRef();
+        for (GpuRef &buffer: readbackBuffers)
+            buffer = GpuRef();
+        model = nullptr;
+    }
+
+    // culls the first count instances against the frustum in the bound FrameBlock
+    void Cull(Shader &cullShader, unsigned int count) {
+        count = count < capacity ? count : capacity;
+        cullShader.use();
+        if (count != uploadedCount) {
+            cullShader.setUInt("instanceCount", count);
+            uploadedCount = count;
+        }
+
+        // reset the instance counts, then orphan the output so this frame never waits for last frame's draws
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, model->InstanceBuffer());
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(InstanceData), nullptr, GL_DYNAMIC_COPY);
+        model->InstanceBuffer().SetBytes(capacity * sizeof(InstanceData));
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INPUT_BINDING, inputBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OUTPUT_BINDING, model->InstanceBuffer());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, commandBuffer);
+        glDispatchCompute((count + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+        // the first command holds the count; copy it into the other meshes' commands
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        const GLintptr instanceCountOffset = offsetof(DrawElementsIndirectCommand, instanceCount);
+        glBindBuffer(GL_COPY_READ_BUFFER, commandBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer);
+        for (unsigned int i = 1; i < commands.size(); i++)
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, instanceCountOffset,
+                                i * sizeof(DrawElementsIndirectCommand) + instanceCountOffset, sizeof(GLuint));
+        readVisibleCount(instanceCountOffset);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+
+    // the shader must be in use; valid for every pass of the frame after Cull
+    void Draw(Shader &shader) {
+        model->DrawInstancedIndirect(shader, commandBuffer);
+    }
+
+    // instances that survived culling a few frames ago
+    unsigned int VisibleCount() const {
+        return visibleCount;
+    }
+
+private:
+    Model *model = nullptr;
+    unsigned int capacity = 0;
+    unsigned int uploadedCount = ~0u;
+    std::vector<DrawElementsIndirectCommand> commands;
+    GpuRef inputBuffer;
+    GpuRef commandBuffer;
+
+    GpuRef readbackBuffers[READBACK_LATENCY];
+    GLsync readbackFences[READBACK_LATENCY] = {};
+    int readback = 0;
+    unsigned int visibleCount = 0;
+
+    // copies this frame's count into a small buffer and reads the oldest one back if the GPU is already done with it
+    void readVisibleCount(GLintptr instanceCountOffset) {
+        GLsync &fence = readbackFences[readback];
+        if (fence) {
+            if (glClientWaitSync(fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+                glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffers[readback]);
+                glGetBufferSubData(GL_COPY_WRITE_BUFFER, 0, sizeof(GLuint), &visibleCount);
+            }
+            glDeleteSync(fence);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffers[readback]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, instanceCountOffset, 0, sizeof(GLuint));
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        readback = (readback + 1) % READBACK_LATENCY;
+    }
+};
+
+};
+#endif //PROJECT_BASE_INSTANCECULLER_H
@@ -0,0 +1,373 @@
+#ifndef PROJECT_BASE_LIGHTBAKER_H
+#define PROJECT_BASE_LIGHTBAKER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/model.h>
+#include <rg/ShaderConstants.h>
+#include <rg/TriangleBvh.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rg {
+
+// Offline bake of the light that the static models receive from lights that never move, stored per vertex since the
+// models have no second UV set for lightmaps. Every vertex gets, as irradiance:
+//   - the static point lights: their ambient term, plus the diffuse one where a shadow ray reaches the light
+//   - one bounce: cosine-distributed rays gather the shadowed direct light (directional and point lights) that the
+//     surfaces they hit reflect with the average colour of their diffuse map
+// The lit shaders multiply it by the diffuse colour (vertex attribute 10, see Mesh::SetBakedLight) and skip the baked
+// point lights. The directional light's direct term stays in the shaders, where the shadow cascades also see the
+// casters that move. Rays go through a TriangleBvh of the same models on every hardware thread. Each vertex draws its
+// samples from its own seeded sequence, so the result does not depend on the thread count; it is cached in a file
+// keyed by a hash of the geometry, the lights and the settings.
+class LightBaker {
+public:
+    struct Settings {
+        // bounce rays per vertex
+        int bounceSamples = 64;
+        uint32_t seed = 1;
+        // worker threads, 0 for one per hardware thread
+        unsigned threads = 0;
+    };
+
+    // the model is both lit and an occluder; its meshes hold one set of baked values, so it must only be drawn with
+    // this transform
+    void Add(Model &model, const glm::mat4 &transform) {
+        entries.push_back({&model, transform});
+    }
+
+    // loads the bake from cacheFile when it was made from the same input, otherwise bakes and writes it; then
+    // uploads the result to every added mesh. Call once, after all the models were added.
+    void Bake(const DirLightConstants &directionalLight, const std::vector<PointLightConstants> &pointLights,
+              const Settings &settings, const std::string &cacheFile) {
+        auto start = std::chrono::steady_clock::now();
+        directional = directionalLight;
+        lights = pointLights;
+        gather();
+
+        uint64_t key = inputKey(settings);
+        fromCache = loadCache(cacheFile, key);
+        if (!fromCache) {
+            threadCount = settings.threads ? settings.threads : std::max(1u, std::thread::hardware_concurrency());
+            std::cout << "Baking static lighting: " << positions.size() << " vertices, "
+                      << triangleNormals.size() << " triangles, " << threadCount << " threads" << std::endl;
+            bvh.Build(triangleVertices);
+            results.assign(positions.size(), glm::vec4(0.0f));
+            rayCount = 0;
+
+            // vertices are handed out in chunks; which thread bakes a vertex does not change its value
+            std::atomic<size_t> nextVertex(0);
+            auto worker = [&]() {
+                size_t begin;
+                while ((begin = nextVertex.fetch_add(CHUNK_SIZE)) < positions.size())
+                    bakeVertices(begin, std::min(begin + CHUNK_SIZE, positions.size()), settings);
+            };
+            std::vector<std::thread> workers;
+            for (unsigned i = 1; i < threadCount; i++)
+                workers.emplace_back(worker);
+            worker();
+            for (std::thread &thread: workers)
+                thread.join();
+            saveCache(cacheFile, key);
+        }
+        upload();
+
+        seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Static lighting " << (fromCache ? "loaded from " + cacheFile : "baked") << " in " << seconds
+                  << " s" << std::endl;
+    }
+
+    bool FromCache() const {
+        return fromCache;
+    }
+
+    // wall time of Bake, loading and uploading included
+    float Seconds() const {
+        return seconds;
+    }
+
+    unsigned Threads() const {
+        return threadCount;
+    }
+
+    size_t VertexCount() const {
+        return positions.size();
+    }
+
+    size_t TriangleCount() const {
+        return triangleNormals.size();
+    }
+
+    uint64_t RayCount() const {
+        return rayCount;
+    }
+
+private:
+    static const size_t CHUNK_SIZE = 256;
+    static const uint32_t CACHE_MAGIC = 0x4b414252; // "RBAK"
+    static const uint32_t FORMAT_VERSION = 1;
+    // rays start this far off the surface so they do not hit it again
+    static constexpr float RAY_OFFSET = 0.02f;
+
+    struct Entry {
+        Model *model;
+        glm::mat4 transform;
+    };
+
+    std::vector<Entry> entries;
+    DirLightConstants directional;
+    std::vector<PointLightConstants> lights;
+    // receivers in world space, one per vertex of every added mesh in order
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    // occluders: three corners per triangle, and per triangle its geometric normal and the colour it reflects
+    std::vector<glm::vec3> triangleVertices;
+    std::vector<glm::vec3> triangleNormals;
+    std::vector<glm::vec3> triangleAlbedo;
+    std::vector<glm::vec4> results;
+    TriangleBvh bvh;
+    std::atomic<uint64_t> rayCount{0};
+    bool fromCache = false;
+    float seconds = 0.0f;
+    unsigned threadCount = 0;
+
+    void gather() {
+        for (const Entry &entry: entries) {
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(entry.transform)));
+            for (const Mesh &mesh: entry.model->meshes) {
+                size_t firstVertex = positions.size();
+                for (const Vertex &vertex: mesh.vertices) {
+                    positions.push_back(glm::vec3(entry.transform * glm::vec4(vertex.Position, 1.0f)));
+                    glm::vec3 normal = normalMatrix * vertex.Normal;
+                    float length = glm::length(normal);
+                    normals.push_back(length > 1e-6f ? normal / length : glm::vec3(0.0f));
+                }
+                glm::vec3 albedo = averageAlbedo(mesh);
+                for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+                    glm::vec3 corners[3];
+                    for (int corner = 0; corner < 3; corner++) {
+                        corners[corner] = positions[firstVertex + mesh.indices[i + corner]];
+                        triangleVertices.push_back(corners[corner]);
+                    }
+                    glm::vec3 normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                    float length = glm::length(normal);
+                    triangleNormals.push_back(length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f));
+                    triangleAlbedo.push_back(albedo);
+                }
+            }
+        }
+    }
+
+    // the last mip level of the diffuse map is its average; meshes without one sample white (see MaterialLibrary)
+    static glm::vec3 averageAlbedo(const Mesh &mesh) {
+        GLuint texture = 0;
+        for (int i = mesh.textures.size() - 1; i >= 0; i--) {
+            if (mesh.textures[i].type == "texture_diffuse")
+                texture = mesh.textures[i].id;
+        }
+        if (texture == 0)
+            return glm::vec3(1.0f);
+        GLint width = 0, height = 0;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        int level = (int) std::floor(std::log2((float) std::max(1, std::max(width, height))));
+        GLfloat texel[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_FLOAT, texel);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return glm::vec3(texel[0], texel[1], texel[2]);
+    }
+
+    // light arriving at a surface point: the static point lights and, for the bounce, the directional light
+    glm::vec3 directLight(const glm::vec3 &position, const glm::vec3 &normal, bool withDirectional,
+                          uint64_t &rays) const {
+        glm::vec3 result = glm::vec3(0.0f);
+        if (withDirectional) {
+            glm::vec3 toLight = -glm::normalize(directional.direction);
+            float cosine = glm::dot(normal, toLight);
+            if (cosine > 0.0f) {
+                rays++;
+                if (!bvh.Occluded(position, toLight, 0.0f, 1e30f))
+                    result += directional.diffuse * cosine;
+            }
+        }
+        for (const PointLightConstants &light: lights) {
+            glm::vec3 toLight = light.position - position;
+            float distance = glm::length(toLight);
+            if (distance >= light.radius || distance <= 0.0f)
+                continue;
+            // the same falloff as CalcPointLight in lighting.glsl; the ambient term is not shadowed there either
+            float window = glm::clamp(1.0f - std::pow(distance / light.radius, 4.0f), 0.0f, 1.0f);
+            float attenuation = window * window / (distance * distance);
+            glm::vec3 received = light.ambient;
+            toLight /= distance;
+            float cosine = glm::dot(normal, toLight);
+            if (cosine > 0.0f) {
+                rays++;
+                if (!bvh.Occluded(position, toLight, 0.0f, distance))
+                    received += light.diffuse * cosine;
+            }
+            result += received * attenuation;
+        }
+        return result;
+    }
+
+    void bakeVertices(size_t begin, size_t end, const Settings &settings) {
+        const float pi = 3.14159265f;
+        uint64_t rays = 0;
+        for (size_t i = begin; i < end; i++) {
+            glm::vec3 normal = normals[i];
+            if (normal == glm::vec3(0.0f))
+                continue;
+            glm::vec3 origin = positions[i] + normal * RAY_OFFSET;
+            glm::vec3 light = directLight(origin, normal, false, rays);
+
+            // stratified cosine-weighted directions (a Hammersley set), shifted by a random offset per vertex
+            glm::vec3 tangent, bitangent;
+            orthonormalBasis(normal, tangent, bitangent);
+            uint32_t state = hash(settings.seed ^ hash((uint32_t) i));
+            float shiftU = random(state), shiftV = random(state);
+            glm::vec3 bounce = glm::vec3(0.0f);
+            for (int sample = 0; sample < settings.bounceSamples; sample++) {
+                float u = std::fmod((sample + 0.5f) / settings.bounceSamples + shiftU, 1.0f);
+                float v = std::fmod(radicalInverse(sample) + shiftV, 1.0f);
+                float radius = std::sqrt(u), phi = 2.0f * pi * v;
+                glm::vec3 direction = tangent * (radius * std::cos(phi)) + bitangent * (radius * std::sin(phi)) +
+                                      normal * std::sqrt(std::max(0.0f, 1.0f - u));
+                rays++;
+                RayHit hit;
+                if (!bvh.Intersect(origin, direction, 0.0f, 1e30f, hit))
+                    continue;
+                glm::vec3 hitNormal = triangleNormals[hit.triangle];
+                if (glm::dot(hitNormal, direction) > 0.0f)
+                    hitNormal = -hitNormal;
+                glm::vec3 hitPosition = origin + direction * hit.t + hitNormal * RAY_OFFSET;
+                // with cosine-distributed rays the irradiance estimate is the mean reflected light, in the shaders'
+                // units where a surface sends out colour times the light it receives
+                bounce += triangleAlbedo[hit.triangle] * directLight(hitPosition, hitNormal, true, rays);
+            }
+            if (settings.bounceSamples > 0)
+                light += bounce / (float) settings.bounceSamples;
+            results[i] = glm::vec4(light, 1.0f);
+        }
+        rayCount += rays;
+    }
+
+    void upload() {
+        size_t vertex = 0;
+        for (const Entry &entry: entries) {
+            for (Mesh &mesh: entry.model->meshes) {
+                mesh.SetBakedLight(std::vector<glm::vec4>(results.begin() + vertex,
+                                                          results.begin() + vertex + mesh.vertices.size()));
+                vertex += mesh.vertices.size();
+            }
+        }
+    }
+
+    // tangent frame around a unit normal without a branch on its direction (Duff et al.)
+    static void orthonormalBasis(const glm::vec3 &normal, glm::vec3 &tangent, glm::vec3 &bitangent) {
+        float sign = std::copysign(1.0f, normal.z);
+        float a = -1.0f / (sign + normal.z);
+        float b = normal.x * normal.y * a;
+        tangent = glm::vec3(1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+        bitangent = glm::vec3(b, sign + normal.y * normal.y * a, -normal.y);
+    }
+
+    static float radicalInverse(uint32_t bits) {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return bits * 2.3283064365386963e-10f;
+    }
+
+    static uint32_t hash(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    // uniform in [0, 1), advancing state
+    static float random(uint32_t &state) {
+        state = hash(state + 0x9e3779b9u);
+        return (state >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // FNV-1a
+    static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+
+    // everything the baked values depend on; the thread count is left out, it does not change them
+    uint64_t inputKey(const Settings &settings) const {
+        uint64_t key = 14695981039346656037ull;
+        key = hashBytes(key, &FORMAT_VERSION, sizeof(FORMAT_VERSION));
+        key = hashBytes(key, &settings.bounceSamples, sizeof(settings.bounceSamples));
+        key = hashBytes(key, &settings.seed, sizeof(settings.seed));
+        key = hashBytes(key, positions.data(), positions.size() * sizeof(glm::vec3));
+        key = hashBytes(key, normals.data(), normals.size() * sizeof(glm::vec3));
+        key = hashBytes(key, triangleVertices.data(), triangleVertices.size() * sizeof(glm::vec3));
+        key = hashBytes(key, triangleAlbedo.data(), triangleAlbedo.size() * sizeof(glm::vec3));
+        key = hashBytes(key, &directional.direction, sizeof(glm::vec3));
+        key = hashBytes(key, &directional.diffuse, sizeof(glm::vec3));
+        for (const PointLightConstants &light: lights) {
+            key = hashBytes(key, &light.position, sizeof(glm::vec3));
+            key = hashBytes(key, &light.radius, sizeof(float));
+            key = hashBytes(key, &light.ambient, sizeof(glm::vec3));
+            key = hashBytes(key, &light.diffuse, sizeof(glm::vec3));
+        }
+        return key;
+    }
+
+    bool loadCache(const std::string &file, uint64_t key) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in)
+            return false;
+        uint32_t magic = 0;
+        uint64_t storedKey = 0, count = 0;
+        in.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+        in.read(reinterpret_cast<char *>(&storedKey), sizeof(storedKey));
+        in.read(reinterpret_cast<char *>(&count), sizeof(count));
+        if (!in || magic != CACHE_MAGIC || storedKey != key || count != positions.size())
+            return false;
+        results.resize(count);
+        in.read(reinterpret_cast<char *>(results.data()), count * sizeof(glm::vec4));
+        return (bool) in;
+    }
+
+    void saveCache(const std::string &file, uint64_t key) const {
+        std::ofstream out(file, std::ios::binary);
+        uint64_t count = results.size();
+        out.write(reinterpret_cast<const char *>(&CACHE_MAGIC), sizeof(CACHE_MAGIC));
+        out.write(reinterpret_cast<const char *>(&key), sizeof(key));
+        out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char *>(results.data()), count * sizeof(glm::vec4));
+        if (!out)
+            std::cout << "Could not write the light bake cache " << file << std::endl;
+    }
+};
+
+const uint32_t LightBaker::CACHE_MAGIC;
+const uint32_t LightBaker::FORMAT_VERSION;
+constexpr float LightBaker::RAY_OFFSET;
+
+};
+#endif //PROJECT_BASE_LIGHTBAKER_H
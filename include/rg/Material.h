@@ -0,0 +1,116 @@
+#ifndef PROJECT_BASE_MATERIAL_H
+#define PROJECT_BASE_MATERIAL_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+#include <rg/GpuResources.h>
+#include <rg/Profiler.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// Fixed texture unit of every material slot. Material shaders point their samplers at these units once, with
+// SetMaterialSamplers, so binding a material only binds textures: no sampler names, locations or glUniform calls.
+enum MaterialUnit {
+    DIFFUSE_UNIT = 0,
+    SPECULAR_UNIT = 1,
+    NORMAL_UNIT = 2,
+    HEIGHT_UNIT = 3,
+    MATERIAL_UNITS = 4
+};
+
+// textures of one surface, one per MaterialUnit; 0 leaves the unit alone
+struct Material {
+    GLuint textures[MATERIAL_UNITS] = {};
+
+    void Bind() const {
+        for (int unit = 0; unit < MATERIAL_UNITS; unit++) {
+            if (textures[unit] == 0)
+                continue;
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, textures[unit]);
+        }
+        frameStats.materialBinds++;
+    }
+
+    bool operator==(const Material &other) const {
+        for (int unit = 0; unit < MATERIAL_UNITS; unit++) {
+            if (textures[unit] != other.textures[unit])
+                return false;
+        }
+        return true;
+    }
+};
+
+// points <prefix>texture_diffuse1, texture_specular1, ... at the material units; call once per shader after linking
+void SetMaterialSamplers(Shader &shader, const std::string &prefix) {
+    shader.use();
+    shader.setInt(prefix + "texture_diffuse1", DIFFUSE_UNIT);
+    shader.setInt(prefix + "texture_specular1", SPECULAR_UNIT);
+    shader.setInt(prefix + "texture_normal1", NORMAL_UNIT);
+    shader.setInt(prefix + "texture_height1", HEIGHT_UNIT);
+}
+
+// Finds the material of a texture set while models load. Meshes with the same textures, also across models, share
+// one Material, owned by the meshes that use it: the library only keeps weak references, so a material is gone once
+// the last mesh using it is (the model copies of the reload check, for one). A missing diffuse map samples white and
+// a missing specular map black, the same convention StaticBatch uses for its texture array.
+class MaterialLibrary {
+public:
+    std::shared_ptr<const Material> Get(const Material &material) {
+        Material resolved = material;
+        if (resolved.textures[DIFFUSE_UNIT] == 0)
+            resolved.textures[DIFFUSE_UNIT] = solidTexture(whiteTexture, 255);
+        if (resolved.textures[SPECULAR_UNIT] == 0)
+            resolved.textures[SPECULAR_UNIT] = solidTexture(blackTexture, 0);
+
+        // materials of released meshes are dropped here, before their texture names can be reused
+        materials.erase(std::remove_if(materials.begin(), materials.end(),
+                                       [](const std::weak_ptr<const Material> &entry) { return entry.expired(); }),
+                        materials.end());
+        for (const std::weak_ptr<const Material> &entry: materials) {
+            std::shared_ptr<const Material> existing = entry.lock();
+            if (*existing == resolved)
+                return existing;
+        }
+        std::shared_ptr<const Material> created = std::make_shared<Material>(resolved);
+        materials.push_back(created);
+        return created;
+    }
+
+    // materials some mesh still uses
+    unsigned Count() const {
+        return std::count_if(materials.begin(), materials.end(),
+                             [](const std::weak_ptr<const Material> &entry) { return !entry.expired(); });
+    }
+
+private:
+    std::vector<std::weak_ptr<const Material>> materials;
+    GpuRef whiteTexture;
+    GpuRef blackTexture;
+
+    // 1x1 texture of one grey level, created on first use
+    static GLuint solidTexture(GpuRef &texture, unsigned char value) {
+        if (texture == 0) {
+            const unsigned char texel[4] = {value, value, value, 255};
+            texture = GpuRef(GPU_TEXTURE);
+            texture.SetBytes(TextureBytes(1, 1, 4));
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        return texture;
+    }
+};
+
+MaterialLibrary materialLibrary;
+
+};
+#endif //PROJECT_BASE_MATERIAL_H
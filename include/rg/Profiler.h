@@ -0,0 +1,162 @@
+#ifndef PROJECT_BASE_PROFILER_H
+#define PROJECT_BASE_PROFILER_H
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+namespace rg {
+
+// counters filled in while a frame is recorded, reset at the start of every frame
+struct FrameStats {
+    unsigned drawCalls = 0;
+    unsigned opaqueDrawCalls = 0;
+    unsigned instancedDrawCalls = 0;
+    // instances left after GPU culling, read back a few frames late
+    unsigned visibleInstances = 0;
+    // static objects outside every view frustum
+    unsigned culledObjects = 0;
+    unsigned uniformCalls = 0;
+    unsigned materialBinds = 0;
+    // heap allocations made while the opaque geometry was submitted, see CountAllocations
+    unsigned submitAllocations = 0;
+    // shadow cascade draws: static casters only when a cascade's cache was redrawn, dynamic ones every frame
+    unsigned shadowStaticDrawCalls = 0;
+    unsigned shadowDynamicDrawCalls = 0;
+    // draws into reflection probe faces, see ReflectionProbes
+    unsigned probeDrawCalls = 0;
+
+    void Reset() {
+        *this = FrameStats();
+    }
+};
+
+FrameStats frameStats;
+
+#ifdef RG_COUNT_ALLOCATIONS
+// heap allocations made by the whole program so far, counted by the replacement operator new at the end of this file
+std::atomic<unsigned long> allocationCount(0);
+#endif
+
+// counts the heap allocations made between construction and Count(), e.g. to check that a draw loop allocates nothing.
+// Counting replaces the global allocator of the whole program, so only a diagnostics build defines
+// RG_COUNT_ALLOCATIONS (cmake -DRG_COUNT_ALLOCATIONS=ON); otherwise Available() is false and Count() is 0
+class CountAllocations {
+public:
+#ifdef RG_COUNT_ALLOCATIONS
+    CountAllocations() : start(allocationCount.load(std::memory_order_relaxed)) {}
+
+    static bool Available() {
+        return true;
+    }
+
+    unsigned Count() const {
+        return allocationCount.load(std::memory_order_relaxed) - start;
+    }
+
+private:
+    unsigned long start;
+#else
+    static bool Available() {
+        return false;
+    }
+
+    unsigned Count() const {
+        return 0;
+    }
+#endif
+};
+
+// measures CPU time between Begin() and End(), smoothed over frames so the value stays readable in ImGui
+class CpuTimer {
+public:
+    void Begin() {
+        start = std::chrono::steady_clock::now();
+    }
+
+    void End() {
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        average = average == 0.0f ? ms : average + (ms - average) * 0.05f;
+    }
+
+    float Milliseconds() const {
+        return average;
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+    float average = 0.0f;
+};
+
+// GL query (GL_TIME_ELAPSED, GL_SAMPLES_PASSED, ...) around a part of the frame. Results are read LATENCY frames
+// later, and only when already available, so measuring never waits for the GPU; the value is smoothed like CpuTimer.
+class GpuQuery {
+public:
+    static const int LATENCY = 3;
+
+    void Init(GLenum queryTarget) {
+        target = queryTarget;
+        glGenQueries(LATENCY, queries);
+    }
+
+    void Begin() {
+        glBeginQuery(target, queries[current]);
+    }
+
+    void End() {
+        glEndQuery(target);
+        issued[current] = true;
+        current = (current + 1) % LATENCY;
+
+        // the query about to be reused was issued LATENCY - 1 frames ago
+        if (issued[current]) {
+            GLint available = 0;
+            glGetQueryObjectiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 result;
+                glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &result);
+                average = average == 0.0 ? result : average + (result - average) * 0.05;
+            }
+        }
+    }
+
+    double Value() const {
+        return average;
+    }
+
+    // for GL_TIME_ELAPSED queries, which report nanoseconds
+    float Milliseconds() const {
+        return average / 1000000.0;
+    }
+
+private:
+    GLenum target = GL_TIME_ELAPSED;
+    GLuint queries[LATENCY] = {};
+    bool issued[LATENCY] = {};
+    int current = 0;
+    double average = 0.0;
+};
+
+};
+
+#ifdef RG_COUNT_ALLOCATIONS
+// replacement global allocation functions; the array forms forward to these
+void *operator new(std::size_t size) {
+    rg::allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *memory = std::malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+    std::free(memory);
+}
+#endif
+#endif //PROJECT_BASE_PROFILER_H
@@ -0,0 +1,300 @@
+#ifndef PROJECT_BASE_REFLECTIONPROBES_H
+#define PROJECT_BASE_REFLECTIONPROBES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/GpuResources.h>
+#include <rg/Profiler.h>
+#include <rg/ShaderConstants.h>
+#include <rg/UniformRing.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace rg {
+
+// Reflection probes captured at run time and refreshed a step at a time: a refresh is six face renders and then one
+// step that filters the mip chain, and every frame runs as many steps as fit a GPU time budget (at least one while a
+// probe needs work). Faces go into a capture cubemap that replaces the shown one when its mips are done, so a probe
+// never shows a half-updated cube. Probes draw the scene through a callback, meant for a cheap probe-only shader and
+// a coarse LOD; the mips are box filtered and the shaders pick them by roughness like the prefiltered sky.
+// The scheduler finishes the refresh in progress, then starts the stalest probe relative to its distance from the
+// camera. Moving objects report their transform with Track, and a probe gets staler by how far the object's bounding
+// sphere moved or turned as seen from it.
+class ReflectionProbes {
+public:
+    static const GLsizei SIZE = 128;
+    static const int LEVELS = 6;
+    static const int MAX_PROBES = 4;
+    // texture unit of the probe shown by the lit shaders, after the prefiltered sky and its LUT
+    static const int PROBE_UNIT = 14;
+    // six faces, then the mip chain
+    static const int STEPS = 7;
+    // probes staler than this (roughly the angle in radians that objects moved by as seen from the probe) refresh
+    static constexpr float STALE_THRESHOLD = 0.002f;
+
+    void Init() {
+        fbo = GpuRef(GPU_FRAMEBUFFER);
+        depth = GpuRef(GPU_RENDERBUFFER);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, SIZE, SIZE);
+        depth.SetBytes(TextureBytes(SIZE, SIZE, 4));
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        stepTimer.Init(GL_TIME_ELAPSED);
+    }
+
+    static void SetSamplers(Shader &shader) {
+        shader.use();
+        shader.setInt("probeMap", PROBE_UNIT);
+    }
+
+    // a probe at position whose cubemap the lit shaders use for surfaces within radius of it
+    void Add(const glm::vec3 &position, float radius) {
+        if (probes.size() == MAX_PROBES)
+            return;
+        Probe probe;
+        probe.position = position;
+        probe.radius = radius;
+        probe.shown = createCubemap();
+        probe.capture = createCubemap();
+        probes.push_back(std::move(probe));
+    }
+
+    // a moving object the probes see, called every frame with its transform and model space bounding sphere radius
+    void Track(int object, const glm::mat4 &transform, float radius) {
+        if (object >= (int) tracked.size())
+            tracked.resize(object + 1);
+        Tracked &entry = tracked[object];
+        glm::vec3 center = glm::vec3(transform[3]);
+        glm::vec3 axes[3];
+        for (int i = 0; i < 3; i++)
+            axes[i] = glm::vec3(transform[i]) * radius;
+        if (entry.valid) {
+            // how far the sphere's center and the ends of its axes moved
+            float moved = glm::length(center - entry.center);
+            for (int i = 0; i < 3; i++)
+                moved = std::max(moved, glm::length(center + axes[i] - entry.center - entry.axes[i]));
+            for (Probe &probe: probes) {
+                float distance = std::max(glm::length(center - probe.position), glm::length(axes[0]));
+                probe.staleness += moved / std::max(distance, 1e-3f);
+            }
+        }
+        entry.valid = true;
+        entry.center = center;
+        std::copy(axes, axes + 3, entry.axes);
+    }
+
+    // everything the probes see changed (the sky, the sun): each one is captured again, in the usual order
+    void Invalidate() {
+        for (Probe &probe: probes)
+            probe.staleness = std::max(probe.staleness, 1.0f);
+    }
+
+    // runs refresh steps until the next would exceed budgetMilliseconds by the measured cost of a step. Every face
+    // pushes frame with the probe's camera; drawScene(probe position) then draws into the bound face. Leaves the
+    // framebuffer unbound, restores the viewport; the caller binds its own FrameBlock range again.
+    template<typename DrawScene>
+    void Update(const glm::vec3 &cameraPosition, float budgetMilliseconds, FrameConstants frame, UniformRing &ring,
+                DrawScene drawScene) {
+        stepsLastFrame = 0;
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        float estimate = stepTimer.Milliseconds() > 0.0f ? stepTimer.Milliseconds() : budgetMilliseconds;
+
+        // at most one refresh worth of steps, which also bounds the frame constants pushed into the ring
+        while (stepsLastFrame < STEPS) {
+            int next = active >= 0 ? active : pickProbe(cameraPosition);
+            if (next < 0 || (stepsLastFrame > 0 && (stepsLastFrame + 1) * estimate > budgetMilliseconds))
+                break;
+            active = next;
+            Probe &probe = probes[active];
+            if (probe.step == 0)
+                probe.staleness = 0.0f;
+
+            // the first step of a frame is timed; all steps are taken to cost the same
+            if (stepsLastFrame == 0)
+                stepTimer.Begin();
+            if (probe.step < 6)
+                renderFace(probe, probe.step, frame, ring, drawScene);
+            else
+                finish(probe);
+            if (stepsLastFrame == 0)
+                stepTimer.End();
+
+            stepsLastFrame++;
+            probe.step = (probe.step + 1) % STEPS;
+            if (probe.step == 0)
+                active = -1;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+
+    // the captured probe shown by the lit shaders: one whose radius contains the camera, the nearest such one, or
+    // none; writes it to the frame constants
+    void Select(const glm::vec3 &cameraPosition, FrameConstants &frame) {
+        selected = -1;
+        float best = 1e30f;
+        for (int i = 0; i < (int) probes.size(); i++) {
+            float distance = glm::length(cameraPosition - probes[i].position);
+            if (probes[i].captured && distance < probes[i].radius && distance < best) {
+                best = distance;
+                selected = i;
+            }
+        }
+        frame.reflectionProbe = selected < 0 ? glm::vec4(0.0f) :
+                                glm::vec4(probes[selected].position, probes[selected].radius);
+        frame.probeMaxLod = LEVELS - 1;
+    }
+
+    void Bind() const {
+        if (selected < 0)
+            return;
+        glActiveTexture(GL_TEXTURE0 + PROBE_UNIT);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, probes[selected].shown);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    int ProbeCount() const {
+        return probes.size();
+    }
+
+    // -1 when no probe is shown
+    int Selected() const {
+        return selected;
+    }
+
+    // probe refreshing now, -1 when idle
+    int Active() const {
+        return active;
+    }
+
+    int StepsLastFrame() const {
+        return stepsLastFrame;
+    }
+
+    // GPU time of one refresh step, the estimate the budget is spent by
+    float StepMilliseconds() const {
+        return stepTimer.Milliseconds();
+    }
+
+    float Staleness(int probe) const {
+        return probes[probe].staleness;
+    }
+
+    unsigned Refreshes(int probe) const {
+        return probes[probe].refreshes;
+    }
+
+private:
+    struct Probe {
+        glm::vec3 position;
+        float radius;
+        GpuRef shown;
+        GpuRef capture;
+        int step = 0;
+        float staleness = 0.0f;
+        bool captured = false;
+        unsigned refreshes = 0;
+    };
+
+    struct Tracked {
+        bool valid = false;
+        glm::vec3 center;
+        glm::vec3 axes[3];
+    };
+
+    std::vector<Probe> probes;
+    std::vector<Tracked> tracked;
+    GpuRef fbo;
+    GpuRef depth;
+    GpuQuery stepTimer;
+    int active = -1;
+    int selected = -1;
+    int stepsLastFrame = 0;
+
+    // never captured probes first, then the stalest one for its distance from the camera; -1 when none needs work
+    int pickProbe(const glm::vec3 &cameraPosition) const {
+        int best = -1;
+        float bestPriority = 0.0f;
+        for (int i = 0; i < (int) probes.size(); i++) {
+            const Probe &probe = probes[i];
+            if (probe.captured && probe.staleness < STALE_THRESHOLD)
+                continue;
+            float distance = std::max(glm::length(cameraPosition - probe.position) - probe.radius, 1.0f);
+            float priority = (probe.captured ? probe.staleness : 1e6f) / distance;
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    template<typename DrawScene>
+    void renderFace(const Probe &probe, int face, FrameConstants &frame, UniformRing &ring, DrawScene &drawScene) {
+        // the usual cubemap capture cameras, in GL face order
+        static const glm::vec3 forward[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+        static const glm::vec3 up[6] = {{0, -1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {0, -1, 0}, {0, -1, 0}};
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.5f, 1000.0f);
+        glm::mat4 view = glm::lookAt(probe.position, probe.position + forward[face], up[face]);
+        frame.projection = projection;
+        frame.view = view;
+        frame.viewPos = probe.position;
+        frame.viewCount = 1;
+        frame.SetView(0, 1, view, projection, probe.position);
+        ring.PushAndBind(FRAME_BLOCK, frame);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face,
+                               probe.capture, 0);
+        glViewport(0, 0, SIZE, SIZE);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        unsigned drawCallsBefore = frameStats.drawCalls;
+        drawScene(probe.position);
+        frameStats.probeDrawCalls += frameStats.drawCalls - drawCallsBefore;
+    }
+
+    void finish(Probe &probe) {
+        glBindTexture(GL_TEXTURE_CUBE_MAP, probe.capture);
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        std::swap(probe.shown, probe.capture);
+        probe.captured = true;
+        probe.refreshes++;
+    }
+
+    static GpuRef createCubemap() {
+        GpuRef texture(GPU_TEXTURE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+        for (int level = 0; level < LEVELS; level++) {
+            for (int face = 0; face < 6; face++) {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGBA16F, SIZE >> level, SIZE >> level, 0,
+                             GL_RGBA, GL_FLOAT, nullptr);
+            }
+        }
+        texture.SetBytes(TextureBytes(SIZE, SIZE, 8, 1, true) * 6);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, LEVELS - 1);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        return texture;
+    }
+};
+
+constexpr float ReflectionProbes::STALE_THRESHOLD;
+
+};
+#endif //PROJECT_BASE_REFLECTIONPROBES_H
@@ -0,0 +1,425 @@
+#ifndef PROJECT_BASE_RENDERGRAPH_H
+#define PROJECT_BASE_RENDERGRAPH_H
+
+#include <glad/glad.h>
+
+#include <rg/GpuResources.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// size and format of a render target the graph allocates
+struct RenderTargetDesc {
+    GLsizei width = 0;
+    GLsizei height = 0;
+    GLenum format = GL_RGBA8;
+    // 1 for a GL_TEXTURE_2D, more for a GL_TEXTURE_2D_MULTISAMPLE
+    GLsizei samples = 1;
+    // for the memory statistics
+    int bytesPerTexel = 4;
+
+    RenderTargetDesc() = default;
+
+    RenderTargetDesc(GLsizei width, GLsizei height, GLenum format, GLsizei samples, int bytesPerTexel)
+            : width(width), height(height), format(format), samples(samples), bytesPerTexel(bytesPerTexel) {}
+
+    bool operator==(const RenderTargetDesc &other) const {
+        return width == other.width && height == other.height && format == other.format &&
+               samples == other.samples;
+    }
+
+    size_t Bytes() const {
+        return TextureBytes(width, height, bytesPerTexel, samples);
+    }
+
+    GLenum Target() const {
+        return samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+    }
+};
+
+// The frame as a list of passes that declare the resources they read and write, declared again every frame:
+//   - Import names a resource that lives outside the graph (the scene targets, shadow maps, a class's own targets),
+//     Create a transient render target the graph allocates for this frame only
+//   - AddPass records a pass: its setup callback declares reads and writes through a PassBuilder, its execute
+//     callback records the GL work later
+//   - Execute compiles and runs the frame: walking back from the Output resources it keeps only the passes whose
+//     writes something kept reads (a pass that writes an output is always kept), so a pass nobody consumes is
+//     culled. Transient targets live from the first to the last kept pass that uses them and are taken from a pool;
+//     two with the same description whose lifetimes do not overlap share one texture. Pool textures unused for
+//     EVICT_FRAMES frames are deleted.
+// Every pass run is timed with timestamp queries read LATENCY frames later, so they never wait for the GPU and can
+// surround passes that run their own GL_TIME_ELAPSED queries. Each of the LATENCY frame slots grows its queries to
+// the largest pass count seen, so the number of passes is not limited. A transient is written (cleared) before it is
+// read in the frame, so a shared texture never needs its old contents.
+class RenderGraph {
+public:
+    typedef int Resource;
+    static const Resource NONE = -1;
+    static const int LATENCY = 3;
+    static const int EVICT_FRAMES = 120;
+
+    class PassBuilder {
+    public:
+        PassBuilder(RenderGraph &graph, int pass) : graph(graph), pass(pass) {}
+
+        void Read(Resource resource) {
+            if (resource != NONE)
+                graph.passes[pass].reads.push_back(resource);
+        }
+
+        void Write(Resource resource) {
+            if (resource != NONE)
+                graph.passes[pass].writes.push_back(resource);
+        }
+
+    private:
+        RenderGraph &graph;
+        int pass;
+    };
+
+    // starts declaring a new frame; the pool and the timings carry over
+    void Reset() {
+        passes.clear();
+        resources.clear();
+    }
+
+    Resource Import(const char *name) {
+        Node node;
+        node.name = name;
+        resources.push_back(node);
+        return resources.size() - 1;
+    }
+
+    Resource Create(const char *name, const RenderTargetDesc &desc) {
+        Node node;
+        node.name = name;
+        node.transient = true;
+        node.desc = desc;
+        resources.push_back(node);
+        return resources.size() - 1;
+    }
+
+    // what the frame is for, e.g. the default framebuffer
+    void Output(Resource resource) {
+        resources[resource].output = true;
+    }
+
+    // setup(PassBuilder &) declares the pass's reads and writes now, execute() runs if the pass is kept
+    template<typename Setup>
+    void AddPass(const char *name, Setup setup, std::function<void()> execute) {
+        Pass pass;
+        pass.name = name;
+        pass.execute = std::move(execute);
+        passes.push_back(std::move(pass));
+        PassBuilder builder(*this, passes.size() - 1);
+        setup(builder);
+    }
+
+    // texture of a transient target in this frame, valid from the start of Execute
+    GLuint Texture(Resource resource) const {
+        const Node &node = resources[resource];
+        return node.physical >= 0 ? (GLuint) pool[node.physical].texture : 0;
+    }
+
+    void Execute() {
+        compile();
+        collectTimings();
+        // a timestamp before every pass and one after the last; the slot's results were read above, so it can grow
+        std::vector<GLuint> &stamps = timestamps[frameIndex];
+        size_t first = stamps.size();
+        if (first < passes.size() + 1) {
+            stamps.resize(passes.size() + 1);
+            glGenQueries(stamps.size() - first, stamps.data() + first);
+        }
+        runNames[frameIndex].resize(passes.size());
+        int run = 0;
+        for (Pass &pass: passes) {
+            if (pass.culled)
+                continue;
+            glQueryCounter(stamps[run], GL_TIMESTAMP);
+            runNames[frameIndex][run++] = pass.name;
+            pass.execute();
+        }
+        glQueryCounter(stamps[run], GL_TIMESTAMP);
+        runCounts[frameIndex] = run;
+        frameIndex = (frameIndex + 1) % LATENCY;
+        frame++;
+    }
+
+    // declared passes of the last frame, culled ones included
+    int PassCount() const {
+        return passes.size();
+    }
+
+    const char *PassName(int pass) const {
+        return passes[pass].name;
+    }
+
+    bool PassCulled(int pass) const {
+        return passes[pass].culled;
+    }
+
+    // GPU time of the pass, smoothed over the frames it ran in
+    float PassMilliseconds(int pass) const {
+        const Timing *timing = findTiming(passes[pass].name);
+        return timing ? timing->milliseconds : 0.0f;
+    }
+
+    // "reads a, b; writes c" for ImGui
+    std::string PassResources(int pass) const {
+        std::string text = "reads ";
+        appendNames(text, passes[pass].reads);
+        text += "; writes ";
+        appendNames(text, passes[pass].writes);
+        return text;
+    }
+
+    int ResourceCount() const {
+        return resources.size();
+    }
+
+    const char *ResourceName(int resource) const {
+        return resources[resource].name;
+    }
+
+    bool ResourceTransient(int resource) const {
+        return resources[resource].transient;
+    }
+
+    // pool texture of a kept transient, -1 when every pass using it was culled
+    int ResourceSlot(int resource) const {
+        return resources[resource].physical;
+    }
+
+    // the kept passes that first and last use a transient, as indices of the declared passes
+    int ResourceFirstPass(int resource) const {
+        return resources[resource].firstPass;
+    }
+
+    int ResourceLastPass(int resource) const {
+        return resources[resource].lastPass;
+    }
+
+    // bytes of the kept transients if each had its own texture, and of the pool textures they share
+    size_t TransientBytes() const {
+        size_t bytes = 0;
+        for (const Node &node: resources) {
+            if (node.transient && node.physical >= 0)
+                bytes += node.desc.Bytes();
+        }
+        return bytes;
+    }
+
+    size_t PoolBytes() const {
+        size_t bytes = 0;
+        for (const Physical &physical: pool)
+            bytes += physical.desc.Bytes();
+        return bytes;
+    }
+
+    int PoolSize() const {
+        return pool.size();
+    }
+
+    // GPU time from the first to the end of the last kept pass of the latest timed frame, unsmoothed
+    float FrameMilliseconds() const {
+        return frameMs;
+    }
+
+    // deletes every pool texture, e.g. when the targets change size; call between frames
+    void ReleaseTargets() {
+        pool.clear();
+    }
+
+private:
+    struct Pass {
+        const char *name = "";
+        std::vector<Resource> reads;
+        std::vector<Resource> writes;
+        std::function<void()> execute;
+        bool culled = false;
+    };
+
+    struct Node {
+        const char *name = "";
+        bool transient = false;
+        bool output = false;
+        RenderTargetDesc desc;
+        int firstPass = -1;
+        int lastPass = -1;
+        int physical = -1;
+    };
+
+    struct Physical {
+        RenderTargetDesc desc;
+        GpuRef texture;
+        // pass after which it is free again in the frame being compiled
+        int busyUntil = -1;
+        long lastFrame = 0;
+    };
+
+    struct Timing {
+        const char *name;
+        float milliseconds;
+    };
+
+    std::vector<Pass> passes;
+    std::vector<Node> resources;
+    std::vector<Physical> pool;
+    std::vector<Timing> timings;
+    std::vector<GLuint> timestamps[LATENCY];
+    std::vector<const char *> runNames[LATENCY];
+    int runCounts[LATENCY] = {};
+    int frameIndex = 0;
+    long frame = 0;
+    float frameMs = 0.0f;
+
+    void compile() {
+        // culling, back to front: a pass is kept when it writes something needed, and then what it reads is needed
+        std::vector<bool> needed(resources.size(), false);
+        for (size_t i = 0; i < resources.size(); i++)
+            needed[i] = resources[i].output;
+        for (int i = (int) passes.size() - 1; i >= 0; i--) {
+            Pass &pass = passes[i];
+            pass.culled = true;
+            for (Resource resource: pass.writes)
+                pass.culled = pass.culled && !needed[resource];
+            if (pass.culled)
+                continue;
+            for (Resource resource: pass.reads)
+                needed[resource] = true;
+        }
+
+        // lifetimes of the transients over the kept passes
+        for (Node &node: resources) {
+            node.firstPass = node.lastPass = node.physical = -1;
+        }
+        for (int i = 0; i < (int) passes.size(); i++) {
+            if (passes[i].culled)
+                continue;
+            for (const std::vector<Resource> *list: {&passes[i].reads, &passes[i].writes}) {
+                for (Resource resource: *list) {
+                    Node &node = resources[resource];
+                    if (node.firstPass < 0)
+                        node.firstPass = i;
+                    node.lastPass = i;
+                }
+            }
+        }
+
+        // pool textures in pass order: a transient takes the first free one of its description
+        for (Physical &physical: pool)
+            physical.busyUntil = -1;
+        for (int i = 0; i < (int) passes.size(); i++) {
+            for (Node &node: resources) {
+                if (!node.transient || node.firstPass != i)
+                    continue;
+                int slot = -1;
+                for (int p = 0; p < (int) pool.size() && slot < 0; p++) {
+                    if (pool[p].busyUntil < i && pool[p].desc == node.desc)
+                        slot = p;
+                }
+                if (slot < 0) {
+                    pool.push_back(Physical());
+                    slot = pool.size() - 1;
+                    pool[slot].desc = node.desc;
+                    pool[slot].texture = createTexture(node.desc);
+                }
+                pool[slot].busyUntil = node.lastPass;
+                pool[slot].lastFrame = frame;
+                node.physical = slot;
+            }
+        }
+
+        // drop what the frames have not needed for a while; the slots of this frame stay where they are
+        for (int p = (int) pool.size() - 1; p >= 0; p--) {
+            if (frame - pool[p].lastFrame <= EVICT_FRAMES)
+                continue;
+            pool.erase(pool.begin() + p);
+            for (Node &node: resources) {
+                if (node.physical > p)
+                    node.physical--;
+            }
+        }
+    }
+
+    static GpuRef createTexture(const RenderTargetDesc &desc) {
+        GpuRef texture(GPU_TEXTURE);
+        if (desc.samples > 1) {
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture);
+            glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, desc.format, desc.width, desc.height,
+                                    GL_TRUE);
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+        } else {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            GLenum pixelFormat = desc.format == GL_DEPTH_COMPONENT24 || desc.format == GL_DEPTH_COMPONENT32F ?
+                                 GL_DEPTH_COMPONENT : GL_RGBA;
+            glTexImage2D(GL_TEXTURE_2D, 0, desc.format, desc.width, desc.height, 0, pixelFormat, GL_FLOAT, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        texture.SetBytes(desc.Bytes());
+        return texture;
+    }
+
+    // the timestamps of the frame about to be reused were written LATENCY - 1 frames ago
+    void collectTimings() {
+        int count = runCounts[frameIndex];
+        if (count == 0)
+            return;
+        GLint available = 0;
+        glGetQueryObjectiv(timestamps[frameIndex][count], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+        GLuint64 previous;
+        glGetQueryObjectui64v(timestamps[frameIndex][0], GL_QUERY_RESULT, &previous);
+        GLuint64 start = previous;
+        for (int run = 0; run < count; run++) {
+            GLuint64 end;
+            glGetQueryObjectui64v(timestamps[frameIndex][run + 1], GL_QUERY_RESULT, &end);
+            float ms = (end - previous) / 1000000.0f;
+            previous = end;
+            const char *name = runNames[frameIndex][run];
+            Timing *timing = findTiming(name);
+            if (!timing) {
+                timings.push_back({name, ms});
+                continue;
+            }
+            timing->milliseconds += (ms - timing->milliseconds) * 0.05f;
+        }
+        frameMs = (previous - start) / 1000000.0f;
+    }
+
+    Timing *findTiming(const char *name) {
+        for (Timing &timing: timings) {
+            if (std::strcmp(timing.name, name) == 0)
+                return &timing;
+        }
+        return nullptr;
+    }
+
+    const Timing *findTiming(const char *name) const {
+        return const_cast<RenderGraph *>(this)->findTiming(name);
+    }
+
+    void appendNames(std::string &text, const std::vector<Resource> &list) const {
+        if (list.empty())
+            text += "-";
+        for (size_t i = 0; i < list.size(); i++) {
+            if (i > 0)
+                text += ", ";
+            text += resources[list[i]].name;
+        }
+    }
+};
+
+};
+#endif //PROJECT_BASE_RENDERGRAPH_H
@@ -0,0 +1,166 @@
+#ifndef PROJECT_BASE_SHADERCONSTANTS_H
+#define PROJECT_BASE_SHADERCONSTANTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+// CPU mirrors of the std140 uniform blocks in resources/shaders/*_block.glsl. vec3 members are followed by explicit
+// padding because std140 aligns them to 16 bytes.
+
+namespace rg {
+
+// uniform buffer binding points, assigned to every program with Shader::setBlockBinding
+enum UniformBlockBinding {
+    FRAME_BLOCK = 0,
+    OBJECT_BLOCK = 1,
+    POST_BLOCK = 2,
+    SKY_BLOCK = 3,
+    SHADOW_BLOCK = 4
+};
+
+const int MAX_VIEWS = 2;
+const int SHADOW_CASCADES = 3;
+const int SH_COEFFICIENTS = 9;
+
+struct DirLightConstants {
+    glm::vec3 direction; float pad0;
+    glm::vec3 ambient; float pad1;
+    glm::vec3 diffuse; float pad2;
+    glm::vec3 specular; float pad3;
+};
+
+// point lights are not part of FrameBlock, they are binned into clusters and read from a texture buffer (see
+// ClusteredLights.h); the layout is the four RGBA32F texels lighting.glsl fetches per light
+struct PointLightConstants {
+    glm::vec3 position;
+    float radius;
+    glm::vec3 ambient; float pad1;
+    glm::vec3 diffuse; float pad2;
+    glm::vec3 specular; float pad3;
+};
+
+// distance at which the 1 / d^2 falloff brings the brightest term of a point light below 1/256; lighting.glsl fades
+// the light out smoothly at its radius, so this keeps the look of an unbounded light
+float PointLightRange(const PointLightConstants &light) {
+    glm::vec3 brightest = glm::max(light.ambient, glm::max(light.diffuse, light.specular));
+    return std::sqrt(glm::max(brightest.r, glm::max(brightest.g, brightest.b)) * 256.0f);
+}
+
+struct SpotLightConstants {
+    glm::vec3 position; float pad0;
+    glm::vec3 direction;
+    float cutOff;
+    float outerCutOff; float pad1[3];
+    glm::vec3 ambient; float pad2;
+    glm::vec3 diffuse; float pad3;
+    glm::vec3 specular; float pad4;
+};
+
+struct FrameConstants {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPos;
+    float shininess;
+    GLint blinn;
+    GLint pointLightCount;
+    GLint viewCount; float pad0;
+
+    DirLightConstants directional;
+    // cluster grid size (x, y, z, clusters per view) and depth slicing (first slice depth, log scale), see
+    // ClusteredLights
+    glm::ivec4 clusterGrid;
+    glm::vec4 clusterDepth;
+    SpotLightConstants spotlight;
+
+    glm::mat4 views[MAX_VIEWS];
+    glm::mat4 projections[MAX_VIEWS];
+    glm::vec4 viewPositions[MAX_VIEWS];
+    glm::vec4 viewSlices[MAX_VIEWS];
+
+    // directional light shadows, see ShadowCascades: world to light clip space of every cascade, the main camera's
+    // view depth where each cascade ends (xyz) and 1 in w when shadows are on
+    glm::mat4 shadowMatrices[SHADOW_CASCADES];
+    glm::vec4 shadowSplits;
+
+    // baked static lighting, see LightBaker: surfaces with baked light use it when on and skip the first
+    // bakedPointLights cluster lights
+    GLint bakedLighting;
+    GLint bakedPointLights;
+    // scale of SkyBlock's irradiance on the ambient terms, 0 for the constant ambient colours
+    float skyAmbient;
+    // scale of the prefiltered sky reflections on specular surfaces (see SpecularEnvironment), 0 for none, and the
+    // environment map's last mip level
+    float environmentStrength;
+    float environmentMaxLod;
+    // the shown runtime reflection probe (see ReflectionProbes): its last mip, position (xyz) and radius of influence
+    // (w), 0 when no probe is shown
+    float probeMaxLod; float pad1[2];
+    glm::vec4 reflectionProbe;
+    // the atmosphere's sky, see Atmosphere::SetFrameConstants: direction towards the sun (xyz) and elevation of the
+    // horizon (w), radiance of the sun's disk (rgb) and the cosine of its angular radius (w)
+    glm::vec4 skySun;
+    glm::vec4 sunDisk;
+
+    // view i of count renders into the i-th of count equal-width vertical strips of the target
+    void SetView(int i, int count, const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix,
+                 const glm::vec3 &position) {
+        views[i] = viewMatrix;
+        projections[i] = projectionMatrix;
+        viewPositions[i] = glm::vec4(position, 1.0f);
+        viewSlices[i] = glm::vec4(1.0f / count, (2.0f * i + 1.0f) / count - 1.0f, 0.0f, 0.0f);
+    }
+};
+
+struct ObjectConstants {
+    glm::mat4 model;
+    glm::mat4 normalMatrix;
+    glm::vec4 objectColor;
+
+    static ObjectConstants From(const glm::mat4 &model, const glm::vec4 &color = glm::vec4(1.0f)) {
+        ObjectConstants constants;
+        constants.model = model;
+        constants.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(model))));
+        constants.objectColor = color;
+        return constants;
+    }
+};
+
+// cascade a shadow pass renders, one range of the uniform ring per cascade, see ShadowCascades::Render
+struct ShadowConstants {
+    GLint cascade; GLint pad0[3];
+};
+
+// sky irradiance over pi as the coefficients of a quadratic polynomial of the normal, see SkyIrradiance; written once
+struct SkyConstants {
+    glm::vec4 coefficients[SH_COEFFICIENTS];
+};
+
+struct PostConstants {
+    GLint screenWidth;
+    GLint screenHeight;
+    GLint horizontal;
+    GLint hdr;
+    GLint bloom;
+    GLint gammaEnabled;
+    GLint grayscale;
+    float exposure;
+    // ambient occlusion, see Ssao: on, resolution divisor, hemisphere samples and radius; the camera's projection
+    // scale (x, y) and near and far planes (z, w); exponent applied to the result
+    GLint ssao;
+    GLint ssaoScale;
+    GLint ssaoSamples;
+    float ssaoRadius;
+    glm::vec4 ssaoProjection;
+    float ssaoIntensity;
+    // bloom, see Bloom: the glow's scale in the composite and the upsampling tent's radius in texels
+    float bloomStrength;
+    float bloomRadius;
+    // size of the default framebuffer the composite upscales the scene (screenWidth x screenHeight) to
+    GLint outputWidth;
+    GLint outputHeight; float pad0[3];
+};
+
+};
+#endif //PROJECT_BASE_SHADERCONSTANTS_H
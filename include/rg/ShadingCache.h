@@ -0,0 +1,471 @@
+#ifndef PROJECT_BASE_SHADINGCACHE_H
+#define PROJECT_BASE_SHADINGCACHE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/Bounds.h>
+#include <rg/GpuResources.h>
+#include <rg/Material.h>
+#include <rg/Profiler.h>
+#include <rg/ShaderConstants.h>
+#include <rg/UniformRing.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace rg {
+
+// Texture-space shading for static objects. Every object gets an atlas with a square cell of texels per triangle,
+// and shading_cache.vs/fs write the diffuse light of the static lights (ambient, the sun with its shadow, the baked
+// or static point lights) into it; the lit pass then draws the object with model_cached.vs/fs, which multiply the
+// cached light by the albedo and add only what depends on the camera: specular terms, reflections and the lights
+// that move (tracers, the camera's spotlight).
+// Cells are grouped into pages of PAGE_CELLS x PAGE_CELLS triangles that are close together in the object (sorted
+// along a Morton curve), and pages are shaded as a whole. Invalidate marks pages stale when a light changes; Update
+// then shades the stale pages that are in view or near the camera, nearest first, at most a budget per frame.
+// A triangle's cell is shaded as a quad with its attributes extrapolated over the whole cell, while the lit pass
+// samples a triangle inset by a texel and a half, so bilinear filtering never reads another triangle's light.
+// Each cell holds its own copy of the vertices, so the cached draws do not use the meshes' index buffers.
+class ShadingCache {
+public:
+    // texture unit of the atlas while the cached objects are drawn, the last one GL 3.3 guarantees
+    static const int ATLAS_UNIT = 15;
+    // vertex attribute of the atlas coordinates, after the baked light
+    static const int ATLAS_ATTRIBUTE = 11;
+    static const int PAGE_CELLS = 16;
+    // cell size in texels; atlases aim at ATLAS_SIZE texels square and only grow past it with cells of MIN_CELL
+    static const int MIN_CELL = 4;
+    static const int MAX_CELL = 32;
+    static const int ATLAS_SIZE = 1024;
+
+    // object is the caller's index, used again by Draw; the model must only be drawn with this transform
+    void Add(int object, const Model &model, const glm::mat4 &transform) {
+        std::vector<Triangle> triangles;
+        for (const Mesh &mesh: model.meshes) {
+            for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+                Triangle triangle;
+                triangle.mesh = &mesh;
+                for (int corner = 0; corner < 3; corner++)
+                    triangle.indices[corner] = mesh.indices[i + corner];
+                triangles.push_back(triangle);
+            }
+        }
+        if (triangles.empty())
+            return;
+
+        Object entry;
+        entry.object = object;
+        entry.constants = ObjectConstants::From(transform);
+        layout(entry, triangles.size());
+        sortAlongMortonCurve(triangles);
+
+        // raster vertices in page order, six per triangle (the cell as two triangles)
+        std::vector<RasterVertex> raster;
+        raster.reserve(triangles.size() * 6);
+        std::vector<glm::vec2> sampleCoords(triangles.size() * 3);
+        for (size_t t = 0; t < triangles.size(); t++) {
+            if (t % (PAGE_CELLS * PAGE_CELLS) == 0) {
+                Page page;
+                page.first = raster.size();
+                entry.pages.push_back(page);
+            }
+            Page &page = entry.pages.back();
+            page.count += 6;
+            const Triangle &triangle = triangles[t];
+            glm::vec2 cell = cellOrigin(entry, t);
+            // triangle corners in texels: right angle at the cell's corner, a texel and a half from every edge
+            float inset = 1.5f, leg = entry.cellSize - 2.0f * inset;
+            glm::vec2 corners[3] = {cell + glm::vec2(inset), cell + glm::vec2(inset + leg, inset),
+                                    cell + glm::vec2(inset, inset + leg)};
+            for (int corner = 0; corner < 3; corner++) {
+                sampleCoords[t * 3 + corner] = corners[corner] / glm::vec2(entry.width, entry.height);
+                const Vertex &vertex = triangle.mesh->vertices[triangle.indices[corner]];
+                page.bounds.Extend(glm::vec3(transform * glm::vec4(vertex.Position, 1.0f)));
+            }
+            glm::vec2 quad[6] = {{0, 0}, {1, 0}, {1, 1}, {0, 0}, {1, 1}, {0, 1}};
+            for (const glm::vec2 &q: quad) {
+                glm::vec2 texel = cell + q * (float) entry.cellSize;
+                raster.push_back(extrapolate(triangle, corners, texel, entry));
+            }
+        }
+
+        // drawn vertices in mesh order, one range per mesh so its material is bound once
+        std::vector<DrawVertex> draw;
+        draw.reserve(triangles.size() * 3);
+        std::vector<size_t> cellOf(triangles.size());
+        for (size_t t = 0; t < triangles.size(); t++)
+            cellOf[t] = t;
+        std::stable_sort(cellOf.begin(), cellOf.end(), [&](size_t a, size_t b) {
+            return triangles[a].mesh < triangles[b].mesh ||
+                   (triangles[a].mesh == triangles[b].mesh && triangles[a].order < triangles[b].order);
+        });
+        for (size_t t: cellOf) {
+            const Triangle &triangle = triangles[t];
+            if (entry.parts.empty() || entry.parts.back().material != triangle.mesh->material.get()) {
+                Part part;
+                part.material = triangle.mesh->material.get();
+                part.first = draw.size();
+                entry.parts.push_back(part);
+            }
+            entry.parts.back().count += 3;
+            for (int corner = 0; corner < 3; corner++) {
+                const Vertex &vertex = triangle.mesh->vertices[triangle.indices[corner]];
+                draw.push_back({vertex.Position, vertex.Normal, vertex.TexCoords, sampleCoords[t * 3 + corner]});
+            }
+        }
+
+        createTargets(entry);
+        upload(entry, raster, draw);
+        totalPages += entry.pages.size();
+        objects.push_back(std::move(entry));
+    }
+
+    static void SetSamplers(Shader &shader) {
+        shader.use();
+        shader.setInt("shadingAtlas", ATLAS_UNIT);
+    }
+
+    bool Contains(int object) const {
+        return find(object) != nullptr;
+    }
+
+    // every page is shaded again, as soon as Update gets to it
+    void Invalidate() {
+        for (Object &object: objects) {
+            for (Page &page: object.pages)
+                page.stale = true;
+        }
+    }
+
+    // the pages that reach into a sphere are shaded again
+    void InvalidateSphere(const glm::vec3 &center, float radius) {
+        for (Object &object: objects) {
+            for (Page &page: object.pages) {
+                if (glm::length(page.bounds.Center() - center) < radius + page.bounds.Radius())
+                    page.stale = true;
+            }
+        }
+    }
+
+    // shades up to pageBudget stale pages that intersect the frustum or lie within nearDistance of the camera,
+    // nearest first; the first call shades every page. Needs the frame's constants, clusters and shadow maps bound.
+    // Leaves the framebuffer unbound and restores the viewport.
+    void Update(Shader &cacheShader, UniformRing &ring, const Frustum &frustum, const glm::vec3 &cameraPosition,
+                float nearDistance, int pageBudget) {
+        pagesLastFrame = 0;
+        candidates.clear();
+        for (size_t o = 0; o < objects.size(); o++) {
+            for (size_t p = 0; p < objects[o].pages.size(); p++) {
+                const Page &page = objects[o].pages[p];
+                if (!page.stale)
+                    continue;
+                float distance = std::max(glm::length(page.bounds.Center() - cameraPosition) - page.bounds.Radius(),
+                                          0.0f);
+                if (primed && distance > nearDistance &&
+                    !frustum.IntersectsSphere(page.bounds.Center(), page.bounds.Radius()))
+                    continue;
+                candidates.push_back({distance, (int) o, (int) p});
+            }
+        }
+        stalePages = 0;
+        for (const Object &object: objects) {
+            for (const Page &page: object.pages)
+                stalePages += page.stale;
+        }
+        if (candidates.empty())
+            return;
+        size_t count = primed ? std::min(candidates.size(), (size_t) std::max(pageBudget, 0)) : candidates.size();
+        std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+        // pages of one object together, so its target and constants are bound once
+        std::sort(candidates.begin(), candidates.begin() + count, [](const Candidate &a, const Candidate &b) {
+            return a.object < b.object || (a.object == b.object && a.page < b.page);
+        });
+        primed = true;
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST), blend = glIsEnabled(GL_BLEND);
+        GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        glDisable(GL_CULL_FACE);
+        cacheShader.use();
+        int bound = -1;
+        for (size_t i = 0; i < count; i++) {
+            Object &object = objects[candidates[i].object];
+            Page &page = object.pages[candidates[i].page];
+            if (candidates[i].object != bound) {
+                bound = candidates[i].object;
+                glBindFramebuffer(GL_FRAMEBUFFER, object.fbo);
+                glViewport(0, 0, object.width, object.height);
+                ring.PushAndBind(OBJECT_BLOCK, object.constants);
+                glBindVertexArray(object.rasterVAO);
+            }
+            glDrawArrays(GL_TRIANGLES, page.first, page.count);
+            frameStats.drawCalls++;
+            page.stale = false;
+            stalePages--;
+            pagesLastFrame++;
+        }
+        glBindVertexArray(0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+        if (blend)
+            glEnable(GL_BLEND);
+        if (cullFace)
+            glEnable(GL_CULL_FACE);
+    }
+
+    // draws a cached object with its atlas bound; shader is model_cached.vs/fs or a depth pass shader
+    void Draw(int object, UniformRing &ring) const {
+        const Object *entry = find(object);
+        ring.PushAndBind(OBJECT_BLOCK, entry->constants);
+        glActiveTexture(GL_TEXTURE0 + ATLAS_UNIT);
+        glBindTexture(GL_TEXTURE_2D, entry->atlas);
+        glBindVertexArray(entry->drawVAO);
+        for (const Part &part: entry->parts) {
+            part.material->Bind();
+            glDrawArrays(GL_TRIANGLES, part.first, part.count);
+            frameStats.drawCalls++;
+        }
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    int PageCount() const {
+        return totalPages;
+    }
+
+    int StalePages() const {
+        return stalePages;
+    }
+
+    int PagesLastFrame() const {
+        return pagesLastFrame;
+    }
+
+    // texels in all atlases
+    size_t Texels() const {
+        size_t texels = 0;
+        for (const Object &object: objects)
+            texels += (size_t) object.width * object.height;
+        return texels;
+    }
+
+    // cell size in texels of an object's atlas, 0 if it is not cached
+    int CellSize(int object) const {
+        const Object *entry = find(object);
+        return entry ? entry->cellSize : 0;
+    }
+
+private:
+    struct Triangle {
+        const Mesh *mesh;
+        unsigned int indices[3];
+        // position in the model, kept for the draw order
+        size_t order = 0;
+        uint32_t morton = 0;
+    };
+
+    struct RasterVertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec4 bakedLight;
+        glm::vec2 atlasCoords;
+    };
+
+    struct DrawVertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 texCoords;
+        glm::vec2 atlasCoords;
+    };
+
+    struct Page {
+        // world space bounds of its triangles
+        Aabb bounds;
+        GLint first = 0;
+        GLsizei count = 0;
+        bool stale = true;
+    };
+
+    struct Part {
+        const Material *material;
+        GLint first = 0;
+        GLsizei count = 0;
+    };
+
+    struct Object {
+        int object;
+        ObjectConstants constants;
+        int cellSize = MIN_CELL;
+        int pagesPerRow = 1;
+        GLsizei width = 0;
+        GLsizei height = 0;
+        std::vector<Page> pages;
+        std::vector<Part> parts;
+        GpuRef atlas;
+        GpuRef fbo;
+        GpuRef rasterVAO, rasterVBO;
+        GpuRef drawVAO, drawVBO;
+    };
+
+    struct Candidate {
+        float distance;
+        int object;
+        int page;
+
+        bool operator<(const Candidate &other) const {
+            return distance < other.distance;
+        }
+    };
+
+    std::vector<Object> objects;
+    std::vector<Candidate> candidates;
+    int totalPages = 0;
+    int stalePages = 0;
+    int pagesLastFrame = 0;
+    bool primed = false;
+
+    const Object *find(int object) const {
+        for (const Object &entry: objects) {
+            if (entry.object == object)
+                return &entry;
+        }
+        return nullptr;
+    }
+
+    // pages in rows as close to square as possible, cells as large as ATLAS_SIZE allows
+    static void layout(Object &object, size_t triangleCount) {
+        size_t cellsPerPage = PAGE_CELLS * PAGE_CELLS;
+        int pages = (triangleCount + cellsPerPage - 1) / cellsPerPage;
+        object.pagesPerRow = (int) std::ceil(std::sqrt((double) pages));
+        int rows = (pages + object.pagesPerRow - 1) / object.pagesPerRow;
+        object.cellSize = glm::clamp(ATLAS_SIZE / (object.pagesPerRow * PAGE_CELLS), MIN_CELL, MAX_CELL);
+        object.width = object.pagesPerRow * PAGE_CELLS * object.cellSize;
+        object.height = rows * PAGE_CELLS * object.cellSize;
+    }
+
+    // lower left corner in texels of triangle t's cell: pages row by row, cells row by row inside their page
+    static glm::vec2 cellOrigin(const Object &object, size_t t) {
+        size_t cellsPerPage = PAGE_CELLS * PAGE_CELLS;
+        int page = t / cellsPerPage, cell = t % cellsPerPage;
+        int x = (page % object.pagesPerRow) * PAGE_CELLS + cell % PAGE_CELLS;
+        int y = (page / object.pagesPerRow) * PAGE_CELLS + cell / PAGE_CELLS;
+        return glm::vec2(x, y) * (float) object.cellSize;
+    }
+
+    // spreads the low 10 bits of v three apart
+    static uint32_t spreadBits(uint32_t v) {
+        v &= 0x3ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8)) & 0x0300f00f;
+        v = (v | (v << 4)) & 0x030c30c3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    static void sortAlongMortonCurve(std::vector<Triangle> &triangles) {
+        Aabb bounds;
+        std::vector<glm::vec3> centroids(triangles.size());
+        for (size_t t = 0; t < triangles.size(); t++) {
+            const Triangle &triangle = triangles[t];
+            glm::vec3 sum(0.0f);
+            for (int corner = 0; corner < 3; corner++)
+                sum += triangle.mesh->vertices[triangle.indices[corner]].Position;
+            centroids[t] = sum / 3.0f;
+            bounds.Extend(centroids[t]);
+        }
+        glm::vec3 extent = glm::max(bounds.maximum - bounds.minimum, glm::vec3(1e-6f));
+        for (size_t t = 0; t < triangles.size(); t++) {
+            glm::uvec3 cell = glm::uvec3(glm::clamp((centroids[t] - bounds.minimum) / extent, 0.0f, 1.0f) * 1023.0f);
+            triangles[t].order = t;
+            triangles[t].morton = spreadBits(cell.x) | spreadBits(cell.y) << 1 | spreadBits(cell.z) << 2;
+        }
+        std::stable_sort(triangles.begin(), triangles.end(), [](const Triangle &a, const Triangle &b) {
+            return a.morton < b.morton;
+        });
+    }
+
+    // the triangle's attributes at an atlas texel position, extended linearly past its corners
+    static RasterVertex extrapolate(const Triangle &triangle, const glm::vec2 corners[3], const glm::vec2 &texel,
+                                    const Object &object) {
+        glm::vec2 e1 = corners[1] - corners[0], e2 = corners[2] - corners[0], d = texel - corners[0];
+        float determinant = e1.x * e2.y - e1.y * e2.x;
+        float b1 = (d.x * e2.y - d.y * e2.x) / determinant;
+        float b2 = (e1.x * d.y - e1.y * d.x) / determinant;
+        float weights[3] = {1.0f - b1 - b2, b1, b2};
+
+        RasterVertex result = {glm::vec3(0.0f), glm::vec3(0.0f), glm::vec4(0.0f), glm::vec2(0.0f)};
+        const Mesh &mesh = *triangle.mesh;
+        for (int corner = 0; corner < 3; corner++) {
+            unsigned int index = triangle.indices[corner];
+            result.position += mesh.vertices[index].Position * weights[corner];
+            result.normal += mesh.vertices[index].Normal * weights[corner];
+            if (!mesh.bakedLight.empty())
+                result.bakedLight += mesh.bakedLight[index] * weights[corner];
+        }
+        result.atlasCoords = texel / glm::vec2(object.width, object.height);
+        return result;
+    }
+
+    static void createTargets(Object &object) {
+        object.atlas = GpuRef(GPU_TEXTURE);
+        glBindTexture(GL_TEXTURE_2D, object.atlas);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, object.width, object.height, 0, GL_RGB, GL_FLOAT, nullptr);
+        object.atlas.SetBytes(TextureBytes(object.width, object.height, 4));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        object.fbo = GpuRef(GPU_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, object.fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, object.atlas, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Shading cache framebuffer not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    static void upload(Object &object, const std::vector<RasterVertex> &raster, const std::vector<DrawVertex> &draw) {
+        object.rasterVAO = GpuRef(GPU_VERTEX_ARRAY);
+        object.rasterVBO = GpuRef(GPU_BUFFER);
+        glBindVertexArray(object.rasterVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, object.rasterVBO);
+        glBufferData(GL_ARRAY_BUFFER, raster.size() * sizeof(RasterVertex), raster.data(), GL_STATIC_DRAW);
+        object.rasterVBO.SetBytes(raster.size() * sizeof(RasterVertex));
+        attribute(0, 3, sizeof(RasterVertex), offsetof(RasterVertex, position));
+        attribute(1, 3, sizeof(RasterVertex), offsetof(RasterVertex, normal));
+        attribute(10, 4, sizeof(RasterVertex), offsetof(RasterVertex, bakedLight));
+        attribute(ATLAS_ATTRIBUTE, 2, sizeof(RasterVertex), offsetof(RasterVertex, atlasCoords));
+
+        object.drawVAO = GpuRef(GPU_VERTEX_ARRAY);
+        object.drawVBO = GpuRef(GPU_BUFFER);
+        glBindVertexArray(object.drawVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, object.drawVBO);
+        glBufferData(GL_ARRAY_BUFFER, draw.size() * sizeof(DrawVertex), draw.data(), GL_STATIC_DRAW);
+        object.drawVBO.SetBytes(draw.size() * sizeof(DrawVertex));
+        attribute(0, 3, sizeof(DrawVertex), offsetof(DrawVertex, position));
+        attribute(1, 3, sizeof(DrawVertex), offsetof(DrawVertex, normal));
+        attribute(2, 2, sizeof(DrawVertex), offsetof(DrawVertex, texCoords));
+        attribute(ATLAS_ATTRIBUTE, 2, sizeof(DrawVertex), offsetof(DrawVertex, atlasCoords));
+        glBindVertexArray(0);
+    }
+
+    static void attribute(GLuint location, GLint size, GLsizei stride, size_t offset) {
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, stride, (void *) offset);
+    }
+};
+
+};
+#endif //PROJECT_BASE_SHADINGCACHE_H
@@ -0,0 +1,218 @@
+#ifndef PROJECT_BASE_SHADOWCASCADES_H
+#define PROJECT_BASE_SHADOWCASCADES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/Bounds.h>
+#include <rg/GpuResources.h>
+#include <rg/Profiler.h>
+#include <rg/ShaderConstants.h>
+#include <rg/UniformRing.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace rg {
+
+// Cascaded shadow maps for the directional light, with the static casters cached per cascade.
+// Every cascade is an orthographic box around the bounding sphere of its slice of the camera frustum, so its size only
+// depends on the field of view and the split distances, and its center is snapped to a grid of SNAP_TEXELS texels in
+// light space; the box is made that much larger so the slice always fits. Until the camera crosses a grid line the
+// cascade matrix stays bit-for-bit the same and the static casters, drawn into a cache layer when it changed, are
+// reused: each frame the cache layer is copied into the sampled map and only the dynamic casters are drawn on top.
+class ShadowCascades {
+public:
+    static const GLsizei SIZE = 2048;
+    static const int SNAP_TEXELS = 64;
+    // texture unit of the shadow map, after the cluster buffers
+    static const int SHADOW_UNIT = 11;
+
+    // casterBounds must contain every caster (world space), it fixes the depth range of all cascades
+    void Init(const Aabb &casterBounds) {
+        bounds = casterBounds;
+        shadowMap = createArray(true);
+        staticCache = createArray(false);
+        shadowFBO = GpuRef(GPU_FRAMEBUFFER);
+        cacheFBO = GpuRef(GPU_FRAMEBUFFER);
+        for (GLuint fbo: {shadowFBO.Get(), cacheFBO.Get()}) {
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        Invalidate();
+    }
+
+    static void SetSamplers(Shader &shader) {
+        shader.use();
+        shader.setInt("shadowMap", SHADOW_UNIT);
+    }
+
+    // the static casters are drawn again on the next Render, e.g. after one of them moved
+    void Invalidate() {
+        for (Cascade &cascade: cascades)
+            cascade.cached = false;
+    }
+
+    // fits the cascades to the camera frustum up to distance and writes them to the frame constants; lightDirection
+    // is the direction the light travels in
+    void Fit(const glm::vec3 &cameraPosition, const glm::vec3 &cameraFront, float fovY, float aspect, float nearPlane,
+             float distance, const glm::vec3 &lightDirection, FrameConstants &frame) {
+        glm::vec3 direction = glm::normalize(lightDirection);
+        glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), direction, up);
+
+        // depth range of the scene along the light, shared by all cascades
+        float minZ = 1e30f, maxZ = -1e30f;
+        for (int corner = 0; corner < 8; corner++) {
+            float z = (lightRotation * glm::vec4(bounds.Corner(corner), 1.0f)).z;
+            minZ = std::min(minZ, z);
+            maxZ = std::max(maxZ, z);
+        }
+
+        float tanY = std::tan(fovY * 0.5f), tanX = tanY * aspect;
+        float sliceNear = nearPlane;
+        for (int i = 0; i < SHADOW_CASCADES; i++) {
+            // practical split scheme: halfway between uniform and logarithmic
+            float t = (i + 1.0f) / SHADOW_CASCADES;
+            float sliceFar = 0.5f * (nearPlane + (distance - nearPlane) * t) +
+                             0.5f * (nearPlane * std::pow(distance / nearPlane, t));
+
+            // bounding sphere of the slice, centered on the view axis between the slice's two planes
+            float middle = 0.5f * (sliceNear + sliceFar);
+            float halfDepth = 0.5f * (sliceFar - sliceNear);
+            float radius = std::sqrt(halfDepth * halfDepth + sliceFar * sliceFar * (tanX * tanX + tanY * tanY));
+            glm::vec3 center = cameraPosition + glm::normalize(cameraFront) * middle;
+
+            float halfExtent = radius / (1.0f - 2.0f * SNAP_TEXELS / SIZE);
+            float snap = SNAP_TEXELS * 2.0f * halfExtent / SIZE;
+            glm::vec3 lightCenter = glm::vec3(lightRotation * glm::vec4(center, 1.0f));
+            glm::vec2 snapped = glm::floor(glm::vec2(lightCenter.x, lightCenter.y) / snap + 0.5f) * snap;
+
+            Cascade &cascade = cascades[i];
+            if (!cascade.cached || snapped != cascade.center || halfExtent != cascade.halfExtent) {
+                cascade.cached = false;
+                cascade.center = snapped;
+                cascade.halfExtent = halfExtent;
+                glm::mat4 projection = glm::ortho(snapped.x - halfExtent, snapped.x + halfExtent,
+                                                  snapped.y - halfExtent, snapped.y + halfExtent,
+                                                  -maxZ - 1.0f, -minZ + 1.0f);
+                cascade.matrix = projection * lightRotation;
+            }
+            frame.shadowMatrices[i] = cascade.matrix;
+            frame.shadowSplits[i] = sliceFar;
+            sliceNear = sliceFar;
+        }
+        frame.shadowSplits.w = 1.0f;
+    }
+
+    // renders every cascade with shader (shadow_depth.vs, which reads the matrices from FrameBlock and the cascade
+    // from ShadowBlock, pushed to ring): drawStatic only for cascades whose cache is stale, drawDynamic always. Both
+    // draw with the current shader and count draw calls into frameStats. Leaves the framebuffer unbound and restores
+    // the viewport.
+    template<typename DrawStatic, typename DrawDynamic>
+    void Render(Shader &shader, UniformRing &ring, DrawStatic drawStatic, DrawDynamic drawDynamic) {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glViewport(0, 0, SIZE, SIZE);
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+        shader.use();
+        staticUpdates = 0;
+
+        for (int i = 0; i < SHADOW_CASCADES; i++) {
+            ShadowConstants shadow = {};
+            shadow.cascade = i;
+            ring.PushAndBind(SHADOW_BLOCK, shadow);
+            Cascade &cascade = cascades[i];
+            cascade.updated = !cascade.cached;
+            if (!cascade.cached) {
+                glBindFramebuffer(GL_FRAMEBUFFER, cacheFBO);
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticCache, 0, i);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                unsigned int drawCallsBefore = frameStats.drawCalls;
+                drawStatic();
+                frameStats.shadowStaticDrawCalls += frameStats.drawCalls - drawCallsBefore;
+                cascade.cached = true;
+                staticUpdates++;
+            }
+
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, cacheFBO);
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticCache, 0, i);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadowFBO);
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMap, 0, i);
+            glBlitFramebuffer(0, 0, SIZE, SIZE, 0, 0, SIZE, SIZE, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
+            unsigned int drawCallsBefore = frameStats.drawCalls;
+            drawDynamic();
+            frameStats.shadowDynamicDrawCalls += frameStats.drawCalls - drawCallsBefore;
+        }
+
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glEnable(GL_CULL_FACE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+
+    void Bind() const {
+        glActiveTexture(GL_TEXTURE0 + SHADOW_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, shadowMap);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // cascades whose static casters were drawn again by the last Render
+    int StaticUpdates() const {
+        return staticUpdates;
+    }
+
+    // whether the last Render drew the static casters of a cascade again
+    bool StaticUpdated(int cascade) const {
+        return cascades[cascade].updated;
+    }
+
+private:
+    struct Cascade {
+        glm::mat4 matrix = glm::mat4(1.0f);
+        glm::vec2 center = glm::vec2(0.0f);
+        float halfExtent = 0.0f;
+        bool cached = false;
+        bool updated = false;
+    };
+
+    Aabb bounds;
+    Cascade cascades[SHADOW_CASCADES];
+    GpuRef shadowMap;
+    GpuRef staticCache;
+    GpuRef shadowFBO;
+    GpuRef cacheFBO;
+    int staticUpdates = 0;
+
+    // depth array with one layer per cascade; the sampled one compares in the sampler for hardware PCF
+    static GpuRef createArray(bool compare) {
+        GpuRef texture(GPU_TEXTURE);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, SIZE, SIZE, SHADOW_CASCADES, 0,
+                     GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        texture.SetBytes(TextureBytes(SIZE, SIZE, 4) * SHADOW_CASCADES);
+        GLenum filter = compare ? GL_LINEAR : GL_NEAREST;
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        if (compare) {
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return texture;
+    }
+};
+
+};
+#endif //PROJECT_BASE_SHADOWCASCADES_H
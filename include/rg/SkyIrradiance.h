@@ -0,0 +1,338 @@
+#ifndef PROJECT_BASE_SKYIRRADIANCE_H
+#define PROJECT_BASE_SKYIRRADIANCE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <rg/Cubemap.h>
+#include <rg/GpuResources.h>
+#include <rg/ShaderConstants.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RG_SH_SSE 1
+#endif
+
+namespace rg {
+
+// Ambient light from the skybox: the cubemap is projected into the nine L2 spherical harmonics at load time and
+// convolved with the cosine lobe, which leaves its irradiance as a quadratic polynomial of the normal (Ramamoorthi and
+// Hanrahan). The polynomial's coefficients are scaled so the average over all directions has luminance 1 and go into
+// SkyBlock (sky_block.glsl); the lit shaders multiply their ambient colour by it, so the overall ambient level stays
+// the one the lights were tuned with while its colour and direction come from the sky.
+// The projection reads the faces back from the texture, four texels at a time with SSE, rows spread over every
+// hardware thread. Rows are summed in a fixed order, so the result does not depend on the thread count. It is cached
+// in a file keyed by a hash of the face files.
+class SkyIrradiance {
+public:
+    struct BenchmarkResult {
+        int faceSize;
+        float milliseconds;
+    };
+
+    // projects cubemap or loads the projection from cacheFile when faceFiles did not change, then uploads SkyBlock;
+    // threads 0 uses one per hardware thread
+    void Init(GLuint cubemap, const std::vector<std::string> &faceFiles, const std::string &cacheFile,
+              unsigned threads = 0) {
+        auto start = std::chrono::steady_clock::now();
+        texture = cubemap;
+        threadCount = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+        uint64_t key = inputKey(faceFiles);
+        fromCache = loadCache(cacheFile, key);
+        if (!fromCache) {
+            std::vector<float> faces = ReadCubemapFaces(texture, faceSize);
+            Project(faces, faceSize, threadCount, radiance);
+            saveCache(cacheFile, key);
+        }
+        Upload(radiance);
+        milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Sky irradiance " << (fromCache ? "loaded from " + cacheFile : "projected") << " in "
+                  << milliseconds << " ms" << std::endl;
+    }
+
+    void Bind() const {
+        glBindBufferBase(GL_UNIFORM_BUFFER, SKY_BLOCK, buffer);
+    }
+
+    // projects the faces again at the loaded size and every smaller power of two down to 16, each one downsampled from
+    // the one before; prints and returns the projection time of every size
+    std::vector<BenchmarkResult> Benchmark() const {
+        std::vector<BenchmarkResult> results;
+        int size = 0;
+        std::vector<float> faces = ReadCubemapFaces(texture, size);
+        while (size >= 16) {
+            glm::vec3 coefficients[SH_COEFFICIENTS];
+            auto start = std::chrono::steady_clock::now();
+            Project(faces, size, threadCount, coefficients);
+            float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            results.push_back({size, ms});
+            std::cout << "Sky irradiance projection " << size << "x" << size << "x6: " << ms << " ms, "
+                      << threadCount << " threads" << std::endl;
+            faces = DownsampleCubemapFaces(faces, size);
+            size /= 2;
+        }
+        return results;
+    }
+
+    // radiance coefficients of the nine basis functions (order: l = 0, then l = 1 and l = 2 with m from -l to l) of
+    // faces laid out as in Cubemap.h
+    static void Project(const std::vector<float> &faces, int size, unsigned threads,
+                       glm::vec3 (&coefficients)[SH_COEFFICIENTS]) {
+        int rows = 6 * size;
+        std::vector<RowSums> sums(rows);
+        std::atomic<int> nextRow(0);
+        auto worker = [&]() {
+            int row;
+            while ((row = nextRow.fetch_add(1)) < rows)
+                projectRow(faces, size, row / size, row % size, sums[row]);
+        };
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < threads; i++)
+            workers.emplace_back(worker);
+        worker();
+        for (std::thread &thread: workers)
+            thread.join();
+
+        double total[SH_COEFFICIENTS * 3] = {}, weight = 0.0;
+        for (const RowSums &row: sums) {
+            for (int i = 0; i < SH_COEFFICIENTS * 3; i++)
+                total[i] += row.color[i];
+            weight += row.weight;
+        }
+        // the texel weights approximate solid angles; scale them so the whole sphere gets exactly 4 pi
+        double scale = weight > 0.0 ? 4.0 * PI / weight : 0.0;
+        for (int i = 0; i < SH_COEFFICIENTS; i++)
+            coefficients[i] = glm::vec3(total[3 * i] * scale, total[3 * i + 1] * scale, total[3 * i + 2] * scale);
+    }
+
+    bool FromCache() const {
+        return fromCache;
+    }
+
+    // time of Init, reading the faces and uploading included
+    float Milliseconds() const {
+        return milliseconds;
+    }
+
+    // 0 when loaded from the cache
+    int FaceSize() const {
+        return faceSize;
+    }
+
+    unsigned Threads() const {
+        return threadCount;
+    }
+
+    // average radiance of the sky, the colour that the shaders' ambient terms are scaled to luminance 1 by
+    glm::vec3 AverageColor() const {
+        return radiance[0] * Y0;
+    }
+
+    const SkyConstants &Constants() const {
+        return constants;
+    }
+
+    // fills SkyBlock from radiance coefficients as Project returns them, the skybox's or a sky computed at run time
+    // (Reset goes back to the skybox's). It holds the irradiance over pi, the colour a white diffuse surface
+    // reflects, as a polynomial of the normal:
+    //   c0 + c1 y + c2 z + c3 x + c4 xy + c5 yz + c6 (3z^2 - 1) + c7 xz + c8 (x^2 - y^2)
+    // The cosine lobe scales band l by A_l / pi = 1, 2/3, 1/4.
+    void Upload(const glm::vec3 (&coefficients)[SH_COEFFICIENTS]) {
+        const float band[SH_COEFFICIENTS] = {Y0, Y1 * 2.0f / 3.0f, Y1 * 2.0f / 3.0f, Y1 * 2.0f / 3.0f,
+                                             Y2 * 0.25f, Y2 * 0.25f, Y20 * 0.25f, Y2 * 0.25f, Y22 * 0.25f};
+        float luminance = glm::dot(coefficients[0] * band[0], glm::vec3(0.2126f, 0.7152f, 0.0722f));
+        float scale = luminance > 0.0f ? 1.0f / luminance : 0.0f;
+        for (int i = 0; i < SH_COEFFICIENTS; i++)
+            constants.coefficients[i] = glm::vec4(coefficients[i] * band[i] * scale, 0.0f);
+
+        if (buffer.Get() == 0) {
+            buffer = GpuRef(GPU_BUFFER);
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(SkyConstants), &constants, GL_DYNAMIC_DRAW);
+            buffer.SetBytes(sizeof(SkyConstants));
+        } else {
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(SkyConstants), &constants);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void Reset() {
+        Upload(radiance);
+    }
+
+private:
+    static constexpr double PI = 3.14159265358979323846;
+    // basis function normalization constants
+    static constexpr float Y0 = 0.282095f, Y1 = 0.488603f, Y2 = 1.092548f, Y20 = 0.315392f, Y22 = 0.546274f;
+    static const uint32_t CACHE_MAGIC = 0x53484952; // "RIHS"
+    static const uint32_t FORMAT_VERSION = 2;
+
+    // one row of texels: colour times weight times each basis function, and the weights
+    struct RowSums {
+        float color[SH_COEFFICIENTS * 3];
+        float weight;
+    };
+
+    GLuint texture = 0;
+    glm::vec3 radiance[SH_COEFFICIENTS];
+    SkyConstants constants = {};
+    GpuRef buffer;
+    bool fromCache = false;
+    float milliseconds = 0.0f;
+    int faceSize = 0;
+    unsigned threadCount = 0;
+
+    static void projectRow(const std::vector<float> &faces, int size, int face, int y, RowSums &sums) {
+        glm::vec3 faceS, faceT, faceAxis;
+        CubemapFaceBasis(face, faceS, faceT, faceAxis);
+        // world space directions of the texels, as the skybox shows them
+        faceS = SkyboxLookup(faceS);
+        faceT = SkyboxLookup(faceT);
+        faceAxis = SkyboxLookup(faceAxis);
+        float t = 2.0f * (y + 0.5f) / size - 1.0f;
+        glm::vec3 rowOrigin = faceT * t + faceAxis;
+        const float *texels = &faces[((size_t) face * size + y) * size * 3];
+        std::fill(std::begin(sums.color), std::end(sums.color), 0.0f);
+        sums.weight = 0.0f;
+
+        int x = 0;
+#ifdef RG_SH_SSE
+        __m128 color[SH_COEFFICIENTS * 3];
+        for (__m128 &sum: color)
+            sum = _mm_setzero_ps();
+        __m128 weightSum = _mm_setzero_ps();
+        __m128 one = _mm_set1_ps(1.0f);
+        for (; x + 4 <= size; x += 4) {
+            __m128 s = _mm_sub_ps(_mm_mul_ps(_mm_set_ps(x + 3.5f, x + 2.5f, x + 1.5f, x + 0.5f),
+                                             _mm_set1_ps(2.0f / size)), one);
+            __m128 dx = _mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(faceS.x)), _mm_set1_ps(rowOrigin.x));
+            __m128 dy = _mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(faceS.y)), _mm_set1_ps(rowOrigin.y));
+            __m128 dz = _mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(faceS.z)), _mm_set1_ps(rowOrigin.z));
+            // |d|^2 = 1 + s^2 + t^2; the texel's solid angle is proportional to 1 / |d|^3
+            __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+            __m128 weight = _mm_mul_ps(inverseLength, _mm_mul_ps(inverseLength, inverseLength));
+            dx = _mm_mul_ps(dx, inverseLength);
+            dy = _mm_mul_ps(dy, inverseLength);
+            dz = _mm_mul_ps(dz, inverseLength);
+
+            __m128 basis[SH_COEFFICIENTS];
+            basis[0] = _mm_set1_ps(Y0);
+            basis[1] = _mm_mul_ps(_mm_set1_ps(Y1), dy);
+            basis[2] = _mm_mul_ps(_mm_set1_ps(Y1), dz);
+            basis[3] = _mm_mul_ps(_mm_set1_ps(Y1), dx);
+            basis[4] = _mm_mul_ps(_mm_set1_ps(Y2), _mm_mul_ps(dx, dy));
+            basis[5] = _mm_mul_ps(_mm_set1_ps(Y2), _mm_mul_ps(dy, dz));
+            basis[6] = _mm_mul_ps(_mm_set1_ps(Y20), _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_mul_ps(dz, dz)), one));
+            basis[7] = _mm_mul_ps(_mm_set1_ps(Y2), _mm_mul_ps(dx, dz));
+            basis[8] = _mm_mul_ps(_mm_set1_ps(Y22), _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+
+            const float *texel = texels + x * 3;
+            __m128 r = _mm_mul_ps(weight, _mm_set_ps(texel[9], texel[6], texel[3], texel[0]));
+            __m128 g = _mm_mul_ps(weight, _mm_set_ps(texel[10], texel[7], texel[4], texel[1]));
+            __m128 b = _mm_mul_ps(weight, _mm_set_ps(texel[11], texel[8], texel[5], texel[2]));
+            for (int i = 0; i < SH_COEFFICIENTS; i++) {
+                color[3 * i] = _mm_add_ps(color[3 * i], _mm_mul_ps(r, basis[i]));
+                color[3 * i + 1] = _mm_add_ps(color[3 * i + 1], _mm_mul_ps(g, basis[i]));
+                color[3 * i + 2] = _mm_add_ps(color[3 * i + 2], _mm_mul_ps(b, basis[i]));
+            }
+            weightSum = _mm_add_ps(weightSum, weight);
+        }
+        float lanes[4];
+        for (int i = 0; i < SH_COEFFICIENTS * 3; i++) {
+            _mm_storeu_ps(lanes, color[i]);
+            sums.color[i] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        }
+        _mm_storeu_ps(lanes, weightSum);
+        sums.weight = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+        for (; x < size; x++) {
+            float s = 2.0f * (x + 0.5f) / size - 1.0f;
+            glm::vec3 direction = faceS * s + rowOrigin;
+            float inverseLength = 1.0f / glm::length(direction);
+            float weight = inverseLength * inverseLength * inverseLength;
+            direction *= inverseLength;
+
+            float basis[SH_COEFFICIENTS] = {
+                    Y0,
+                    Y1 * direction.y, Y1 * direction.z, Y1 * direction.x,
+                    Y2 * direction.x * direction.y, Y2 * direction.y * direction.z,
+                    Y20 * (3.0f * direction.z * direction.z - 1.0f), Y2 * direction.x * direction.z,
+                    Y22 * (direction.x * direction.x - direction.y * direction.y)
+            };
+            const float *texel = texels + x * 3;
+            for (int i = 0; i < SH_COEFFICIENTS; i++) {
+                for (int channel = 0; channel < 3; channel++)
+                    sums.color[3 * i + channel] += texel[channel] * weight * basis[i];
+            }
+            sums.weight += weight;
+        }
+    }
+
+    // FNV-1a
+    static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+
+    static uint64_t inputKey(const std::vector<std::string> &faceFiles) {
+        uint64_t key = 14695981039346656037ull;
+        key = hashBytes(key, &FORMAT_VERSION, sizeof(FORMAT_VERSION));
+        for (const std::string &file: faceFiles) {
+            std::ifstream in(file, std::ios::binary);
+            std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            key = hashBytes(key, bytes.data(), bytes.size());
+        }
+        return key;
+    }
+
+    bool loadCache(const std::string &file, uint64_t key) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in)
+            return false;
+        uint32_t magic = 0;
+        uint64_t storedKey = 0;
+        in.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+        in.read(reinterpret_cast<char *>(&storedKey), sizeof(storedKey));
+        if (!in || magic != CACHE_MAGIC || storedKey != key)
+            return false;
+        in.read(reinterpret_cast<char *>(radiance), sizeof(radiance));
+        return (bool) in;
+    }
+
+    void saveCache(const std::string &file, uint64_t key) const {
+        std::ofstream out(file, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(&CACHE_MAGIC), sizeof(CACHE_MAGIC));
+        out.write(reinterpret_cast<const char *>(&key), sizeof(key));
+        out.write(reinterpret_cast<const char *>(radiance), sizeof(radiance));
+        if (!out)
+            std::cout << "Could not write the sky irradiance cache " << file << std::endl;
+    }
+};
+
+constexpr double SkyIrradiance::PI;
+constexpr float SkyIrradiance::Y0;
+constexpr float SkyIrradiance::Y1;
+constexpr float SkyIrradiance::Y2;
+constexpr float SkyIrradiance::Y20;
+constexpr float SkyIrradiance::Y22;
+const uint32_t SkyIrradiance::CACHE_MAGIC;
+const uint32_t SkyIrradiance::FORMAT_VERSION;
+
+};
+#endif //PROJECT_BASE_SKYIRRADIANCE_H
@@ -0,0 +1,88 @@
+#ifndef PROJECT_BASE_SMOKE_H
+#define PROJECT_BASE_SMOKE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <rg/Profiler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace rg {
+
+// A column of camera-facing smoke puffs rising from a point, drawn as instanced quads with smoke.vs/smoke.fs into the
+// weighted blended OIT targets. Puffs are animated on the CPU every frame and uploaded unsorted.
+class SmokeColumn {
+public:
+    struct Puff {
+        glm::vec4 centerRadius;
+        glm::vec4 color;
+    };
+
+    void Init(const glm::vec3 &columnOrigin, unsigned int count, float columnHeight) {
+        origin = columnOrigin;
+        height = columnHeight;
+        puffs.resize(count);
+
+        const float corners[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &cornerVBO);
+        glGenBuffers(1, &puffVBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, cornerVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, puffVBO);
+        glBufferData(GL_ARRAY_BUFFER, puffs.size() * sizeof(Puff), nullptr, GL_STREAM_DRAW);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Puff), (void*)offsetof(Puff, centerRadius));
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Puff), (void*)offsetof(Puff, color));
+        glVertexAttribDivisor(2, 1);
+        glBindVertexArray(0);
+    }
+
+    // every puff loops from the origin to the top of the column, growing and fading on the way
+    void Update(float time) {
+        for (unsigned int i = 0; i < puffs.size(); i++) {
+            float phase = i / (float) puffs.size();
+            float t = std::fmod(time * 0.08f + phase, 1.0f);
+            float angle = i * 2.399f; // golden angle, spreads puffs around the column
+            float spread = 2.0f + 10.0f * t;
+            glm::vec3 center = origin + glm::vec3(std::cos(angle) * spread + 15.0f * t * t, height * t,
+                                                  std::sin(angle) * spread);
+            float fadeIn = std::min(t * 10.0f, 1.0f);
+            float shade = 0.25f + 0.35f * t;
+            puffs[i].centerRadius = glm::vec4(center, 3.0f + 9.0f * t);
+            puffs[i].color = glm::vec4(glm::vec3(shade), 0.45f * fadeIn * (1.0f - t));
+        }
+    }
+
+    // the shader must be in use and the OIT targets bound
+    void Draw() {
+        glBindBuffer(GL_ARRAY_BUFFER, puffVBO);
+        glBufferData(GL_ARRAY_BUFFER, puffs.size() * sizeof(Puff), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, puffs.size() * sizeof(Puff), puffs.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glBindVertexArray(VAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, puffs.size());
+        frameStats.drawCalls++;
+        glBindVertexArray(0);
+    }
+
+private:
+    glm::vec3 origin = glm::vec3(0.0f);
+    float height = 0.0f;
+    std::vector<Puff> puffs;
+    unsigned int VAO = 0, cornerVBO = 0, puffVBO = 0;
+};
+
+};
+#endif //PROJECT_BASE_SMOKE_H
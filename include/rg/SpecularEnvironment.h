@@ -0,0 +1,447 @@
+#ifndef PROJECT_BASE_SPECULARENVIRONMENT_H
+#define PROJECT_BASE_SPECULARENVIRONMENT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/Cubemap.h>
+#include <rg/GpuResources.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace rg {
+
+// Image-based specular light from the skybox with the split-sum approximation (Karis, "Real Shading in Unreal Engine
+// 4"), baked on the CPU at load time instead of by shaders at every start:
+//   - a mip chain of the sky in world space (see SkyboxLookup) prefiltered with the GGX lobe, roughness growing
+//     linearly with the mip level; every texel averages importance-sampled directions around it, each read from a
+//     mip of the sky that matches its sample's solid angle so few samples stay smooth
+//   - a LUT of the scale and bias applied to the specular colour, indexed by n.v and roughness
+// Both use a fixed Hammersley sequence and every texel is computed on its own, spread over every hardware thread, so
+// the result is bit-for-bit the same for any thread count. It is cached in a file keyed by a hash of the face files
+// and the settings; the runtime then only uploads it. Verify bakes again and compares against what was uploaded.
+class SpecularEnvironment {
+public:
+    struct Settings {
+        // face size of the sharpest level, each further level is half as large
+        int size = 128;
+        int levels = 6;
+        int samples = 256;
+        int lutSize = 64;
+        int lutSamples = 512;
+        // worker threads, 0 for one per hardware thread
+        unsigned threads = 0;
+    };
+
+    // texture units after the shadow map
+    static const int ENVIRONMENT_UNIT = 12;
+    static const int BRDF_LUT_UNIT = 13;
+
+    // bakes from cubemap or loads the bake from cacheFile when faceFiles and settings did not change, then uploads it
+    void Init(GLuint cubemap, const std::vector<std::string> &faceFiles, const Settings &bakeSettings,
+              const std::string &cacheFile) {
+        auto start = std::chrono::steady_clock::now();
+        texture = cubemap;
+        settings = bakeSettings;
+        threadCount = settings.threads ? settings.threads : std::max(1u, std::thread::hardware_concurrency());
+        uint64_t key = inputKey(faceFiles);
+        fromCache = loadCache(cacheFile, key);
+        if (!fromCache) {
+            bake(threadCount, levels, lut);
+            saveCache(cacheFile, key);
+        }
+        upload();
+        milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Specular environment " << (fromCache ? "loaded from " + cacheFile : "baked") << " in "
+                  << milliseconds << " ms" << std::endl;
+    }
+
+    static void SetSamplers(Shader &shader) {
+        shader.use();
+        shader.setInt("environmentMap", ENVIRONMENT_UNIT);
+        shader.setInt("brdfLut", BRDF_LUT_UNIT);
+    }
+
+    void Bind() const {
+        glActiveTexture(GL_TEXTURE0 + ENVIRONMENT_UNIT);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, environmentMap);
+        glActiveTexture(GL_TEXTURE0 + BRDF_LUT_UNIT);
+        glBindTexture(GL_TEXTURE_2D, brdfLut);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // bakes again with a different thread count and compares with the uploaded data; the result is a line for ImGui
+    std::string Verify() const {
+        auto start = std::chrono::steady_clock::now();
+        unsigned threads = threadCount > 1 ? 1 : 4;
+        std::vector<std::vector<float>> checkLevels;
+        std::vector<float> checkLut;
+        bake(threads, checkLevels, checkLut);
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        size_t different = 0, total = checkLut.size();
+        float maxDifference = 0.0f;
+        auto compare = [&](const std::vector<float> &a, const std::vector<float> &b) {
+            for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+                if (a[i] != b[i]) {
+                    different++;
+                    maxDifference = std::max(maxDifference, std::abs(a[i] - b[i]));
+                }
+            }
+            different += std::max(a.size(), b.size()) - std::min(a.size(), b.size());
+        };
+        for (size_t level = 0; level < checkLevels.size() && level < levels.size(); level++) {
+            compare(checkLevels[level], levels[level]);
+            total += checkLevels[level].size();
+        }
+        compare(checkLut, lut);
+        if (different == 0 && checkLevels.size() == levels.size())
+            return "passed: " + std::to_string(total) + " values identical, baked on " + std::to_string(threads) +
+                   " threads in " + std::to_string((int) ms) + " ms";
+        return "FAILED: " + std::to_string(different) + " of " + std::to_string(total) + " values differ, up to " +
+               std::to_string(maxDifference);
+    }
+
+    // prefilters other sky faces (laid out as in Cubemap.h, oriented like the skybox's) into levels like the
+    // uploaded ones, on the calling thread and threads - 1 more. Reads nothing but the settings, so it can run while
+    // the GL thread renders; UploadFace then puts the result in the environment map a face at a time.
+    void Prefilter(std::vector<float> faces, int size, unsigned threads,
+                   std::vector<std::vector<float>> &outLevels) const {
+        CpuCubemap sky;
+        sky.Build(std::move(faces), size);
+        prefilter(sky, threads, outLevels, nullptr);
+    }
+
+    // every level of one face of faceLevels (see Prefilter)
+    void UploadFace(const std::vector<std::vector<float>> &faceLevels, int face) const {
+        glBindTexture(GL_TEXTURE_CUBE_MAP, environmentMap);
+        for (int level = 0; level < settings.levels; level++) {
+            int size = std::max(1, settings.size >> level);
+            glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0, size, size, GL_RGB, GL_FLOAT,
+                            &faceLevels[level][(size_t) face * size * size * 3]);
+        }
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    }
+
+    // back to the skybox's environment after Prefilter and UploadFace
+    void Reset() const {
+        for (int face = 0; face < 6; face++)
+            UploadFace(levels, face);
+    }
+
+    bool FromCache() const {
+        return fromCache;
+    }
+
+    // time of Init, reading the sky and uploading included
+    float Milliseconds() const {
+        return milliseconds;
+    }
+
+    unsigned Threads() const {
+        return threadCount;
+    }
+
+    int Levels() const {
+        return settings.levels;
+    }
+
+    int Size() const {
+        return settings.size;
+    }
+
+private:
+    static constexpr float PI = 3.14159265f;
+    static const uint32_t CACHE_MAGIC = 0x56454752; // "RGEV"
+    static const uint32_t FORMAT_VERSION = 2;
+    static const int ROWS_PER_TASK = 4;
+
+    GLuint texture = 0;
+    Settings settings;
+    // RGB faces of every level, laid out as in Cubemap.h, and the LUT's (scale, bias) rows by roughness
+    std::vector<std::vector<float>> levels;
+    std::vector<float> lut;
+    GpuRef environmentMap;
+    GpuRef brdfLut;
+    bool fromCache = false;
+    float milliseconds = 0.0f;
+    unsigned threadCount = 0;
+
+    void bake(unsigned threads, std::vector<std::vector<float>> &outLevels, std::vector<float> &outLut) const {
+        int skySize = 0;
+        std::vector<float> skyFaces = ReadCubemapFaces(texture, skySize);
+        CpuCubemap sky;
+        sky.Build(std::move(skyFaces), skySize);
+        prefilter(sky, threads, outLevels, &outLut);
+    }
+
+    // the environment levels of sky and, when outLut is set, the BRDF LUT
+    void prefilter(const CpuCubemap &sky, unsigned threads, std::vector<std::vector<float>> &outLevels,
+                   std::vector<float> *outLut) const {
+        outLevels.assign(settings.levels, std::vector<float>());
+        for (int level = 0; level < settings.levels; level++) {
+            int size = std::max(1, settings.size >> level);
+            outLevels[level].assign((size_t) 6 * size * size * 3, 0.0f);
+        }
+        if (outLut)
+            outLut->assign((size_t) settings.lutSize * settings.lutSize * 2, 0.0f);
+
+        // tasks: a few rows of one face of one level, then a few rows of the LUT
+        struct Task {
+            int level, face, row;
+        };
+        std::vector<Task> tasks;
+        for (int level = 0; level < settings.levels; level++) {
+            int size = std::max(1, settings.size >> level);
+            for (int face = 0; face < 6; face++) {
+                for (int row = 0; row < size; row += ROWS_PER_TASK)
+                    tasks.push_back({level, face, row});
+            }
+        }
+        for (int row = 0; outLut && row < settings.lutSize; row += ROWS_PER_TASK)
+            tasks.push_back({-1, 0, row});
+
+        std::atomic<size_t> nextTask(0);
+        auto worker = [&]() {
+            size_t index;
+            while ((index = nextTask.fetch_add(1)) < tasks.size()) {
+                const Task &task = tasks[index];
+                if (task.level < 0)
+                    integrateLutRows(task.row, *outLut);
+                else
+                    prefilterRows(sky, task.level, task.face, task.row, outLevels[task.level]);
+            }
+        };
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < threads; i++)
+            workers.emplace_back(worker);
+        worker();
+        for (std::thread &thread: workers)
+            thread.join();
+    }
+
+    float levelRoughness(int level) const {
+        return settings.levels > 1 ? (float) level / (settings.levels - 1) : 0.0f;
+    }
+
+    void prefilterRows(const CpuCubemap &sky, int level, int face, int firstRow, std::vector<float> &faces) const {
+        int size = std::max(1, settings.size >> level);
+        float roughness = levelRoughness(level);
+        float alpha = roughness * roughness;
+        // solid angle of one texel of the sky's base level
+        float texelAngle = 4.0f * PI / (6.0f * sky.Size() * sky.Size());
+        glm::vec3 faceS, faceT, faceAxis;
+        CubemapFaceBasis(face, faceS, faceT, faceAxis);
+
+        for (int y = firstRow; y < std::min(firstRow + ROWS_PER_TASK, size); y++) {
+            float t = 2.0f * (y + 0.5f) / size - 1.0f;
+            for (int x = 0; x < size; x++) {
+                float s = 2.0f * (x + 0.5f) / size - 1.0f;
+                glm::vec3 normal = glm::normalize(faceS * s + faceT * t + faceAxis);
+                glm::vec3 color;
+                if (level == 0 || alpha == 0.0f) {
+                    // a mirror: the sky at the level whose texels are as large as this one's
+                    color = sky.Sample(SkyboxLookup(normal), std::log2((float) sky.Size() / size));
+                } else {
+                    glm::vec3 tangent, bitangent;
+                    orthonormalBasis(normal, tangent, bitangent);
+                    glm::vec3 sum = glm::vec3(0.0f);
+                    float weight = 0.0f;
+                    for (int i = 0; i < settings.samples; i++) {
+                        // view = normal, so n.h = v.h and the pdf of the reflected direction is D / 4
+                        float cosine;
+                        glm::vec3 half = importanceSampleGgx(i, settings.samples, alpha, normal, tangent, bitangent,
+                                                             cosine);
+                        glm::vec3 light = 2.0f * cosine * half - normal;
+                        float nDotL = glm::dot(normal, light);
+                        if (nDotL <= 0.0f)
+                            continue;
+                        float pdf = ggx(cosine, alpha) * 0.25f;
+                        float sampleAngle = 1.0f / (settings.samples * pdf + 1e-6f);
+                        float lod = 0.5f * std::log2(sampleAngle / texelAngle) + 1.0f;
+                        sum += sky.Sample(SkyboxLookup(light), lod) * nDotL;
+                        weight += nDotL;
+                    }
+                    color = weight > 0.0f ? sum / weight : glm::vec3(0.0f);
+                }
+                float *texel = &faces[(((size_t) face * size + y) * size + x) * 3];
+                texel[0] = color.r;
+                texel[1] = color.g;
+                texel[2] = color.b;
+            }
+        }
+    }
+
+    // scale and bias of F0 in the specular integral of a white environment, Smith-GGX with the IBL k = alpha / 2
+    void integrateLutRows(int firstRow, std::vector<float> &out) const {
+        int size = settings.lutSize;
+        const glm::vec3 normal = glm::vec3(0.0f, 0.0f, 1.0f), tangent = glm::vec3(1.0f, 0.0f, 0.0f),
+                bitangent = glm::vec3(0.0f, 1.0f, 0.0f);
+        for (int y = firstRow; y < std::min(firstRow + ROWS_PER_TASK, size); y++) {
+            float roughness = (y + 0.5f) / size;
+            float alpha = roughness * roughness;
+            float k = alpha * 0.5f;
+            for (int x = 0; x < size; x++) {
+                float nDotV = (x + 0.5f) / size;
+                glm::vec3 view = glm::vec3(std::sqrt(1.0f - nDotV * nDotV), 0.0f, nDotV);
+                float scale = 0.0f, bias = 0.0f;
+                for (int i = 0; i < settings.lutSamples; i++) {
+                    float cosine;
+                    glm::vec3 half = importanceSampleGgx(i, settings.lutSamples, alpha, normal, tangent, bitangent,
+                                                         cosine);
+                    float vDotH = glm::dot(view, half);
+                    glm::vec3 light = 2.0f * vDotH * half - view;
+                    float nDotL = light.z;
+                    if (nDotL <= 0.0f || vDotH <= 0.0f)
+                        continue;
+                    float visibility = nDotL / (nDotL * (1.0f - k) + k) * nDotV / (nDotV * (1.0f - k) + k);
+                    float weighted = visibility * vDotH / (cosine * nDotV);
+                    float fresnel = std::pow(1.0f - vDotH, 5.0f);
+                    scale += (1.0f - fresnel) * weighted;
+                    bias += fresnel * weighted;
+                }
+                out[(y * size + x) * 2] = scale / settings.lutSamples;
+                out[(y * size + x) * 2 + 1] = bias / settings.lutSamples;
+            }
+        }
+    }
+
+    static float ggx(float nDotH, float alpha) {
+        float alpha2 = alpha * alpha;
+        float denominator = nDotH * nDotH * (alpha2 - 1.0f) + 1.0f;
+        return alpha2 / (PI * denominator * denominator);
+    }
+
+    // i-th of count half vectors around normal, distributed like the GGX lobe; cosine is their n.h
+    static glm::vec3 importanceSampleGgx(int i, int count, float alpha, const glm::vec3 &normal,
+                                         const glm::vec3 &tangent, const glm::vec3 &bitangent, float &cosine) {
+        float u = (i + 0.5f) / count, v = radicalInverse(i);
+        float phi = 2.0f * PI * u;
+        cosine = std::sqrt((1.0f - v) / (1.0f + (alpha * alpha - 1.0f) * v));
+        float sine = std::sqrt(std::max(0.0f, 1.0f - cosine * cosine));
+        return tangent * (sine * std::cos(phi)) + bitangent * (sine * std::sin(phi)) + normal * cosine;
+    }
+
+    // tangent frame around a unit normal without a branch on its direction (Duff et al.)
+    static void orthonormalBasis(const glm::vec3 &normal, glm::vec3 &tangent, glm::vec3 &bitangent) {
+        float sign = std::copysign(1.0f, normal.z);
+        float a = -1.0f / (sign + normal.z);
+        float b = normal.x * normal.y * a;
+        tangent = glm::vec3(1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+        bitangent = glm::vec3(b, sign + normal.y * normal.y * a, -normal.y);
+    }
+
+    static float radicalInverse(uint32_t bits) {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return bits * 2.3283064365386963e-10f;
+    }
+
+    void upload() {
+        environmentMap = GpuRef(GPU_TEXTURE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, environmentMap);
+        size_t bytes = 0;
+        for (int level = 0; level < settings.levels; level++) {
+            int size = std::max(1, settings.size >> level);
+            for (int face = 0; face < 6; face++) {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB16F, size, size, 0, GL_RGB,
+                             GL_FLOAT, &levels[level][(size_t) face * size * size * 3]);
+            }
+            bytes += TextureBytes(size, size, 8) * 6;
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, settings.levels - 1);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        environmentMap.SetBytes(bytes);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+        brdfLut = GpuRef(GPU_TEXTURE);
+        glBindTexture(GL_TEXTURE_2D, brdfLut);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, settings.lutSize, settings.lutSize, 0, GL_RG, GL_FLOAT, lut.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        brdfLut.SetBytes(TextureBytes(settings.lutSize, settings.lutSize, 4));
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // FNV-1a
+    static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+
+    // everything the baked values depend on; the thread count is left out, it does not change them
+    uint64_t inputKey(const std::vector<std::string> &faceFiles) const {
+        uint64_t key = 14695981039346656037ull;
+        key = hashBytes(key, &FORMAT_VERSION, sizeof(FORMAT_VERSION));
+        const int values[] = {settings.size, settings.levels, settings.samples, settings.lutSize, settings.lutSamples};
+        key = hashBytes(key, values, sizeof(values));
+        for (const std::string &file: faceFiles) {
+            std::ifstream in(file, std::ios::binary);
+            std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            key = hashBytes(key, bytes.data(), bytes.size());
+        }
+        return key;
+    }
+
+    bool loadCache(const std::string &file, uint64_t key) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in)
+            return false;
+        uint32_t magic = 0;
+        uint64_t storedKey = 0;
+        in.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+        in.read(reinterpret_cast<char *>(&storedKey), sizeof(storedKey));
+        if (!in || magic != CACHE_MAGIC || storedKey != key)
+            return false;
+        levels.assign(settings.levels, std::vector<float>());
+        for (int level = 0; level < settings.levels; level++) {
+            int size = std::max(1, settings.size >> level);
+            levels[level].resize((size_t) 6 * size * size * 3);
+            in.read(reinterpret_cast<char *>(levels[level].data()), levels[level].size() * sizeof(float));
+        }
+        lut.resize((size_t) settings.lutSize * settings.lutSize * 2);
+        in.read(reinterpret_cast<char *>(lut.data()), lut.size() * sizeof(float));
+        return (bool) in;
+    }
+
+    void saveCache(const std::string &file, uint64_t key) const {
+        std::ofstream out(file, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(&CACHE_MAGIC), sizeof(CACHE_MAGIC));
+        out.write(reinterpret_cast<const char *>(&key), sizeof(key));
+        for (const std::vector<float> &level: levels)
+            out.write(reinterpret_cast<const char *>(level.data()), level.size() * sizeof(float));
+        out.write(reinterpret_cast<const char *>(lut.data()), lut.size() * sizeof(float));
+        if (!out)
+            std::cout << "Could not write the specular environment cache " << file << std::endl;
+    }
+};
+
+constexpr float SpecularEnvironment::PI;
+const uint32_t SpecularEnvironment::CACHE_MAGIC;
+const uint32_t SpecularEnvironment::FORMAT_VERSION;
+
+};
+#endif //PROJECT_BASE_SPECULARENVIRONMENT_H
@@ -0,0 +1,187 @@
+#ifndef PROJECT_BASE_SSAO_H
+#define PROJECT_BASE_SSAO_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+#include <rg/GpuResources.h>
+#include <rg/Profiler.h>
+#include <rg/ShaderConstants.h>
+#include <rg/UniformRing.h>
+
+#include <iostream>
+
+namespace rg {
+
+// Screen space ambient occlusion at a half or quarter of the screen resolution. The multisampled scene depth is
+// first resolved into a single-sample depth texture (a depth blit keeps one sample per pixel), so no pass ever reads
+// the multisampled buffer. Then, at the reduced size:
+//   - ssao_depth.fs keeps the nearest linear depth of every block of scale x scale pixels
+//   - ssao.fs gathers a view space hemisphere of samples around the normal rebuilt from that depth
+//   - ssao_blur.fs blurs it horizontally and vertically, with weights that drop across depth edges
+// bloomFinal.fs scales the scene by it, picking among the four nearest low resolution texels the ones whose depth
+// matches the pixel's full resolution depth (see ssao.glsl). Constants come from PostBlock.
+class Ssao {
+public:
+    enum Quality {
+        LOW,
+        MEDIUM,
+        HIGH
+    };
+
+    // texture units while the passes and the composite run, after the composite's own inputs
+    static const int OCCLUSION_UNIT = 3;
+    static const int DEPTH_UNIT = 4;
+    static const int SCENE_DEPTH_UNIT = 5;
+
+    // hemisphere samples per pixel of a quality level
+    static int Samples(int quality) {
+        static const int samples[] = {8, 16, 32};
+        return samples[quality];
+    }
+
+    // depthRenderbuffer is the scene depth, multisampled or not; the resolved copy gets its size and format. Called
+    // again when the scene targets change size or sample count
+    void Init(GLsizei width, GLsizei height, GLuint depthRenderbuffer) {
+        screenWidth = width;
+        screenHeight = height;
+        currentScale = 0;
+        GLint format;
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+        glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_INTERNAL_FORMAT, &format);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        sceneDepth = GpuRef(GPU_TEXTURE);
+        glBindTexture(GL_TEXTURE_2D, sceneDepth);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        sceneDepth.SetBytes(TextureBytes(width, height, 4));
+        setNearest();
+        resolveFBO = GpuRef(GPU_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, resolveFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, sceneDepth, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "SSAO depth resolve framebuffer not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // points the SSAO samplers of the passes and the composite at their units
+    static void SetSamplers(Shader &shader) {
+        shader.use();
+        shader.setInt("ssaoTexture", OCCLUSION_UNIT);
+        shader.setInt("ssaoDepth", DEPTH_UNIT);
+        shader.setInt("sceneDepth", SCENE_DEPTH_UNIT);
+    }
+
+    // resolves the depth of sceneFBO and renders the blurred occlusion at 1 / scale of the screen; the post
+    // constants of the two blur directions are at the given ring offsets, drawQuad() draws a fullscreen quad. Leaves
+    // the framebuffer unbound and the result bound for the composite.
+    template<typename DrawQuad>
+    void Render(GLuint sceneFBO, int scale, Shader &depthShader, Shader &occlusionShader, Shader &blurShader,
+                UniformRing &ring, GLintptr horizontalPost, GLintptr verticalPost, DrawQuad drawQuad) {
+        if (scale != currentScale)
+            createTargets(scale);
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFBO);
+        glBlitFramebuffer(0, 0, screenWidth, screenHeight, 0, 0, screenWidth, screenHeight, GL_DEPTH_BUFFER_BIT,
+                          GL_NEAREST);
+
+        glDisable(GL_BLEND);
+        glViewport(0, 0, width, height);
+        // blur directions alternate between the two occlusion targets and end in the first
+        ring.BindRange(POST_BLOCK, horizontalPost, sizeof(PostConstants));
+        bindTexture(SCENE_DEPTH_UNIT, sceneDepth);
+        glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
+        depthShader.use();
+        drawQuad();
+
+        bindTexture(DEPTH_UNIT, depth);
+        bindTexture(OCCLUSION_UNIT, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, occlusionFBO[0]);
+        occlusionShader.use();
+        drawQuad();
+
+        blurShader.use();
+        bindTexture(OCCLUSION_UNIT, occlusion[0]);
+        glBindFramebuffer(GL_FRAMEBUFFER, occlusionFBO[1]);
+        drawQuad();
+        ring.BindRange(POST_BLOCK, verticalPost, sizeof(PostConstants));
+        bindTexture(OCCLUSION_UNIT, occlusion[1]);
+        glBindFramebuffer(GL_FRAMEBUFFER, occlusionFBO[0]);
+        drawQuad();
+
+        bindTexture(OCCLUSION_UNIT, occlusion[0]);
+        glActiveTexture(GL_TEXTURE0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glEnable(GL_BLEND);
+    }
+
+    // size of the occlusion targets, 0 before the first Render
+    GLsizei Width() const {
+        return width;
+    }
+
+    GLsizei Height() const {
+        return height;
+    }
+
+private:
+    GLsizei screenWidth = 0;
+    GLsizei screenHeight = 0;
+    GLsizei width = 0;
+    GLsizei height = 0;
+    int currentScale = 0;
+    GpuRef sceneDepth;
+    GpuRef resolveFBO;
+    GpuRef depth;
+    GpuRef depthFBO;
+    GpuRef occlusion[2];
+    GpuRef occlusionFBO[2];
+
+    void createTargets(int scale) {
+        currentScale = scale;
+        width = (screenWidth + scale - 1) / scale;
+        height = (screenHeight + scale - 1) / scale;
+        depth = createTarget(GL_R32F, GL_RED, GL_FLOAT, 4, depthFBO);
+        for (int i = 0; i < 2; i++)
+            occlusion[i] = createTarget(GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, occlusionFBO[i]);
+    }
+
+    GpuRef createTarget(GLenum format, GLenum pixelFormat, GLenum type, int bytesPerTexel, GpuRef &fbo) const {
+        GpuRef texture(GPU_TEXTURE);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, pixelFormat, type, nullptr);
+        texture.SetBytes(TextureBytes(width, height, bytesPerTexel));
+        setNearest();
+        fbo = GpuRef(GPU_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "SSAO framebuffer not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    }
+
+    // every pass reads whole texels with texelFetch
+    static void setNearest() {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    static void bindTexture(int unit, GLuint texture) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+};
+
+};
+#endif //PROJECT_BASE_SSAO_H
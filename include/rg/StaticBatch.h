@@ -0,0 +1,251 @@
+#ifndef PROJECT_BASE_STATICBATCH_H
+#define PROJECT_BASE_STATICBATCH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/GLExt.h>
+#include <rg/GpuResources.h>
+#include <rg/Profiler.h>
+
+#include <map>
+#include <vector>
+
+namespace rg {
+
+// std430 layout, mirrors DrawData in model_lighting_mdi.vs
+struct DrawData {
+    glm::mat4 model;
+    glm::mat4 normalMatrix;
+    GLint diffuseLayer;
+    GLint specularLayer;
+    GLint padding[2];
+};
+
+// Merges the meshes of every static model into one vertex/index buffer and submits all of them with a single
+// glMultiDrawElementsIndirect. Per-draw transforms and material layers live in a shader storage buffer indexed by
+// the draw id, and all textures are resampled into one texture array so no state changes between draws.
+// Requires GL 4.3 (rg::glCaps.multiDrawIndirect); the per-mesh Model::Draw path stays the fallback. Building copies
+// every mesh and texture again, so the caller builds it only once the batch is first needed.
+class StaticBatch {
+public:
+    // resolution every texture is resampled to inside the texture array
+    static const GLsizei LAYER_SIZE = 1024;
+
+    void Add(Model &model, const glm::mat4 &transform) {
+        entries.push_back({&model, transform});
+    }
+
+    // uploads everything added so far, with the baked light of meshes that were baked before; the batch is immutable
+    // afterwards
+    void Build() {
+        std::vector<Vertex> vertices;
+        std::vector<glm::vec4> bakedLight;
+        std::vector<unsigned int> indices;
+        std::vector<DrawData> drawData;
+        std::map<unsigned int, GLint> layers;
+        std::vector<unsigned int> layerTextures;
+
+        for (const Entry &entry: entries) {
+            glm::mat4 normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(entry.transform))));
+            for (const Mesh &mesh: entry.model->meshes) {
+                DrawElementsIndirectCommand command;
+                command.count = mesh.indices.size();
+                command.instanceCount = 1;
+                command.firstIndex = indices.size();
+                command.baseVertex = vertices.size();
+                command.baseInstance = commands.size();
+                commands.push_back(command);
+
+                DrawData draw;
+                draw.model = entry.transform;
+                draw.normalMatrix = normalMatrix;
+                draw.diffuseLayer = WHITE_LAYER;
+                draw.specularLayer = BLACK_LAYER;
+                // same convention as Mesh::Draw: the first texture of a type is bound as texture_<type>1
+                for (int i = mesh.textures.size() - 1; i >= 0; i--) {
+                    const Texture &texture = mesh.textures[i];
+                    if (texture.type != "texture_diffuse" && texture.type != "texture_specular")
+                        continue;
+                    if (layers.find(texture.id) == layers.end()) {
+                        layers[texture.id] = FIRST_TEXTURE_LAYER + layerTextures.size();
+                        layerTextures.push_back(texture.id);
+                    }
+                    if (texture.type == "texture_diffuse")
+                        draw.diffuseLayer = layers[texture.id];
+                    else
+                        draw.specularLayer = layers[texture.id];
+                }
+                drawData.push_back(draw);
+
+                vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+                if (mesh.bakedLight.size() == mesh.vertices.size())
+                    bakedLight.insert(bakedLight.end(), mesh.bakedLight.begin(), mesh.bakedLight.end());
+                else
+                    bakedLight.resize(vertices.size(), glm::vec4(0.0f));
+                indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+            }
+        }
+
+        std::vector<GLuint> drawIds(commands.size());
+        for (GLuint i = 0; i < drawIds.size(); i++)
+            drawIds[i] = i;
+
+        VAO = GpuRef(GPU_VERTEX_ARRAY);
+        VBO = GpuRef(GPU_BUFFER);
+        EBO = GpuRef(GPU_BUFFER);
+        bakedLightBuffer = GpuRef(GPU_BUFFER);
+        drawIdBuffer = GpuRef(GPU_BUFFER);
+        indirectBuffer = GpuRef(GPU_BUFFER);
+        drawDataBuffer = GpuRef(GPU_BUFFER);
+        VBO.SetBytes(vertices.size() * sizeof(Vertex));
+        EBO.SetBytes(indices.size() * sizeof(unsigned int));
+        bakedLightBuffer.SetBytes(bakedLight.size() * sizeof(glm::vec4));
+        drawIdBuffer.SetBytes(drawIds.size() * sizeof(GLuint));
+        indirectBuffer.SetBytes(commands.size() * sizeof(DrawElementsIndirectCommand));
+        drawDataBuffer.SetBytes(drawData.size() * sizeof(DrawData));
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+        // same vertex layout as Mesh::setupMesh
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        // baked light, zero for meshes without it like Mesh::SetBakedLight leaves them
+        glBindBuffer(GL_ARRAY_BUFFER, bakedLightBuffer);
+        glBufferData(GL_ARRAY_BUFFER, bakedLight.size() * sizeof(glm::vec4), bakedLight.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(10);
+        glVertexAttribPointer(10, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+
+        // draw id: advanced once per instance, starting at the command's baseInstance
+        glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+        glBufferData(GL_ARRAY_BUFFER, drawIds.size() * sizeof(GLuint), drawIds.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(5, 1);
+        glBindVertexArray(0);
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, drawData.size() * sizeof(DrawData), drawData.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        buildTextureArray(layerTextures);
+        built = true;
+    }
+
+    bool Built() const {
+        return built;
+    }
+
+    // the shader must be in use and expose `materialTextures` on texture unit 0
+    void Draw(Shader &shader) {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, drawDataBuffer);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, commands.size(), 0);
+        frameStats.drawCalls++;
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+    unsigned int DrawCount() const {
+        return commands.size();
+    }
+
+private:
+    // layers 0 and 1 stand in for meshes without a diffuse or specular map
+    static const GLint WHITE_LAYER = 0;
+    static const GLint BLACK_LAYER = 1;
+    static const GLint FIRST_TEXTURE_LAYER = 2;
+
+    struct Entry {
+        Model *model;
+        glm::mat4 transform;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<DrawElementsIndirectCommand> commands;
+    GpuRef VAO;
+    GpuRef VBO, EBO, bakedLightBuffer, drawIdBuffer, indirectBuffer, drawDataBuffer;
+    GpuRef textureArray;
+    bool built = false;
+
+    // copies every texture into a layer of one RGBA8 array with framebuffer blits, which also rescales them
+    void buildTextureArray(const std::vector<unsigned int> &textures) {
+        GLsizei layerCount = FIRST_TEXTURE_LAYER + textures.size();
+        textureArray = GpuRef(GPU_TEXTURE);
+        textureArray.SetBytes(TextureBytes(LAYER_SIZE, LAYER_SIZE, 4, 1, true) * layerCount);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, LAYER_SIZE, LAYER_SIZE, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        unsigned int framebuffers[2];
+        glGenFramebuffers(2, framebuffers);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+
+        const GLfloat white[] = {1.0f, 1.0f, 1.0f, 1.0f};
+        const GLfloat black[] = {0.0f, 0.0f, 0.0f, 1.0f};
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureArray, 0, WHITE_LAYER);
+        glClearBufferfv(GL_COLOR, 0, white);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureArray, 0, BLACK_LAYER);
+        glClearBufferfv(GL_COLOR, 0, black);
+
+        for (unsigned int i = 0; i < textures.size(); i++) {
+            GLint level = 0, width, height;
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+            // a linear blit only filters 2x2 texels, so larger textures are read from the smallest mip that is still
+            // at least the layer size (a missing level reads as 0 x 0 and stops the search)
+            while (true) {
+                GLint nextWidth, nextHeight;
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level + 1, GL_TEXTURE_WIDTH, &nextWidth);
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level + 1, GL_TEXTURE_HEIGHT, &nextHeight);
+                if (nextWidth < LAYER_SIZE || nextHeight < LAYER_SIZE)
+                    break;
+                level++;
+                width = nextWidth;
+                height = nextHeight;
+            }
+
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], level);
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureArray, 0, FIRST_TEXTURE_LAYER + i);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, LAYER_SIZE, LAYER_SIZE, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(2, framebuffers);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+};
+
+};
+#endif //PROJECT_BASE_STATICBATCH_H
@@ -0,0 +1,360 @@
+#ifndef PROJECT_BASE_TRIANGLEBVH_H
+#define PROJECT_BASE_TRIANGLEBVH_H
+
+#include <glm/glm.hpp>
+
+#include <rg/Bounds.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RG_BVH_SSE 1
+#endif
+
+namespace rg {
+
+// closest intersection found by TriangleBvh::Intersect; u and v are the barycentric weights of the second and third
+// vertex of the triangle
+struct RayHit {
+    float t;
+    uint32_t triangle;
+    float u;
+    float v;
+};
+
+// Bounding volume hierarchy over a triangle soup for CPU ray queries (the light baker). Built with a binned surface
+// area heuristic down to leaves of at most four triangles, which are stored as one packet in structure-of-arrays form
+// and tested against a ray all at once with SSE. Read-only after Build, so any number of threads can trace it.
+class TriangleBvh {
+public:
+    static const int LEAF_SIZE = 4;
+    static const int BINS = 16;
+    // below this depth ranges are halved at the median instead, which bounds the traversal stack
+    static const int MAX_SAH_DEPTH = 32;
+
+    // vertices holds three corners per triangle; triangle indices in hits refer to this order
+    void Build(const std::vector<glm::vec3> &vertices) {
+        nodes.clear();
+        packets.clear();
+        size_t triangleCount = vertices.size() / 3;
+        if (triangleCount == 0)
+            return;
+
+        std::vector<BuildTriangle> triangles(triangleCount);
+        for (size_t i = 0; i < triangleCount; i++) {
+            BuildTriangle &triangle = triangles[i];
+            for (int corner = 0; corner < 3; corner++)
+                triangle.bounds.Extend(vertices[3 * i + corner]);
+            triangle.centroid = triangle.bounds.Center();
+            triangle.index = i;
+        }
+        nodes.reserve(2 * triangleCount / LEAF_SIZE + 1);
+        packets.reserve(triangleCount / 2 + 1);
+        nodes.push_back(Node());
+        buildNode(0, triangles, 0, triangleCount, 0, vertices);
+    }
+
+    // closest triangle along the ray in (tMin, tMax)
+    bool Intersect(const glm::vec3 &origin, const glm::vec3 &direction, float tMin, float tMax, RayHit &hit) const {
+        hit.t = tMax;
+        return traverse<false>(origin, direction, tMin, hit);
+    }
+
+    // whether anything lies along the ray in (tMin, tMax), stops at the first hit
+    bool Occluded(const glm::vec3 &origin, const glm::vec3 &direction, float tMin, float tMax) const {
+        RayHit hit;
+        hit.t = tMax;
+        return traverse<true>(origin, direction, tMin, hit);
+    }
+
+    size_t NodeCount() const {
+        return nodes.size();
+    }
+
+private:
+    struct Node {
+        glm::vec3 minimum;
+        // leaf: index of its packet; interior node: index of the left child, the right one follows it
+        uint32_t first;
+        glm::vec3 maximum;
+        // triangles in the leaf, 0 for interior nodes
+        uint32_t count;
+    };
+
+    // up to four triangles as first corner and two edges per lane; unused lanes have zero edges and never hit
+    struct alignas(16) TrianglePacket {
+        float v0[3][4];
+        float edge1[3][4];
+        float edge2[3][4];
+        uint32_t triangle[4];
+    };
+
+    struct BuildTriangle {
+        Aabb bounds;
+        glm::vec3 centroid;
+        uint32_t index;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<TrianglePacket> packets;
+
+    static float area(const Aabb &box) {
+        if (box.Empty())
+            return 0.0f;
+        glm::vec3 size = box.maximum - box.minimum;
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+
+    // empty bins must not stretch the box to their 1e30 corners
+    static void grow(Aabb &box, const Aabb &other) {
+        if (!other.Empty()) {
+            box.Extend(other.minimum);
+            box.Extend(other.maximum);
+        }
+    }
+
+    void buildNode(uint32_t nodeIndex, std::vector<BuildTriangle> &triangles, size_t begin, size_t end, int depth,
+                   const std::vector<glm::vec3> &vertices) {
+        Aabb bounds, centroidBounds;
+        for (size_t i = begin; i < end; i++) {
+            bounds.Extend(triangles[i].bounds.minimum);
+            bounds.Extend(triangles[i].bounds.maximum);
+            centroidBounds.Extend(triangles[i].centroid);
+        }
+        nodes[nodeIndex].minimum = bounds.minimum;
+        nodes[nodeIndex].maximum = bounds.maximum;
+
+        size_t count = end - begin;
+        if (count <= (size_t) LEAF_SIZE) {
+            makeLeaf(nodeIndex, triangles, begin, end, vertices);
+            return;
+        }
+
+        // bin the centroids along the widest axis and split at the bin boundary with the lowest SAH cost
+        glm::vec3 extent = centroidBounds.maximum - centroidBounds.minimum;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        // when every centroid is in one spot any split works, halving the range keeps the leaves small
+        size_t middle = begin + count / 2;
+        if (depth >= MAX_SAH_DEPTH) {
+            std::nth_element(triangles.begin() + begin, triangles.begin() + middle, triangles.begin() + end,
+                             [&](const BuildTriangle &a, const BuildTriangle &b) {
+                                 return a.centroid[axis] < b.centroid[axis];
+                             });
+        } else if (extent[axis] > 0.0f) {
+            float scale = BINS / extent[axis];
+            float origin = centroidBounds.minimum[axis];
+            auto binOf = [&](const BuildTriangle &triangle) {
+                return std::min(BINS - 1, (int) ((triangle.centroid[axis] - origin) * scale));
+            };
+            Aabb binBounds[BINS];
+            size_t binCounts[BINS] = {};
+            for (size_t i = begin; i < end; i++) {
+                int bin = binOf(triangles[i]);
+                binBounds[bin].Extend(triangles[i].bounds.minimum);
+                binBounds[bin].Extend(triangles[i].bounds.maximum);
+                binCounts[bin]++;
+            }
+            // areas and counts of everything right of each boundary, then sweep from the left
+            float rightArea[BINS];
+            size_t rightCount[BINS];
+            Aabb right;
+            size_t rightTriangles = 0;
+            for (int bin = BINS - 1; bin > 0; bin--) {
+                grow(right, binBounds[bin]);
+                rightTriangles += binCounts[bin];
+                rightArea[bin] = area(right);
+                rightCount[bin] = rightTriangles;
+            }
+            Aabb left;
+            size_t leftTriangles = 0;
+            float bestCost = 1e30f;
+            int bestSplit = -1;
+            for (int bin = 1; bin < BINS; bin++) {
+                grow(left, binBounds[bin - 1]);
+                leftTriangles += binCounts[bin - 1];
+                if (leftTriangles == 0 || rightCount[bin] == 0)
+                    continue;
+                float cost = area(left) * leftTriangles + rightArea[bin] * rightCount[bin];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestSplit = bin;
+                }
+            }
+            if (bestSplit > 0) {
+                middle = std::partition(triangles.begin() + begin, triangles.begin() + end,
+                                        [&](const BuildTriangle &triangle) { return binOf(triangle) < bestSplit; }) -
+                         triangles.begin();
+            }
+        }
+
+        uint32_t leftChild = nodes.size();
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+        nodes[nodeIndex].first = leftChild;
+        nodes[nodeIndex].count = 0;
+        buildNode(leftChild, triangles, begin, middle, depth + 1, vertices);
+        buildNode(leftChild + 1, triangles, middle, end, depth + 1, vertices);
+    }
+
+    void makeLeaf(uint32_t nodeIndex, const std::vector<BuildTriangle> &triangles, size_t begin, size_t end,
+                  const std::vector<glm::vec3> &vertices) {
+        TrianglePacket packet = {};
+        for (size_t i = begin; i < end; i++) {
+            int lane = i - begin;
+            uint32_t triangle = triangles[i].index;
+            glm::vec3 v0 = vertices[3 * triangle];
+            glm::vec3 edge1 = vertices[3 * triangle + 1] - v0;
+            glm::vec3 edge2 = vertices[3 * triangle + 2] - v0;
+            for (int axis = 0; axis < 3; axis++) {
+                packet.v0[axis][lane] = v0[axis];
+                packet.edge1[axis][lane] = edge1[axis];
+                packet.edge2[axis][lane] = edge2[axis];
+            }
+            packet.triangle[lane] = triangle;
+        }
+        nodes[nodeIndex].first = packets.size();
+        nodes[nodeIndex].count = end - begin;
+        packets.push_back(packet);
+    }
+
+    // slab test; the entry distance of the ray into the box, or a negative value when it misses
+    static float enterBox(const Node &node, const glm::vec3 &origin, const glm::vec3 &inverseDirection, float tMin,
+                          float tMax) {
+        glm::vec3 t0 = (node.minimum - origin) * inverseDirection;
+        glm::vec3 t1 = (node.maximum - origin) * inverseDirection;
+        glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+        float enter = std::max(std::max(near.x, near.y), std::max(near.z, tMin));
+        float exit = std::min(std::min(far.x, far.y), std::min(far.z, tMax));
+        return enter <= exit ? enter : -1.0f;
+    }
+
+    // Moller-Trumbore against every lane of the packet; writes the nearest lane hit in (tMin, hit.t) into hit
+    static bool intersectPacket(const TrianglePacket &packet, const glm::vec3 &origin, const glm::vec3 &direction,
+                                float tMin, RayHit &hit) {
+        float t[4], u[4], v[4];
+        int mask = 0;
+#ifdef RG_BVH_SSE
+        __m128 dx = _mm_set1_ps(direction.x), dy = _mm_set1_ps(direction.y), dz = _mm_set1_ps(direction.z);
+        __m128 e1x = _mm_load_ps(packet.edge1[0]), e1y = _mm_load_ps(packet.edge1[1]), e1z = _mm_load_ps(packet.edge1[2]);
+        __m128 e2x = _mm_load_ps(packet.edge2[0]), e2y = _mm_load_ps(packet.edge2[1]), e2z = _mm_load_ps(packet.edge2[2]);
+
+        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        __m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        __m128 sx = _mm_sub_ps(_mm_set1_ps(origin.x), _mm_load_ps(packet.v0[0]));
+        __m128 sy = _mm_sub_ps(_mm_set1_ps(origin.y), _mm_load_ps(packet.v0[1]));
+        __m128 sz = _mm_sub_ps(_mm_set1_ps(origin.z), _mm_load_ps(packet.v0[2]));
+        __m128 lu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)),
+                               inverseDet);
+
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+        __m128 lv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)),
+                               inverseDet);
+        __m128 lt = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)),
+                               inverseDet);
+
+        // comparisons with NaN (zero determinant of the empty lanes) are false
+        __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+        __m128 valid = _mm_cmpgt_ps(absDet, _mm_set1_ps(1e-12f));
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(lu, _mm_setzero_ps()));
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(lv, _mm_setzero_ps()));
+        valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(lu, lv), _mm_set1_ps(1.0f)));
+        valid = _mm_and_ps(valid, _mm_cmpgt_ps(lt, _mm_set1_ps(tMin)));
+        valid = _mm_and_ps(valid, _mm_cmplt_ps(lt, _mm_set1_ps(hit.t)));
+        mask = _mm_movemask_ps(valid);
+        if (mask == 0)
+            return false;
+        _mm_storeu_ps(t, lt);
+        _mm_storeu_ps(u, lu);
+        _mm_storeu_ps(v, lv);
+#else
+        for (int lane = 0; lane < 4; lane++) {
+            glm::vec3 edge1(packet.edge1[0][lane], packet.edge1[1][lane], packet.edge1[2][lane]);
+            glm::vec3 edge2(packet.edge2[0][lane], packet.edge2[1][lane], packet.edge2[2][lane]);
+            glm::vec3 p = glm::cross(direction, edge2);
+            float det = glm::dot(edge1, p);
+            if (std::abs(det) <= 1e-12f)
+                continue;
+            float inverseDet = 1.0f / det;
+            glm::vec3 s = origin - glm::vec3(packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane]);
+            glm::vec3 q = glm::cross(s, edge1);
+            u[lane] = glm::dot(s, p) * inverseDet;
+            v[lane] = glm::dot(direction, q) * inverseDet;
+            t[lane] = glm::dot(edge2, q) * inverseDet;
+            if (u[lane] >= 0.0f && v[lane] >= 0.0f && u[lane] + v[lane] <= 1.0f && t[lane] > tMin && t[lane] < hit.t)
+                mask |= 1 << lane;
+        }
+        if (mask == 0)
+            return false;
+#endif
+        for (int lane = 0; lane < 4; lane++) {
+            if ((mask & (1 << lane)) && t[lane] < hit.t) {
+                hit.t = t[lane];
+                hit.u = u[lane];
+                hit.v = v[lane];
+                hit.triangle = packet.triangle[lane];
+            }
+        }
+        return true;
+    }
+
+    // front to back: the nearer child is visited first and the farther one skipped once a closer hit is known
+    template<bool anyHit>
+    bool traverse(const glm::vec3 &origin, const glm::vec3 &direction, float tMin, RayHit &hit) const {
+        if (nodes.empty())
+            return false;
+        glm::vec3 inverseDirection = 1.0f / direction;
+        if (enterBox(nodes[0], origin, inverseDirection, tMin, hit.t) < 0.0f)
+            return false;
+
+        uint32_t stack[64];
+        int stackSize = 0;
+        uint32_t current = 0;
+        bool found = false;
+        while (true) {
+            const Node &node = nodes[current];
+            if (node.count > 0) {
+                if (intersectPacket(packets[node.first], origin, direction, tMin, hit)) {
+                    found = true;
+                    if (anyHit)
+                        return true;
+                }
+            } else {
+                float enterLeft = enterBox(nodes[node.first], origin, inverseDirection, tMin, hit.t);
+                float enterRight = enterBox(nodes[node.first + 1], origin, inverseDirection, tMin, hit.t);
+                bool left = enterLeft >= 0.0f, right = enterRight >= 0.0f;
+                if (left && right) {
+                    bool leftFirst = enterLeft <= enterRight;
+                    stack[stackSize++] = leftFirst ? node.first + 1 : node.first;
+                    current = leftFirst ? node.first : node.first + 1;
+                    continue;
+                }
+                if (left || right) {
+                    current = left ? node.first : node.first + 1;
+                    continue;
+                }
+            }
+
+            // pop the next subtree that can still hold something closer than the current hit
+            bool next = false;
+            while (stackSize > 0 && !next) {
+                current = stack[--stackSize];
+                next = enterBox(nodes[current], origin, inverseDirection, tMin, hit.t) >= 0.0f;
+            }
+            if (!next)
+                return found;
+        }
+    }
+};
+
+};
+#endif //PROJECT_BASE_TRIANGLEBVH_H
@@ -0,0 +1,156 @@
+#ifndef PROJECT_BASE_UNIFORMRING_H
+#define PROJECT_BASE_UNIFORMRING_H
+
+#include <glad/glad.h>
+#include <rg/Error.h>
+#include <rg/GLExt.h>
+#include <rg/GpuResources.h>
+
+#include <cstring>
+
+namespace rg {
+
+// One uniform buffer split into FRAMES_IN_FLIGHT regions. Every frame writes its constant blocks into the next region
+// and binds them with glBindBufferRange; a fence per region makes sure the GPU is done reading a region before the CPU
+// writes it again, so the ring never stalls as long as the GPU is less than FRAMES_IN_FLIGHT - 1 frames behind.
+// With GL 4.4 the buffer is mapped once, persistently and coherently, and Push is a plain memcpy; on GL 3.3 Push falls
+// back to glBufferSubData into the same fenced regions.
+// A region never wraps within a frame: blocks already bound for draws the GPU has not run yet would be overwritten.
+// Init takes the caller's worst case per frame; when a frame still fills more than half of a region, the next
+// BeginFrame moves to a new buffer with twice that frame's size, and a frame that overflows is a hard error.
+class UniformRing {
+public:
+    static const int FRAMES_IN_FLIGHT = 3;
+    // upper bound of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT on common drivers, for sizing a frame's blocks up front
+    static const GLsizeiptr MAX_OFFSET_ALIGNMENT = 256;
+
+    // bytes of count blocks of type T in a frame region, for the bytesPerFrame of Init
+    template<typename T>
+    static GLsizeiptr BlockBytes(size_t count) {
+        return (GLsizeiptr) count * ((sizeof(T) + MAX_OFFSET_ALIGNMENT - 1) / MAX_OFFSET_ALIGNMENT * MAX_OFFSET_ALIGNMENT);
+    }
+
+    void Init(GLsizeiptr bytesPerFrame) {
+        GLint alignment;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        offsetAlignment = alignment;
+        allocate(bytesPerFrame);
+    }
+
+    // waits (normally not at all) until the GPU has released the region this frame is going to write; grows the
+    // buffer first when the last frame came close to filling its region
+    void BeginFrame() {
+        if (lastFrameBytes > regionSize / 2)
+            allocate(2 * lastFrameBytes);
+        GLsync &fence = fences[region];
+        if (fence) {
+            GLenum status = glClientWaitSync(fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+                stalls++;
+                glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            }
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+        head = 0;
+    }
+
+    // copies data into this frame's region and returns its offset in the buffer
+    template<typename T>
+    GLintptr Push(const T &data) {
+        ASSERT(head + (GLsizeiptr) sizeof(T) <= regionSize, "UniformRing: frame region of " << regionSize
+                << " bytes overflowed; size it for the frame's worst case");
+        GLintptr offset = region * regionSize + head;
+        if (mapped) {
+            std::memcpy(mapped + offset, &data, sizeof(T));
+        } else {
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(T), &data);
+        }
+        head += align(sizeof(T));
+        return offset;
+    }
+
+    template<typename T>
+    void PushAndBind(GLuint binding, const T &data) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, Push(data), sizeof(T));
+    }
+
+    // binds a range returned by an earlier Push of this frame
+    void BindRange(GLuint binding, GLintptr offset, GLsizeiptr size) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+    }
+
+    // fences everything submitted with this frame's region and moves on to the next one
+    void EndFrame() {
+        lastFrameBytes = head;
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region = (region + 1) % FRAMES_IN_FLIGHT;
+    }
+
+    bool Persistent() const {
+        return mapped != nullptr;
+    }
+
+    // number of frames that had to wait for the GPU before writing their region
+    unsigned int Stalls() const {
+        return stalls;
+    }
+
+    // bytes of one frame's region, and of the last frame's blocks in it
+    GLsizeiptr RegionSize() const {
+        return regionSize;
+    }
+
+    GLsizeiptr LastFrameBytes() const {
+        return lastFrameBytes;
+    }
+
+private:
+    GpuRef buffer;
+    char *mapped = nullptr;
+    GLsync fences[FRAMES_IN_FLIGHT] = {};
+    GLsizeiptr offsetAlignment = 256;
+    GLsizeiptr regionSize = 0;
+    GLsizeiptr head = 0;
+    GLsizeiptr lastFrameBytes = 0;
+    int region = 0;
+    unsigned int stalls = 0;
+
+    GLsizeiptr align(GLsizeiptr size) const {
+        return (size + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+    }
+
+    // a new buffer for every region; the old one is unmapped and released, GL keeps it until the GPU is done with
+    // the frames that still read it, so its fences are no longer needed
+    void allocate(GLsizeiptr bytesPerFrame) {
+        if (mapped) {
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            mapped = nullptr;
+        }
+        for (GLsync &fence: fences) {
+            if (fence)
+                glDeleteSync(fence);
+            fence = nullptr;
+        }
+        regionSize = align(bytesPerFrame);
+        region = 0;
+        lastFrameBytes = 0;
+
+        buffer = GpuRef(GPU_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        if (glCaps.bufferStorage) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_UNIFORM_BUFFER, regionSize * FRAMES_IN_FLIGHT, nullptr, flags);
+            mapped = (char *) glMapBufferRange(GL_UNIFORM_BUFFER, 0, regionSize * FRAMES_IN_FLIGHT, flags);
+        } else {
+            glBufferData(GL_UNIFORM_BUFFER, regionSize * FRAMES_IN_FLIGHT, nullptr, GL_STREAM_DRAW);
+        }
+        buffer.SetBytes(regionSize * FRAMES_IN_FLIGHT);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+};
+
+};
+#endif //PROJECT_BASE_UNIFORMRING_H
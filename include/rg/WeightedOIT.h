@@ -0,0 +1,99 @@
+#ifndef PROJECT_BASE_WEIGHTEDOIT_H
+#define PROJECT_BASE_WEIGHTEDOIT_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+namespace rg {
+
+// Weighted blended order-independent transparency (McGuire & Bavoil 2013). Transparent surfaces are drawn in any order
+// into two targets that share the scene depth buffer:
+//   ACCUM_TARGET   rgb = sum(color * alpha * weight), a = product(1 - alpha), the revealage
+//   WEIGHT_TARGET  r   = sum(alpha * weight)
+// GL 3.3 has no per-target blend functions, so the layout is chosen to work with a single glBlendFuncSeparate:
+// colours add up and alpha multiplies. Composite() state then blends the normalised average over the opaque scene.
+// Shaders write the targets through WriteTransparent() in oit.glsl. The textures belong to the caller (the frame's
+// RenderGraph), in ACCUM_FORMAT and WEIGHT_FORMAT with the scene's sample count; SetTargets attaches them.
+class WeightedOIT {
+public:
+    static const GLenum ACCUM_TARGET = GL_COLOR_ATTACHMENT0;
+    static const GLenum WEIGHT_TARGET = GL_COLOR_ATTACHMENT1;
+    static const GLenum ACCUM_FORMAT = GL_RGBA16F;
+    static const GLenum WEIGHT_FORMAT = GL_R16F;
+    static const int ACCUM_BYTES = 8;
+    static const int WEIGHT_BYTES = 2;
+
+    // depthRenderbuffer is the opaque pass depth attachment; the targets must have its size and sample count
+    void Init(unsigned int depthRenderbuffer) {
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+        unsigned int attachments[2] = {ACCUM_TARGET, WEIGHT_TARGET};
+        glDrawBuffers(2, attachments);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // accumulation textures, attached every frame since the graph may have given their names to new ones;
+    // textureTarget is GL_TEXTURE_2D_MULTISAMPLE or, for single-sample scene targets, GL_TEXTURE_2D
+    void SetTargets(GLenum textureTarget, unsigned int accum, unsigned int weight) {
+        target = textureTarget;
+        accumTexture = accum;
+        weightTexture = weight;
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, ACCUM_TARGET, target, accumTexture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, WEIGHT_TARGET, target, weightTexture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "OIT framebuffer not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // clears the targets and sets up depth-tested, depth-write-free additive/multiplicative blending
+    void BeginAccumulate() {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        const GLfloat accumClear[] = {0.0f, 0.0f, 0.0f, 1.0f};
+        const GLfloat weightClear[] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, accumClear);
+        glClearBufferfv(GL_COLOR, 1, weightClear);
+
+        glDepthMask(GL_FALSE);
+        glDisable(GL_CULL_FACE);
+        glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    // restores the state BeginAccumulate changed; targetFBO is rebound for the composite
+    void EndAccumulate(unsigned int targetFBO) {
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glEnable(GL_CULL_FACE);
+        glDepthMask(GL_TRUE);
+        glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+    }
+
+    // binds the accumulation targets and sets the composite blend state; draw a fullscreen quad with oit_composite.fs
+    // afterwards and call EndComposite
+    void BeginComposite(GLenum accumUnit, GLenum weightUnit) {
+        glActiveTexture(accumUnit);
+        glBindTexture(target, accumTexture);
+        glActiveTexture(weightUnit);
+        glBindTexture(target, weightTexture);
+        glActiveTexture(GL_TEXTURE0);
+
+        glDisable(GL_DEPTH_TEST);
+        // the composite outputs alpha = revealage: dst = average * (1 - revealage) + dst * revealage
+        glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+    }
+
+    void EndComposite() {
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+private:
+    unsigned int FBO = 0;
+    unsigned int accumTexture = 0;
+    unsigned int weightTexture = 0;
+    GLenum target = GL_TEXTURE_2D_MULTISAMPLE;
+};
+
+};
+#endif //PROJECT_BASE_WEIGHTEDOIT_H
@@ -0,0 +1,38 @@
+#version 330 core
+// The sky from rg::Atmosphere's sky view table: columns are the azimuth from the sun (0 to pi), rows the elevation,
+// half below and half above the horizon, packed towards it (Atmosphere::rowElevation).
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+in vec3 WorldDirection;
+
+#include "frame_block.glsl"
+
+uniform sampler2D skyView;
+
+const float PI = 3.14159265;
+
+void main()
+{
+    vec3 direction = normalize(WorldDirection);
+    vec3 sunDirection = skySun.xyz;
+    // the horizon lies just below zero elevation
+    float skyHorizon = skySun.w;
+    float sunCosRadius = sunDisk.w;
+    float elevation = asin(clamp(direction.y, -1.0, 1.0));
+    float row = elevation >= skyHorizon ?
+            0.5 + 0.5 * sqrt((elevation - skyHorizon) / (0.5 * PI - skyHorizon)) :
+            0.5 - 0.5 * sqrt((skyHorizon - elevation) / (0.5 * PI + skyHorizon));
+    vec2 horizontal = direction.xz, sunHorizontal = sunDirection.xz;
+    float cosine = length(horizontal) > 1e-6 && length(sunHorizontal) > 1e-6 ?
+            dot(normalize(horizontal), normalize(sunHorizontal)) : 1.0;
+    float column = acos(clamp(cosine, -1.0, 1.0)) / PI;
+    vec3 color = texture(skyView, vec2(column, row)).rgb;
+
+    // the disk fades out over its outer tenth; the ground hides it below the horizon
+    float disk = smoothstep(sunCosRadius, mix(sunCosRadius, 1.0, 0.1), dot(direction, sunDirection));
+    vec3 sun = elevation >= skyHorizon ? sunDisk.rgb * disk : vec3(0.0);
+    FragColor = vec4(color + sun, 1.0);
+    // only the sun glows, the bright daytime sky would bloom everywhere
+    BrightColor = vec4(sun, 1.0);
+}
\ No newline at end of file
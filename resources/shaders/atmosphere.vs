@@ -0,0 +1,17 @@
+#version 330 core
+// Fullscreen triangle at the far plane in every view (rg::Atmosphere::Draw), no vertex buffer.
+
+out vec3 WorldDirection;
+
+#include "frame_block.glsl"
+#include "view.glsl"
+
+void main()
+{
+    vec2 clip = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    int view = ViewIndex();
+    // view direction through the vertex, rotated to world space; linear across the screen, so it interpolates
+    vec4 viewDirection = inverse(projections[view]) * vec4(clip, 1.0, 1.0);
+    WorldDirection = transpose(mat3(views[view])) * (viewDirection.xyz / viewDirection.w);
+    gl_Position = ToViewSlice(vec4(clip, 1.0, 1.0), view);
+}
\ No newline at end of file
@@ -1,14 +1,8 @@
 #version 330 core
-layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
 
-struct DirLight {
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
+#include "frame_block.glsl"
+#include "sky_block.glsl"
+#include "oit.glsl"
 
 struct Material {
     sampler2D texture_diffuse1;
@@ -20,12 +14,12 @@ struct Material {
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+in vec3 ViewPos;
 
+// constant for the moon, set once at startup
 uniform DirLight dirLight;
 uniform Material material;
 
-uniform vec3 viewPosition;
-
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 {
     vec3 lightDir = normalize(-light.direction);
@@ -36,7 +30,7 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 halfwayDir = normalize(lightDir+ viewDir);
     float spec = pow(max(dot(normal1, halfwayDir), 0.0), material.shininess);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
+    vec3 ambient = AmbientLight(light.ambient, normal) * vec3(texture(material.texture_diffuse1, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
     vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
     return (ambient + diffuse + specular);
@@ -45,14 +39,8 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 void main()
 {
     vec3 normal = normalize(Normal);
-    vec3 viewDir = normalize(viewPosition - FragPos);
+    vec3 viewDir = normalize(ViewPos - FragPos);
     vec3 result = CalcDirLight(dirLight, normal, viewDir);
     vec4 texColor = texture(material.texture_diffuse1, TexCoords);
-    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
-    if(brightness > 0.93)
-        BrightColor = vec4(result, 1.0);
-    else
-        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
-    FragColor = texture(material.texture_diffuse1, TexCoords)*vec4(result, 0.60);
-
+    WriteTransparent(texColor.rgb * result, texColor.a * 0.60);
 }
\ No newline at end of file
@@ -3,40 +3,49 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform int SCR_WIDTH;
-uniform int SCR_HEIGHT;
+#include "scene_samples.glsl"
 
-uniform sampler2DMS scene;
-uniform sampler2DMS bloomBlur;
+uniform SceneSampler scene;
+uniform sampler2D bloomBlur;
 
-uniform bool hdr;
-uniform bool bloom;
-uniform bool gammaEnabled;
-uniform float exposure;
-uniform bool grayscale;
+#include "post_block.glsl"
+#include "ssao.glsl"
+
+//resolved scene colour with its ambient occlusion at a texel of the scene targets
+vec3 SceneColor(ivec2 coord){
+    coord = clamp(coord, ivec2(0), ivec2(SCR_WIDTH, SCR_HEIGHT) - 1);
+
+    //multisampling: average of the sample points (one without MSAA), brightened by 1.2
+    vec3 sum = vec3(0.0);
+    for(int i = 0; i < SCENE_SAMPLES; i++)
+        sum += texelFetch(scene, coord, i).rgb;
+
+    return 1.2 / float(SCENE_SAMPLES) * sum * UpsampledOcclusion(coord);
+}
 
 void main(){
     const float gamma = 2.2;
     ivec2 viewPortDim = ivec2(SCR_WIDTH, SCR_HEIGHT);
-    ivec2 coord = ivec2(viewPortDim * TexCoords);
-
-    //multisampling: 4 sample points
-    vec3 sample0 = texelFetch(scene, coord, 0).rgb;
-    vec3 sample1 = texelFetch(scene, coord, 1).rgb;
-    vec3 sample2 = texelFetch(scene, coord, 2).rgb;
-    vec3 sample3 = texelFetch(scene, coord, 3).rgb;
 
-    vec3 hdrColor = 0.3 * (sample0 + sample1 + sample2 + sample3);
-
-    sample0 = texelFetch(bloomBlur, coord, 0).rgb;
-    sample1 = texelFetch(bloomBlur, coord, 1).rgb;
-    sample2 = texelFetch(bloomBlur, coord, 2).rgb;
-    sample3 = texelFetch(bloomBlur, coord, 3).rgb;
+    vec3 hdrColor;
+    if(viewPortDim == ivec2(outputWidth, outputHeight)){
+        hdrColor = SceneColor(ivec2(viewPortDim * TexCoords));
+    } else {
+        //dynamic resolution: bilinear upscale between the four nearest scene texels
+        vec2 position = TexCoords * vec2(viewPortDim) - 0.5;
+        ivec2 base = ivec2(floor(position));
+        vec2 f = position - vec2(base);
+        hdrColor = mix(mix(SceneColor(base), SceneColor(base + ivec2(1, 0)), f.x),
+                       mix(SceneColor(base + ivec2(0, 1)), SceneColor(base + ivec2(1, 1)), f.x), f.y);
+    }
 
-    vec3 bloomColor = 0.3 * (sample0 + sample1 + sample2 + sample3);
+    //half resolution glow of the bloom chain, already resolved
+    vec3 bloomColor = texture(bloomBlur, TexCoords).rgb * bloomStrength;
 
-    if(bloom)
+    if(bloom){
         hdrColor.r *= 1.5; // Boost red color
+        hdrColor += bloomColor;
+    }
     vec3 result;
     if(hdr)
        //tone mapping
@@ -0,0 +1,6 @@
+#version 330 core
+
+// bloomFinal.fs on single-sample scene targets (post-process anti-aliasing)
+#define SINGLE_SAMPLE
+
+#include "bloomFinal.fs"
\ No newline at end of file
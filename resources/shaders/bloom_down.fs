@@ -0,0 +1,28 @@
+#version 330 core
+// One level down the bloom chain (rg::Bloom): a 13 tap filter of bilinear fetches around the texel, four 2x2 boxes
+// around its corners weighted 1/2 and the four half-overlapping ones 1/8 each (Jimenez).
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D bloomSource;
+
+void main(){
+    vec2 texel = 1.0 / vec2(textureSize(bloomSource, 0));
+    vec3 a = texture(bloomSource, TexCoords + texel * vec2(-2.0, 2.0)).rgb;
+    vec3 b = texture(bloomSource, TexCoords + texel * vec2(0.0, 2.0)).rgb;
+    vec3 c = texture(bloomSource, TexCoords + texel * vec2(2.0, 2.0)).rgb;
+    vec3 d = texture(bloomSource, TexCoords + texel * vec2(-2.0, 0.0)).rgb;
+    vec3 e = texture(bloomSource, TexCoords).rgb;
+    vec3 f = texture(bloomSource, TexCoords + texel * vec2(2.0, 0.0)).rgb;
+    vec3 g = texture(bloomSource, TexCoords + texel * vec2(-2.0, -2.0)).rgb;
+    vec3 h = texture(bloomSource, TexCoords + texel * vec2(0.0, -2.0)).rgb;
+    vec3 i = texture(bloomSource, TexCoords + texel * vec2(2.0, -2.0)).rgb;
+    vec3 j = texture(bloomSource, TexCoords + texel * vec2(-1.0, 1.0)).rgb;
+    vec3 k = texture(bloomSource, TexCoords + texel * vec2(1.0, 1.0)).rgb;
+    vec3 l = texture(bloomSource, TexCoords + texel * vec2(-1.0, -1.0)).rgb;
+    vec3 m = texture(bloomSource, TexCoords + texel * vec2(1.0, -1.0)).rgb;
+
+    vec3 result = e * 0.125 + (a + c + g + i) * 0.03125 + (b + d + f + h) * 0.0625 + (j + k + l + m) * 0.125;
+    FragColor = vec4(max(result, vec3(0.0)), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#version 330 core
+// One level up the bloom chain (rg::Bloom): a 3x3 tent filter of bilinear fetches bloomRadius texels of the smaller
+// level apart, added to the larger level by blending.
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D bloomSource;
+
+#include "post_block.glsl"
+
+void main(){
+    vec2 offset = bloomRadius / vec2(textureSize(bloomSource, 0));
+    vec3 result = texture(bloomSource, TexCoords).rgb * 4.0;
+    result += (texture(bloomSource, TexCoords + vec2(offset.x, 0.0)).rgb +
+               texture(bloomSource, TexCoords - vec2(offset.x, 0.0)).rgb +
+               texture(bloomSource, TexCoords + vec2(0.0, offset.y)).rgb +
+               texture(bloomSource, TexCoords - vec2(0.0, offset.y)).rgb) * 2.0;
+    result += texture(bloomSource, TexCoords + offset).rgb + texture(bloomSource, TexCoords - offset).rgb +
+              texture(bloomSource, TexCoords + vec2(offset.x, -offset.y)).rgb +
+              texture(bloomSource, TexCoords + vec2(-offset.x, offset.y)).rgb;
+    FragColor = vec4(result / 16.0, 1.0);
+}
\ No newline at end of file
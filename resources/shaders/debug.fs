@@ -0,0 +1,11 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+in vec3 Color;
+
+void main(){
+    FragColor = vec4(Color, 1.0);
+    //debug geometry never blooms
+    BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+}
\ No newline at end of file
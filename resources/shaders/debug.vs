@@ -0,0 +1,13 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aColor;
+
+out vec3 Color;
+
+#include "frame_block.glsl"
+#include "view.glsl"
+
+void main(){
+    Color = aColor;
+    gl_Position = ViewClipPosition(aPos, ViewIndex());
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+#include "lighting.glsl"
+#include "gbuffer.glsl"
+
+// sum of every light at the pixel, see deferred_global.fs and deferred_point.fs
+uniform SceneSampler lightAccum;
+
+void main(){
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    if(texelFetch(gDepth, coord, 0).r <= 0.0)
+        discard;
+
+    // the bright pass needs the whole sum, so it runs here and not per light
+    vec3 result = texelFetch(lightAccum, coord, 0).rgb;
+    BrightColor = BrightPass(result);
+    FragColor = vec4(result, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 330 core
+out vec4 FragColor;
+
+// lights that reach every pixel: directional, the camera's spotlight, sky reflections and the baked light, drawn as a fullscreen quad
+
+#include "lighting.glsl"
+#include "gbuffer.glsl"
+
+void main(){
+    Surface surface;
+    if(!ReadGBuffer(ivec2(gl_FragCoord.xy), surface))
+        discard;
+    vec3 viewDir = normalize(viewPositions[0].xyz - surface.position);
+
+    vec3 result = CalcDirLight(directional, surface.normal, viewDir, surface.diffuseColor, surface.specularColor,
+                               DirectionalShadow(surface.position, surface.normal));
+    result += EnvironmentReflection(surface.normal, surface.position, viewDir, surface.specularColor);
+    result += surface.bakedLight.rgb;
+    result += CalcSpotLight(spotlight, surface.normal, surface.position, viewDir, surface.diffuseColor, surface.specularColor);
+    FragColor = vec4(result, 1.0);
+}
\ No newline at end of file
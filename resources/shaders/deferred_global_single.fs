@@ -0,0 +1,6 @@
+#version 330 core
+
+// deferred_global.fs on single-sample scene targets (post-process anti-aliasing)
+#define SINGLE_SAMPLE
+
+#include "deferred_global.fs"
\ No newline at end of file
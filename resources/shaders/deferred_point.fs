@@ -0,0 +1,32 @@
+#version 330 core
+out vec4 FragColor;
+
+flat in vec4 LightPositionRadius;
+flat in vec3 LightAmbient;
+flat in vec3 LightDiffuse;
+flat in vec3 LightSpecular;
+flat in int LightIndex;
+
+#include "lighting.glsl"
+#include "gbuffer.glsl"
+
+void main(){
+    Surface surface;
+    if(!ReadGBuffer(ivec2(gl_FragCoord.xy), surface))
+        discard;
+    // the volume's back faces passed the depth test, but the surface can still be in front of the light's sphere
+    if(length(LightPositionRadius.xyz - surface.position) >= LightPositionRadius.w)
+        discard;
+    // already part of the surface's baked light
+    if(surface.bakedLight.a > 0.0 && LightIndex < bakedPointLights)
+        discard;
+
+    PointLight light;
+    light.position = LightPositionRadius.xyz;
+    light.radius = LightPositionRadius.w;
+    light.ambient = LightAmbient;
+    light.diffuse = LightDiffuse;
+    light.specular = LightSpecular;
+    vec3 viewDir = normalize(viewPositions[0].xyz - surface.position);
+    FragColor = vec4(CalcPointLight(light, surface.normal, surface.position, viewDir, surface.diffuseColor, surface.specularColor), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// one instance per point light, read from the light buffer of rg::ClusteredLights; aPos is a sphere that encloses
+// the unit sphere, scaled to the light's radius
+
+flat out vec4 LightPositionRadius;
+flat out vec3 LightAmbient;
+flat out vec3 LightDiffuse;
+flat out vec3 LightSpecular;
+flat out int LightIndex;
+
+#include "lighting.glsl"
+
+void main(){
+    PointLight light = FetchPointLight(gl_InstanceID);
+    LightPositionRadius = vec4(light.position, light.radius);
+    LightAmbient = light.ambient;
+    LightDiffuse = light.diffuse;
+    LightSpecular = light.specular;
+    LightIndex = gl_InstanceID;
+    gl_Position = projection * view * vec4(light.position + aPos * light.radius, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#version 330 core
+
+// deferred_point.fs on single-sample scene targets (post-process anti-aliasing)
+#define SINGLE_SAMPLE
+
+#include "deferred_point.fs"
\ No newline at end of file
@@ -0,0 +1,5 @@
+#version 330 core
+
+// depth-only pass, color writes are masked off while it runs
+void main(){
+}
\ No newline at end of file
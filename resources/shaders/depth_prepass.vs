@@ -0,0 +1,15 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+
+#include "frame_block.glsl"
+#include "object_block.glsl"
+#include "view.glsl"
+
+// must match model_lighting.vs exactly so the lit pass can test with GL_EQUAL
+invariant gl_Position;
+
+void main(){
+    vec3 FragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = ViewClipPosition(FragPos, ViewIndex());
+}
\ No newline at end of file
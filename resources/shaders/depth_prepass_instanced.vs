@@ -0,0 +1,14 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in mat4 aInstanceModel;
+
+#include "frame_block.glsl"
+
+// must match model_lighting_instanced.vs exactly so the lit pass can test with GL_EQUAL
+invariant gl_Position;
+
+void main(){
+    vec3 FragPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos,1.0);
+}
\ No newline at end of file
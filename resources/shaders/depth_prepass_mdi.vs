@@ -0,0 +1,25 @@
+#version 430 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in uint aDrawID;
+
+struct DrawData{
+    mat4 model;
+    mat4 normalMatrix;
+    int diffuseLayer;
+    int specularLayer;
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer{
+    DrawData draws[];
+};
+
+#include "frame_block.glsl"
+
+// must match model_lighting_mdi.vs exactly so the lit pass can test with GL_EQUAL
+invariant gl_Position;
+
+void main(){
+    vec3 FragPos = vec3(draws[aDrawID].model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos,1.0);
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+// Per-frame constants written once per frame into the uniform ring (rg::FrameConstants). std140 layout.
+
+struct DirLight{
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct SpotLight{
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+};
+
+#define MAX_VIEWS 2
+#define SHADOW_CASCADES 3
+
+layout (std140) uniform FrameBlock{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float shininess;
+    bool blinn;
+    int pointLightCount;
+    int viewCount;
+
+    DirLight directional;
+    // clustered point lights, see lighting.glsl: grid size (x, y, z, clusters per view) and depth slicing
+    // (first slice depth, log scale)
+    ivec4 clusterGrid;
+    vec4 clusterDepth;
+    SpotLight spotlight;
+
+    // per-view cameras for multi-view passes, see view.glsl; view 0 is the main camera above
+    mat4 views[MAX_VIEWS];
+    mat4 projections[MAX_VIEWS];
+    vec4 viewPositions[MAX_VIEWS];
+    // x scale and offset that move each view's NDC x into its slice of the target
+    vec4 viewSlices[MAX_VIEWS];
+
+    // directional light shadow cascades, see lighting.glsl: world to light clip space per cascade, main camera view
+    // depth where each cascade ends (xyz), shadows on (w)
+    mat4 shadowMatrices[SHADOW_CASCADES];
+    vec4 shadowSplits;
+
+    // baked static lighting, see lighting.glsl: on, and how many of the first cluster lights the bake contains
+    bool bakedLighting;
+    int bakedPointLights;
+    // scale of the sky irradiance on the ambient terms (see sky_block.glsl), 0 for the constant ambient colours
+    float skyAmbient;
+    // scale of the prefiltered sky reflections (see lighting.glsl), 0 for none, and the environment map's last mip
+    float environmentStrength;
+    float environmentMaxLod;
+    // the runtime reflection probe's last mip and its position (xyz) and radius of influence (w), radius 0 when no
+    // probe is shown
+    float probeMaxLod;
+    vec4 reflectionProbe;
+    // the atmosphere's sky (see atmosphere.fs): direction towards the sun (xyz) and elevation of the horizon (w),
+    // radiance of the sun's disk (rgb) and the cosine of its angular radius (w)
+    vec4 skySun;
+    vec4 sunDisk;
+};
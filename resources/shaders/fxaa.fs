@@ -0,0 +1,128 @@
+#version 330 core
+// Post-process anti-aliasing (rg::Fxaa) in the manner of FXAA 3.11's quality path (Lottes): on the tonemapped image,
+// a pixel whose luma contrast with its neighbours is high enough lies on an edge. The 3x3 neighbourhood decides
+// whether the edge is horizontal or vertical and on which side of the pixel it runs; the search walks along it both
+// ways until the luma leaves the edge's average, and the sample moves across the edge by how close the pixel is to
+// the nearer end, so long steps get a long gradient. Features thinner than a pixel get a blend towards the 3x3
+// average instead.
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// tonemapped scene at the render resolution, filtered bilinearly
+uniform sampler2D source;
+
+// minimum contrast for an edge, relative to the brightest neighbour, and in absolute terms for dark areas
+const float EDGE_THRESHOLD = 0.125;
+const float EDGE_THRESHOLD_MIN = 0.0312;
+// how much of the subpixel blend is used
+const float SUBPIXEL_QUALITY = 0.75;
+// step lengths of the edge search, in texels, growing towards the far end
+const int SEARCH_STEPS = 10;
+const float SEARCH_STEP[SEARCH_STEPS] = float[](1.0, 1.0, 1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 4.0, 8.0);
+
+float Luma(vec3 color){
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+float LumaAt(vec2 uv){
+    return Luma(textureLod(source, uv, 0.0).rgb);
+}
+
+void main(){
+    vec2 texel = 1.0 / vec2(textureSize(source, 0));
+    vec2 uv = TexCoords;
+    vec3 color = textureLod(source, uv, 0.0).rgb;
+
+    float lumaM = Luma(color);
+    float lumaN = LumaAt(uv + vec2(0.0, texel.y));
+    float lumaS = LumaAt(uv - vec2(0.0, texel.y));
+    float lumaE = LumaAt(uv + vec2(texel.x, 0.0));
+    float lumaW = LumaAt(uv - vec2(texel.x, 0.0));
+    float lumaMin = min(lumaM, min(min(lumaN, lumaS), min(lumaE, lumaW)));
+    float lumaMax = max(lumaM, max(max(lumaN, lumaS), max(lumaE, lumaW)));
+    float range = lumaMax - lumaMin;
+    if(range < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD)){
+        FragColor = vec4(color, 1.0);
+        return;
+    }
+
+    float lumaNE = LumaAt(uv + texel);
+    float lumaSW = LumaAt(uv - texel);
+    float lumaNW = LumaAt(uv + vec2(-texel.x, texel.y));
+    float lumaSE = LumaAt(uv + vec2(texel.x, -texel.y));
+
+    //second differences across rows and columns: a horizontal edge changes most from row to row
+    float horizontal = abs(lumaNW + lumaSW - 2.0 * lumaW) + 2.0 * abs(lumaN + lumaS - 2.0 * lumaM) +
+                       abs(lumaNE + lumaSE - 2.0 * lumaE);
+    float vertical = abs(lumaNW + lumaNE - 2.0 * lumaN) + 2.0 * abs(lumaW + lumaE - 2.0 * lumaM) +
+                     abs(lumaSW + lumaSE - 2.0 * lumaS);
+    bool isHorizontal = horizontal >= vertical;
+
+    //the edge runs on the side with the larger gradient
+    float luma1 = isHorizontal ? lumaS : lumaW;
+    float luma2 = isHorizontal ? lumaN : lumaE;
+    float gradient1 = luma1 - lumaM;
+    float gradient2 = luma2 - lumaM;
+    bool side1 = abs(gradient1) >= abs(gradient2);
+    float gradientScaled = 0.25 * max(abs(gradient1), abs(gradient2));
+    float stepLength = isHorizontal ? texel.y : texel.x;
+    float lumaEdge;
+    if(side1){
+        stepLength = -stepLength;
+        lumaEdge = 0.5 * (luma1 + lumaM);
+    } else {
+        lumaEdge = 0.5 * (luma2 + lumaM);
+    }
+
+    //search along the edge, half a texel towards it, until the luma leaves the edge's average at both ends
+    vec2 edgeUv = uv;
+    if(isHorizontal)
+        edgeUv.y += 0.5 * stepLength;
+    else
+        edgeUv.x += 0.5 * stepLength;
+    vec2 along = isHorizontal ? vec2(texel.x, 0.0) : vec2(0.0, texel.y);
+    vec2 uvNegative = edgeUv;
+    vec2 uvPositive = edgeUv;
+    float lumaEndNegative = 0.0;
+    float lumaEndPositive = 0.0;
+    bool doneNegative = false;
+    bool donePositive = false;
+    for(int i = 0; i < SEARCH_STEPS; i++){
+        if(!doneNegative){
+            uvNegative -= along * SEARCH_STEP[i];
+            lumaEndNegative = LumaAt(uvNegative) - lumaEdge;
+            doneNegative = abs(lumaEndNegative) >= gradientScaled;
+        }
+        if(!donePositive){
+            uvPositive += along * SEARCH_STEP[i];
+            lumaEndPositive = LumaAt(uvPositive) - lumaEdge;
+            donePositive = abs(lumaEndPositive) >= gradientScaled;
+        }
+        if(doneNegative && donePositive)
+            break;
+    }
+
+    //the nearer end decides how far across the edge to sample; only when its luma change fits the pixel's side
+    float distanceNegative = isHorizontal ? uv.x - uvNegative.x : uv.y - uvNegative.y;
+    float distancePositive = isHorizontal ? uvPositive.x - uv.x : uvPositive.y - uv.y;
+    bool negativeNearer = distanceNegative < distancePositive;
+    float distanceNearer = min(distanceNegative, distancePositive);
+    float pixelOffset = 0.5 - distanceNearer / (distanceNegative + distancePositive);
+    bool centerDarker = lumaM < lumaEdge;
+    bool endMatches = ((negativeNearer ? lumaEndNegative : lumaEndPositive) < 0.0) != centerDarker;
+    float offset = endMatches ? pixelOffset : 0.0;
+
+    //subpixel aliasing: contrast between the pixel and its neighbourhood's average
+    float lumaAverage = (2.0 * (lumaN + lumaS + lumaE + lumaW) + lumaNE + lumaNW + lumaSE + lumaSW) / 12.0;
+    float subpixel = clamp(abs(lumaAverage - lumaM) / range, 0.0, 1.0);
+    subpixel = (3.0 - 2.0 * subpixel) * subpixel * subpixel;
+    offset = max(offset, subpixel * subpixel * SUBPIXEL_QUALITY);
+
+    vec2 finalUv = uv;
+    if(isHorizontal)
+        finalUv.y += offset * stepLength;
+    else
+        finalUv.x += offset * stepLength;
+    FragColor = vec4(textureLod(source, finalUv, 0.0).rgb, 1.0);
+}
\ No newline at end of file
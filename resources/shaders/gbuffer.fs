@@ -0,0 +1,26 @@
+#version 330 core
+
+#define GBUFFER_WRITE
+
+struct Material{
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+in vec4 Tint;
+in vec4 BakedLight;
+flat in int View;
+
+uniform Material material;
+
+#include "frame_block.glsl"
+#include "gbuffer.glsl"
+
+void main(){
+    vec3 diffuseColor = texture(material.texture_diffuse1, TexCoords).rgb * Tint.rgb;
+    vec3 specularColor = texture(material.texture_specular1, TexCoords).rgb;
+    WriteGBuffer(diffuseColor, specularColor, normalize(Normal), FragPos, View, BakedLight);
+}
\ No newline at end of file
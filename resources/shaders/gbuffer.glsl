@@ -0,0 +1,72 @@
+// G-buffer layout of the deferred path (rg::DeferredShading). Written by the gbuffer*.fs shaders, read back per
+// pixel by the deferred lighting passes. Include after frame_block.glsl.
+//   target 0  RGBA8   rgb = diffuse colour, a = specular intensity (the scene's specular maps are grey)
+//   target 1  RG16F   world space normal, octahedral encoding
+//   target 2  R32F    view space depth, 0 where no opaque surface was drawn
+//   target 3  RGBA16F baked light times diffuse colour, a = 1 where it replaces the baked lights (see lighting.glsl)
+// Positions are not stored: they are rebuilt from the depth and the main camera.
+
+vec2 OctahedralWrap(vec2 v){
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 EncodeNormal(vec3 n){
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    return n.z >= 0.0 ? n.xy : OctahedralWrap(n.xy);
+}
+
+vec3 DecodeNormal(vec2 e){
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if(n.z < 0.0)
+        n.xy = OctahedralWrap(n.xy);
+    return normalize(n);
+}
+
+#ifdef GBUFFER_WRITE
+layout (location = 0) out vec4 GAlbedo;
+layout (location = 1) out vec2 GNormal;
+layout (location = 2) out float GDepth;
+layout (location = 3) out vec4 GBaked;
+
+void WriteGBuffer(vec3 diffuseColor, vec3 specularColor, vec3 normal, vec3 fragPos, int view, vec4 bakedLight){
+    GAlbedo = vec4(diffuseColor, dot(specularColor, vec3(1.0 / 3.0)));
+    GNormal = EncodeNormal(normal);
+    GDepth = -(views[view] * vec4(fragPos, 1.0)).z;
+    GBaked = bakedLighting && bakedLight.a > 0.0 ? vec4(bakedLight.rgb * diffuseColor, 1.0) : vec4(0.0);
+}
+#else
+#include "scene_samples.glsl"
+
+uniform SceneSampler gAlbedo;
+uniform SceneSampler gNormal;
+uniform SceneSampler gDepth;
+uniform SceneSampler gBaked;
+
+struct Surface{
+    vec3 position;
+    vec3 normal;
+    vec3 diffuseColor;
+    vec3 specularColor;
+    // baked light already times the diffuse colour, a = 1 when it is used
+    vec4 bakedLight;
+};
+
+// the surface seen by the first sample of a pixel; false where the G-buffer is empty (sky)
+bool ReadGBuffer(ivec2 coord, out Surface surface){
+    float depth = texelFetch(gDepth, coord, 0).r;
+    if(depth <= 0.0)
+        return false;
+    vec4 albedo = texelFetch(gAlbedo, coord, 0);
+    surface.diffuseColor = albedo.rgb;
+    surface.specularColor = vec3(albedo.a);
+    surface.normal = DecodeNormal(texelFetch(gNormal, coord, 0).rg);
+    surface.bakedLight = texelFetch(gBaked, coord, 0);
+
+    // view space position along the pixel's ray, then back to world space; the view matrix is rigid, so its
+    // inverse rotation is the transpose
+    vec2 ndc = (vec2(coord) + 0.5) / vec2(SceneSize(gDepth)) * 2.0 - 1.0;
+    vec3 viewSpace = vec3(ndc.x * depth / projections[0][0][0], ndc.y * depth / projections[0][1][1], -depth);
+    surface.position = transpose(mat3(views[0])) * (viewSpace - views[0][3].xyz);
+    return true;
+}
+#endif
\ No newline at end of file
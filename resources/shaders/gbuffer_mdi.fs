@@ -0,0 +1,22 @@
+#version 430 core
+
+#define GBUFFER_WRITE
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+in vec4 BakedLight;
+flat in int DiffuseLayer;
+flat in int SpecularLayer;
+
+// every static texture resampled into one array, indexed per draw
+uniform sampler2DArray materialTextures;
+
+#include "frame_block.glsl"
+#include "gbuffer.glsl"
+
+void main(){
+    vec3 diffuseColor = texture(materialTextures, vec3(TexCoords, DiffuseLayer)).rgb;
+    vec3 specularColor = texture(materialTextures, vec3(TexCoords, SpecularLayer)).rgb;
+    WriteGBuffer(diffuseColor, specularColor, normalize(Normal), FragPos, 0, BakedLight);
+}
\ No newline at end of file
@@ -6,11 +6,11 @@ in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
-uniform vec3 lightColor;
+#include "object_block.glsl"
 
 void main(){
 
-    FragColor = vec4(lightColor, 1.0);
+    FragColor = vec4(objectColor.rgb, 1.0);
     float brightness = dot(FragColor.rgb, vec3(1.0, 0.01, 0.01));
     if(brightness > 1.0)
         BrightColor = vec4(FragColor.rgb, 1.0);
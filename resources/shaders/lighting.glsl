@@ -0,0 +1,201 @@
+// Light evaluation shared by the lit model shaders. The including shader samples its own textures and passes the
+// results to CalcLighting; the camera and the fixed lights come from the per-frame uniform block, point lights from
+// the cluster buffers built by rg::ClusteredLights, directional shadows from rg::ShadowCascades and the light of the
+// static point lights plus one bounce from rg::LightBaker; the directional ambient term follows the sky's irradiance
+// from rg::SkyIrradiance. Specular surfaces reflect the sky prefiltered by rg::SpecularEnvironment, or the scene
+// captured by the nearest of rg::ReflectionProbes when they are inside its radius.
+
+#include "frame_block.glsl"
+#include "sky_block.glsl"
+
+struct PointLight{
+    vec3 position;
+    float radius;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// four RGBA32F texels per light: position and radius, ambient, diffuse, specular
+uniform samplerBuffer clusterLights;
+// first index into clusterIndices and light count of every cluster
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterIndices;
+// one layer per cascade, depth compared in the sampler
+uniform sampler2DArrayShadow shadowMap;
+// the sky prefiltered with the GGX lobe, rougher in every mip, and the split-sum scale and bias by n.v and roughness
+uniform samplerCube environmentMap;
+uniform sampler2D brdfLut;
+// the scene around the shown reflection probe, box filtered in every mip
+uniform samplerCube probeMap;
+
+PointLight FetchPointLight(int index){
+    PointLight light;
+    vec4 positionRadius = texelFetch(clusterLights, 4 * index);
+    light.position = positionRadius.xyz;
+    light.radius = positionRadius.w;
+    light.ambient = texelFetch(clusterLights, 4 * index + 1).rgb;
+    light.diffuse = texelFetch(clusterLights, 4 * index + 2).rgb;
+    light.specular = texelFetch(clusterLights, 4 * index + 3).rgb;
+    return light;
+}
+
+// cluster of a world space position seen from a view: screen tile from its NDC, slice from its view space depth
+int ClusterIndex(vec3 fragPos, int view){
+    vec4 viewSpace = views[view] * vec4(fragPos, 1.0);
+    vec4 clip = projections[view] * viewSpace;
+    vec2 tile = (clip.xy / clip.w * 0.5 + 0.5) * vec2(clusterGrid.xy);
+    float depth = -viewSpace.z;
+    int slice = depth < clusterDepth.x ? 0 : 1 + int(log(depth / clusterDepth.x) * clusterDepth.y);
+    ivec3 cell = clamp(ivec3(ivec2(tile), slice), ivec3(0), clusterGrid.xyz - 1);
+    return view * clusterGrid.w + (cell.z * clusterGrid.y + cell.y) * clusterGrid.x + cell.x;
+}
+
+// visibility of the directional light at a world position: the cascade is picked by the main camera's view depth, so
+// every view samples the same maps. 3x3 PCF; outside the cascades nothing is shadowed.
+float DirectionalShadow(vec3 fragPos, vec3 normal){
+    if(shadowSplits.w == 0.0)
+        return 1.0;
+    float depth = -(views[0] * vec4(fragPos, 1.0)).z;
+    int cascade = 0;
+    while(cascade < SHADOW_CASCADES && depth > shadowSplits[cascade])
+        cascade++;
+    if(cascade == SHADOW_CASCADES)
+        return 1.0;
+
+    // push the position along the normal by about a texel of the cascade against acne on surfaces facing away
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    float texelWorld = 2.0 * texelSize.x / shadowMatrices[cascade][0][0];
+    vec3 coord = (shadowMatrices[cascade] * vec4(fragPos + normal * 1.5 * texelWorld, 1.0)).xyz * 0.5 + 0.5;
+    // other views can see points outside the main camera's cascades
+    if(any(lessThan(coord.xy, vec2(0.0))) || any(greaterThan(coord.xy, vec2(1.0))))
+        return 1.0;
+
+    float visibility = 0.0;
+    for(int x = -1; x <= 1; x++){
+        for(int y = -1; y <= 1; y++)
+            visibility += texture(shadowMap, vec4(coord.xy + vec2(x, y) * texelSize, cascade, coord.z));
+    }
+    return visibility / 9.0;
+}
+
+float CalcSpecular(vec3 lightDir, vec3 normal, vec3 viewDir){
+    //Blinn-Phong
+    if(blinn){
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        return pow(max(dot(normal, halfwayDir),0.0), shininess);
+    }
+    vec3 reflectDir = reflect(-lightDir, normal);
+    return pow(max(dot(viewDir, reflectDir),0.0), shininess);
+}
+
+// shadow is the light's visibility, it does not darken the ambient term
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 diffuseColor, vec3 specularColor, float shadow){
+    //ambient
+    vec3 ambient = AmbientLight(light.ambient, normal) * diffuseColor;
+    //diffuse
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(lightDir, normal), 0.0);
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    //specular
+    vec3 specular = light.specular * CalcSpecular(lightDir, normal, viewDir) * specularColor;
+
+    return ambient + (diffuse + specular) * shadow;
+}
+
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor, vec3 specularColor){
+    //ambient
+    vec3 ambient = light.ambient * diffuseColor;
+    //diffuse
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(lightDir, normal), 0.0);
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    //specular
+    vec3 specular = light.specular * CalcSpecular(lightDir, normal, viewDir) * specularColor;
+
+    //attenuation, faded to zero at the light's radius so it only touches the clusters it was binned into
+    float d = length(light.position - fragPos);
+    float window = clamp(1.0 - pow(d / light.radius, 4.0), 0.0, 1.0);
+    float att = window * window / (d*d);
+
+    return (ambient + diffuse + specular) * att;
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor, vec3 specularColor){
+    //ambient
+    vec3 ambient = light.ambient * diffuseColor;
+    //diffuse
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(lightDir, normal),0.0);
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    //specular
+    vec3 specular = light.specular * CalcSpecular(lightDir, normal, viewDir) * specularColor;
+
+    //attenuation
+    float d = length(light.position - fragPos);
+    float att = 1.0/(d*d);
+    //spotlight
+    float theta = dot(-lightDir, normalize(light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff)/epsilon, 0.0, 1.0);
+
+    return (ambient + diffuse + specular) * att * intensity;
+}
+
+// the sky reflected by a specular surface: roughness follows from the Blinn-Phong exponent, and the grazing Fresnel
+// term is scaled by the specular map's strength so surfaces without one stay matte. Inside the reflection probe's
+// radius the probe's capture replaces the sky, faded out over the outer fifth.
+vec3 EnvironmentReflection(vec3 normal, vec3 fragPos, vec3 viewDir, vec3 specularColor){
+    float reflectivity = max(specularColor.r, max(specularColor.g, specularColor.b));
+    if(environmentStrength == 0.0 || reflectivity == 0.0)
+        return vec3(0.0);
+    float roughness = sqrt(2.0 / (shininess + 2.0));
+    vec3 direction = reflect(-viewDir, normal);
+    vec3 prefiltered = textureLod(environmentMap, direction, roughness * environmentMaxLod).rgb;
+    if(reflectionProbe.w > 0.0){
+        float distance = length(fragPos - reflectionProbe.xyz);
+        float weight = 1.0 - smoothstep(0.8 * reflectionProbe.w, reflectionProbe.w, distance);
+        if(weight > 0.0)
+            prefiltered = mix(prefiltered, textureLod(probeMap, direction, roughness * probeMaxLod).rgb, weight);
+    }
+    vec2 brdf = texture(brdfLut, vec2(max(dot(normal, viewDir), 0.0), roughness)).rg;
+    return prefiltered * (specularColor * brdf.x + reflectivity * brdf.y) * environmentStrength;
+}
+
+// whether a surface's baked light (vertex attribute 10, alpha 1 where the mesh was baked) is used; the first
+// bakedPointLights cluster lights are part of it and must not be added again
+bool UsesBakedLight(vec4 bakedLight){
+    return bakedLighting && bakedLight.a > 0.0;
+}
+
+// view is the view being shaded (see view.glsl), 0 for single-view passes; bakedLight is the interpolated baked light
+vec3 CalcLighting(vec3 normal, vec3 fragPos, int view, vec3 diffuseColor, vec3 specularColor, vec4 bakedLight){
+    vec3 viewDir = normalize(viewPositions[view].xyz - fragPos);
+
+    vec3 result = CalcDirLight(directional, normal, viewDir, diffuseColor, specularColor,
+                               DirectionalShadow(fragPos, normal));
+    result += EnvironmentReflection(normal, fragPos, viewDir, specularColor);
+    int firstLight = 0;
+    if(UsesBakedLight(bakedLight)){
+        result += bakedLight.rgb * diffuseColor;
+        firstLight = bakedPointLights;
+    }
+    uvec2 range = texelFetch(clusterRanges, ClusterIndex(fragPos, view)).rg;
+    for(uint i = 0u; i < range.y; i++){
+        int index = int(texelFetch(clusterIndices, int(range.x + i)).r);
+        if(index < firstLight)
+            continue;
+        result += CalcPointLight(FetchPointLight(index), normal, fragPos, viewDir, diffuseColor, specularColor);
+    }
+    result += CalcSpotLight(spotlight, normal, fragPos, viewDir, diffuseColor, specularColor);
+    return result;
+}
+
+// check whether result is higher than some threshold, if so, output as bloom threshold color
+vec4 BrightPass(vec3 result){
+    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
+    if(brightness > 1.0)
+        return vec4(result, 1.0);
+    return vec4(0.0, 0.0, 0.0, 1.0);
+}
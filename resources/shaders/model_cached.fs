@@ -0,0 +1,47 @@
+#version 330 core
+
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+// model_lighting.fs for the objects in rg::ShadingCache: the diffuse light of the static lights comes from the
+// object's atlas, only what depends on the camera or moves is evaluated here. Single view only.
+
+struct Material{
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+in vec4 Tint;
+in vec2 AtlasCoords;
+
+uniform Material material;
+uniform sampler2D shadingAtlas;
+
+#include "lighting.glsl"
+
+void main(){
+    vec3 diffuseColor = texture(material.texture_diffuse1, TexCoords).rgb * Tint.rgb;
+    vec3 specularColor = texture(material.texture_specular1, TexCoords).rgb;
+    vec3 normal = normalize(Normal);
+    vec3 viewDir = normalize(viewPositions[0].xyz - FragPos);
+
+    vec3 result = texture(shadingAtlas, AtlasCoords).rgb * diffuseColor;
+    result += CalcDirLight(directional, normal, viewDir, vec3(0.0), specularColor, DirectionalShadow(FragPos, normal));
+    result += EnvironmentReflection(normal, FragPos, viewDir, specularColor);
+    // the static point lights only add their specular term, and nothing where it is baked
+    uvec2 range = texelFetch(clusterRanges, ClusterIndex(FragPos, 0)).rg;
+    for(uint i = 0u; i < range.y; i++){
+        int index = int(texelFetch(clusterIndices, int(range.x + i)).r);
+        if(index >= bakedPointLights)
+            result += CalcPointLight(FetchPointLight(index), normal, FragPos, viewDir, diffuseColor, specularColor);
+        else if(!bakedLighting)
+            result += CalcPointLight(FetchPointLight(index), normal, FragPos, viewDir, vec3(0.0), specularColor);
+    }
+    result += CalcSpotLight(spotlight, normal, FragPos, viewDir, diffuseColor, specularColor);
+
+    BrightColor = BrightPass(result);
+    FragColor = vec4(result, 1.0);
+}
\ No newline at end of file
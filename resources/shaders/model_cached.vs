@@ -0,0 +1,29 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// where the vertex's triangle samples its cached light, see rg::ShadingCache
+layout (location = 11) in vec2 aAtlasCoords;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+out vec4 Tint;
+out vec2 AtlasCoords;
+
+#include "frame_block.glsl"
+#include "object_block.glsl"
+#include "view.glsl"
+
+// the depth pre-pass shaders compute gl_Position the same way, see depth_prepass*.vs
+invariant gl_Position;
+
+void main(){
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = mat3(normalMatrix) * aNormal;
+    TexCoords = aTexCoords;
+    Tint = objectColor;
+    AtlasCoords = aAtlasCoords;
+    gl_Position = ViewClipPosition(FragPos, ViewIndex());
+}
\ No newline at end of file
@@ -3,18 +3,32 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// light baked by rg::LightBaker, see Mesh::SetBakedLight
+layout (location = 10) in vec4 aBakedLight;
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+out vec4 Tint;
+out vec4 BakedLight;
+out vec3 ViewPos;
+flat out int View;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "frame_block.glsl"
+#include "object_block.glsl"
+#include "view.glsl"
+
+// the depth pre-pass shaders compute gl_Position the same way, see depth_prepass*.vs
+invariant gl_Position;
 
 void main(){
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Normal = mat3(normalMatrix) * aNormal;
     TexCoords = aTexCoords;
-    gl_Position = projection * view * vec4(FragPos,1.0);
+    Tint = objectColor;
+    BakedLight = aBakedLight;
+    int view = ViewIndex();
+    ViewPos = viewPositions[view].xyz;
+    View = view;
+    gl_Position = ViewClipPosition(FragPos, view);
 }
\ No newline at end of file
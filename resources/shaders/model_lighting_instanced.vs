@@ -0,0 +1,32 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// per-instance attributes, see InstanceData in mesh.h
+layout (location = 5) in mat4 aInstanceModel;
+layout (location = 9) in vec4 aInstanceTint;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+out vec4 Tint;
+out vec4 BakedLight;
+flat out int View;
+
+#include "frame_block.glsl"
+
+// the depth pre-pass shaders compute gl_Position the same way, see depth_prepass*.vs
+invariant gl_Position;
+
+void main(){
+    FragPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+    // instance transforms are rotation, translation and uniform scale, so the model matrix also transforms normals
+    Normal = mat3(aInstanceModel) * aNormal;
+    TexCoords = aTexCoords;
+    Tint = aInstanceTint;
+    // instances share the mesh with one baked copy, they are lit at runtime
+    BakedLight = vec4(0.0);
+    View = 0;
+    gl_Position = projection * view * vec4(FragPos,1.0);
+}
\ No newline at end of file
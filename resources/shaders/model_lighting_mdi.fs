@@ -0,0 +1,26 @@
+#version 430 core
+
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+in vec4 BakedLight;
+flat in int DiffuseLayer;
+flat in int SpecularLayer;
+
+// every static texture resampled into one array, indexed per draw
+uniform sampler2DArray materialTextures;
+
+#include "lighting.glsl"
+
+void main(){
+    vec3 diffuseColor = texture(materialTextures, vec3(TexCoords, DiffuseLayer)).rgb;
+    vec3 specularColor = texture(materialTextures, vec3(TexCoords, SpecularLayer)).rgb;
+
+    vec3 result = CalcLighting(normalize(Normal), FragPos, 0, diffuseColor, specularColor, BakedLight);
+
+    BrightColor = BrightPass(result);
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,43 @@
+#version 430 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// per-instance attribute holding [0, drawCount), offset by each indirect command's baseInstance
+layout (location = 5) in uint aDrawID;
+// light baked by rg::LightBaker, zero for meshes that were not baked
+layout (location = 10) in vec4 aBakedLight;
+
+struct DrawData{
+    mat4 model;
+    mat4 normalMatrix;
+    int diffuseLayer;
+    int specularLayer;
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer{
+    DrawData draws[];
+};
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+out vec4 BakedLight;
+flat out int DiffuseLayer;
+flat out int SpecularLayer;
+
+#include "frame_block.glsl"
+
+// the depth pre-pass shaders compute gl_Position the same way, see depth_prepass*.vs
+invariant gl_Position;
+
+void main(){
+    DrawData draw = draws[aDrawID];
+    FragPos = vec3(draw.model * vec4(aPos, 1.0));
+    Normal = mat3(draw.normalMatrix) * aNormal;
+    TexCoords = aTexCoords;
+    BakedLight = aBakedLight;
+    DiffuseLayer = draw.diffuseLayer;
+    SpecularLayer = draw.specularLayer;
+    gl_Position = projection * view * vec4(FragPos,1.0);
+}
@@ -0,0 +1,7 @@
+// Per-object constants, one range of the uniform ring per draw (rg::ObjectConstants). std140 layout.
+
+layout (std140) uniform ObjectBlock{
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 objectColor;
+};
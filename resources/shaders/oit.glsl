@@ -0,0 +1,12 @@
+// Weighted blended order-independent transparency outputs (rg::WeightedOIT). Transparent fragment shaders include
+// this instead of declaring FragColor/BrightColor and call WriteTransparent once; draw order does not matter.
+
+layout (location = 0) out vec4 AccumColor;
+layout (location = 1) out vec4 AccumWeight;
+
+void WriteTransparent(vec3 color, float alpha){
+    // depth weight from McGuire and Bavoil, eq. 10: nearer and more opaque surfaces dominate the average
+    float weight = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+    AccumColor = vec4(color * alpha * weight, alpha);
+    AccumWeight = vec4(alpha * weight);
+}
\ No newline at end of file
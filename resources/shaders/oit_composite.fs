@@ -0,0 +1,40 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+in vec2 TexCoords;
+
+#include "scene_samples.glsl"
+
+uniform SceneSampler accumTexture;
+uniform SceneSampler weightTexture;
+
+#include "post_block.glsl"
+
+void main(){
+    ivec2 coord = ivec2(vec2(SCR_WIDTH, SCR_HEIGHT) * TexCoords);
+
+    //multisampling: every sample point, resolved before normalising
+    vec4 accum = vec4(0.0);
+    float weight = 0.0;
+    for(int i = 0; i < SCENE_SAMPLES; i++){
+        accum += texelFetch(accumTexture, coord, i);
+        weight += texelFetch(weightTexture, coord, i).r;
+    }
+    accum /= float(SCENE_SAMPLES);
+    weight /= float(SCENE_SAMPLES);
+
+    //no transparent surface covers this pixel
+    float revealage = accum.a;
+    if(revealage > 0.999)
+        discard;
+
+    //blended with (1 - alpha, alpha): scene * revealage + average * (1 - revealage)
+    vec3 average = accum.rgb / max(weight, 0.00001);
+    FragColor = vec4(average, revealage);
+    float brightness = dot(average, vec3(0.2126, 0.7152, 0.0722));
+    if(brightness > 0.93)
+        BrightColor = vec4(average, revealage);
+    else
+        BrightColor = vec4(0.0, 0.0, 0.0, revealage);
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#version 330 core
+
+// oit_composite.fs on single-sample scene targets (post-process anti-aliasing)
+#define SINGLE_SAMPLE
+
+#include "oit_composite.fs"
\ No newline at end of file
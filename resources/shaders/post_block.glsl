@@ -0,0 +1,27 @@
+// Post-processing constants, one range of the uniform ring per pass (rg::PostConstants). std140 layout.
+
+layout (std140) uniform PostBlock{
+    int SCR_WIDTH;
+    int SCR_HEIGHT;
+    bool horizontal;
+    bool hdr;
+    bool bloom;
+    bool gammaEnabled;
+    bool grayscale;
+    float exposure;
+    // ambient occlusion, see ssao.glsl: on, resolution divisor, hemisphere samples and radius, the camera's projection
+    // scale (x, y) and near and far planes (z, w), exponent applied to the result
+    bool ssao;
+    int ssaoScale;
+    int ssaoSamples;
+    float ssaoRadius;
+    vec4 ssaoProjection;
+    float ssaoIntensity;
+    // bloom, see rg::Bloom: the glow's scale in the composite and the upsampling tent's radius in texels
+    float bloomStrength;
+    float bloomRadius;
+    // size of the default framebuffer; the scene targets (SCR_WIDTH x SCR_HEIGHT) are smaller under dynamic
+    // resolution and the composite upscales them
+    int outputWidth;
+    int outputHeight;
+};
@@ -0,0 +1,32 @@
+#version 330 core
+out vec4 FragColor;
+
+// reflection probe faces, see rg::ReflectionProbes: a blurred diffuse texture lit by the sky's ambient term, the sun
+// without shadows and the baked light; no speculars, point lights or reflections
+
+struct Material{
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+in vec4 Tint;
+in vec4 BakedLight;
+
+uniform Material material;
+
+#include "lighting.glsl"
+
+void main(){
+    // probes are small and filtered further by their mips, a coarser texture level is enough
+    vec3 diffuseColor = texture(material.texture_diffuse1, TexCoords, 2.0).rgb * Tint.rgb;
+    vec3 normal = normalize(Normal);
+
+    vec3 result = AmbientLight(directional.ambient, normal) * diffuseColor;
+    result += directional.diffuse * max(dot(normalize(-directional.direction), normal), 0.0) * diffuseColor;
+    if(UsesBakedLight(BakedLight))
+        result += BakedLight.rgb * diffuseColor;
+    FragColor = vec4(result, 1.0);
+}
\ No newline at end of file
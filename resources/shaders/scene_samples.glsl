@@ -0,0 +1,12 @@
+//sample count of the scene targets: 4x multisampled, or single-sample for post-process anti-aliasing, where a
+//variant shader defines SINGLE_SAMPLE before including the shared one. texelFetch takes a sample index on a
+//sampler2DMS and a mip level on a sampler2D, so loops over SCENE_SAMPLES fetch level 0 of a single-sample target
+#ifdef SINGLE_SAMPLE
+#define SceneSampler sampler2D
+#define SCENE_SAMPLES 1
+#define SceneSize(s) textureSize(s, 0)
+#else
+#define SceneSampler sampler2DMS
+#define SCENE_SAMPLES 4
+#define SceneSize(s) textureSize(s)
+#endif
\ No newline at end of file
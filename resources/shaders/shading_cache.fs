@@ -0,0 +1,25 @@
+#version 330 core
+out vec4 Irradiance;
+
+// diffuse light of the lights that never move, for a white surface: the sun's ambient and shadowed diffuse term and
+// either the baked light or the static point lights (the first bakedPointLights cluster lights). model_cached.fs
+// multiplies it by the albedo.
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec4 BakedLight;
+
+#include "lighting.glsl"
+
+void main(){
+    vec3 normal = normalize(Normal);
+
+    vec3 irradiance = CalcDirLight(directional, normal, normal, vec3(1.0), vec3(0.0), DirectionalShadow(FragPos, normal));
+    if(UsesBakedLight(BakedLight)){
+        irradiance += BakedLight.rgb;
+    } else {
+        for(int i = 0; i < bakedPointLights; i++)
+            irradiance += CalcPointLight(FetchPointLight(i), normal, FragPos, normal, vec3(1.0), vec3(0.0));
+    }
+    Irradiance = vec4(irradiance, 1.0);
+}
\ No newline at end of file
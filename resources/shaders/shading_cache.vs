@@ -0,0 +1,22 @@
+#version 330 core
+
+// a triangle's cell in its object's atlas, see rg::ShadingCache: the attributes are the triangle's, extended over the
+// whole cell, and the position on screen is the cell in the atlas
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 10) in vec4 aBakedLight;
+layout (location = 11) in vec2 aAtlasCoords;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec4 BakedLight;
+
+#include "frame_block.glsl"
+#include "object_block.glsl"
+
+void main(){
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = mat3(normalMatrix) * aNormal;
+    BakedLight = aBakedLight;
+    gl_Position = vec4(aAtlasCoords * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,5 @@
+// Cascade a shadow pass renders, one range of the uniform ring per cascade (rg::ShadowConstants). std140 layout.
+
+layout (std140) uniform ShadowBlock{
+    int cascade;
+};
@@ -0,0 +1,11 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+
+#include "frame_block.glsl"
+#include "object_block.glsl"
+#include "shadow_block.glsl"
+
+void main(){
+    gl_Position = shadowMatrices[cascade] * (model * vec4(aPos, 1.0));
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+// Sky irradiance, written at load time by rg::SkyIrradiance (rg::SkyConstants) and again whenever rg::Atmosphere's
+// sky changes. std140 layout. Include after frame_block.glsl.
+
+layout (std140) uniform SkyBlock{
+    // irradiance over pi as a polynomial of the normal: 1, y, z, x, xy, yz, 3z^2 - 1, xz, x^2 - y^2
+    vec4 skyIrradiance[9];
+};
+
+// ambient colour of a surface facing normal: the light's constant colour, scaled by the sky's irradiance (average
+// luminance 1) when skyAmbient is on. A zero normal gives the average over all directions.
+vec3 AmbientLight(vec3 ambient, vec3 normal){
+    if(skyAmbient == 0.0)
+        return ambient;
+    vec3 n = normal;
+    vec3 sky = skyIrradiance[0].rgb
+             + skyIrradiance[1].rgb * n.y + skyIrradiance[2].rgb * n.z + skyIrradiance[3].rgb * n.x
+             + skyIrradiance[4].rgb * (n.x * n.y) + skyIrradiance[5].rgb * (n.y * n.z)
+             + skyIrradiance[6].rgb * (3.0 * n.z * n.z - 1.0) + skyIrradiance[7].rgb * (n.x * n.z)
+             + skyIrradiance[8].rgb * (n.x * n.x - n.y * n.y);
+    // the nine terms can ring below zero opposite a bright part of the sky
+    return ambient * max(sky, vec3(0.0)) * skyAmbient;
+}
\ No newline at end of file
@@ -1,5 +1,6 @@
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
 
 in vec3 TexCoords;
 
@@ -8,4 +9,5 @@ uniform samplerCube skybox;
 void main()
 {    
     FragColor = texture(skybox, TexCoords);
+    BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
 }
\ No newline at end of file
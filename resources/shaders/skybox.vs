@@ -3,12 +3,14 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+#include "frame_block.glsl"
+#include "view.glsl"
 
 void main()
 {
     TexCoords = vec3(aPos.x, -aPos.y, aPos.z); // Rotacija za 180 stepeni zbog skyboxa
-    vec4 pos = projection * view * vec4(aPos, 1.0);
-    gl_Position = pos.xyww;
+    // drop the translation so the skybox stays centered on the camera
+    int view = ViewIndex();
+    vec4 pos = projections[view] * mat4(mat3(views[view])) * vec4(aPos, 1.0);
+    gl_Position = ToViewSlice(pos.xyww, view);
 }
\ No newline at end of file
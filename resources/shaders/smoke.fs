@@ -0,0 +1,18 @@
+#version 330 core
+
+in vec2 Corner;
+in vec4 Color;
+
+#include "frame_block.glsl"
+#include "sky_block.glsl"
+#include "oit.glsl"
+
+void main(){
+    //soft round puff
+    float falloff = 1.0 - dot(Corner, Corner);
+    if(falloff <= 0.0)
+        discard;
+
+    vec3 color = Color.rgb * (AmbientLight(directional.ambient, vec3(0.0)) + directional.diffuse * 0.5);
+    WriteTransparent(color, Color.a * falloff * falloff);
+}
\ No newline at end of file
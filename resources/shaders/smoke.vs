@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;
+// per puff: xyz centre and radius, colour and opacity
+layout (location = 1) in vec4 aPuff;
+layout (location = 2) in vec4 aColor;
+
+out vec2 Corner;
+out vec4 Color;
+
+#include "frame_block.glsl"
+
+void main(){
+    //camera facing billboard, right and up are the first two rows of the view matrix
+    vec3 right = vec3(view[0][0], view[1][0], view[2][0]);
+    vec3 up = vec3(view[0][1], view[1][1], view[2][1]);
+    vec3 position = aPuff.xyz + (right * aCorner.x + up * aCorner.y) * aPuff.w;
+    Corner = aCorner;
+    Color = aColor;
+    gl_Position = projection * view * vec4(position, 1.0);
+}
\ No newline at end of file
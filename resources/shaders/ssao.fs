@@ -0,0 +1,63 @@
+#version 330 core
+out float Occlusion;
+
+// hemisphere ambient occlusion at the reduced resolution, see rg::Ssao: ssaoSamples points around the normal rebuilt
+// from the depth, rotated per pixel, each occluded when the depth buffer lies in front of it within ssaoRadius
+
+#include "post_block.glsl"
+#include "ssao.glsl"
+
+float DepthAt(ivec2 texel){
+    return texelFetch(ssaoDepth, clamp(texel, ivec2(0), textureSize(ssaoDepth, 0) - 1), 0).r;
+}
+
+void main(){
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    vec2 size = vec2(textureSize(ssaoDepth, 0));
+    float depth = DepthAt(coord);
+    if(depth >= ssaoProjection.w * 0.999){
+        Occlusion = 1.0;
+        return;
+    }
+    vec2 uv = (vec2(coord) + 0.5) / size;
+    vec3 position = ViewPosition(uv, depth);
+
+    // normal from the neighbour on each axis that is closer in depth, so silhouettes do not bend it
+    vec3 left = ViewPosition(uv - vec2(1.0 / size.x, 0.0), DepthAt(coord - ivec2(1, 0)));
+    vec3 right = ViewPosition(uv + vec2(1.0 / size.x, 0.0), DepthAt(coord + ivec2(1, 0)));
+    vec3 down = ViewPosition(uv - vec2(0.0, 1.0 / size.y), DepthAt(coord - ivec2(0, 1)));
+    vec3 up = ViewPosition(uv + vec2(0.0, 1.0 / size.y), DepthAt(coord + ivec2(0, 1)));
+    vec3 dx = abs(right.z - position.z) < abs(position.z - left.z) ? right - position : position - left;
+    vec3 dy = abs(up.z - position.z) < abs(position.z - down.z) ? up - position : position - down;
+    vec3 normal = normalize(cross(dx, dy));
+
+    // interleaved gradient noise turns the kernel around the normal; the blur averages the pattern away
+    float angle = 6.2831853 * fract(52.9829189 * fract(dot(vec2(coord), vec2(0.06711056, 0.00583715))));
+    vec3 random = vec3(cos(angle), sin(angle), 0.0);
+    vec3 tangent = normalize(random - normal * dot(random, normal));
+    mat3 tbn = mat3(tangent, cross(normal, tangent), normal);
+
+    // the low resolution depth is the nearest of its block, so slopes and distance need a larger margin
+    float bias = 0.02 * ssaoRadius + 0.005 * depth;
+    float occlusion = 0.0;
+    for(int i = 0; i < ssaoSamples; i++){
+        // golden angle spiral over the hemisphere, denser near the normal, with lengths shuffled and packed towards
+        // the center
+        float u = (float(i) + 0.5) / float(ssaoSamples);
+        float phi = 2.3999632 * float(i);
+        float sinTheta = sqrt(u);
+        vec3 direction = vec3(cos(phi) * sinTheta, sin(phi) * sinTheta, sqrt(1.0 - u));
+        float t = float((i * 7) % ssaoSamples + 1) / float(ssaoSamples);
+        vec3 samplePosition = position + tbn * direction * ssaoRadius * mix(0.1, 1.0, t * t);
+
+        vec2 sampleUv = samplePosition.xy / -samplePosition.z * ssaoProjection.xy * 0.5 + 0.5;
+        if(any(lessThan(sampleUv, vec2(0.0))) || any(greaterThan(sampleUv, vec2(1.0))))
+            continue;
+        float occluderDepth = DepthAt(ivec2(sampleUv * size));
+        float sampleDepth = -samplePosition.z;
+        // surfaces far in front of the sample belong to something else and only count within the radius
+        float range = smoothstep(0.0, 1.0, ssaoRadius / abs(depth - occluderDepth));
+        occlusion += (occluderDepth < sampleDepth - bias ? 1.0 : 0.0) * range;
+    }
+    Occlusion = pow(1.0 - occlusion / float(ssaoSamples), ssaoIntensity);
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+// Ambient occlusion shared by the rg::Ssao passes and the composite in bloomFinal.fs. Include after post_block.glsl.
+// Depths are linear view space distances along the camera axis, the sky is at the far plane.
+
+// single-sample copy of the scene depth, nearest linear depth of every ssaoScale x ssaoScale block, and the occlusion
+// at that size
+uniform sampler2D sceneDepth;
+uniform sampler2D ssaoDepth;
+uniform sampler2D ssaoTexture;
+
+float LinearDepth(float depth){
+    float near = ssaoProjection.z;
+    float far = ssaoProjection.w;
+    return near * far / (far - depth * (far - near));
+}
+
+// view space position at screen coordinates uv in [0, 1] and linear depth
+vec3 ViewPosition(vec2 uv, float depth){
+    return vec3((uv * 2.0 - 1.0) / ssaoProjection.xy * depth, -depth);
+}
+
+// occlusion at a full resolution pixel: the four nearest low resolution texels, weighted bilinearly and by how well
+// their depth matches the pixel's, so occlusion does not bleed across silhouettes
+float UpsampledOcclusion(ivec2 coord){
+    if(!ssao)
+        return 1.0;
+    float depth = LinearDepth(texelFetch(sceneDepth, coord, 0).r);
+    ivec2 last = textureSize(ssaoTexture, 0) - 1;
+    vec2 position = (vec2(coord) + 0.5) / float(ssaoScale) - 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 f = position - vec2(base);
+
+    float sum = 0.0;
+    float weightSum = 0.0;
+    for(int y = 0; y <= 1; y++){
+        for(int x = 0; x <= 1; x++){
+            ivec2 texel = clamp(base + ivec2(x, y), ivec2(0), last);
+            float bilinear = (x == 0 ? 1.0 - f.x : f.x) * (y == 0 ? 1.0 - f.y : f.y);
+            float difference = abs(texelFetch(ssaoDepth, texel, 0).r - depth) / depth;
+            float weight = bilinear / (difference + 0.001);
+            sum += texelFetch(ssaoTexture, texel, 0).r * weight;
+            weightSum += weight;
+        }
+    }
+    return weightSum > 0.0 ? sum / weightSum : 1.0;
+}
\ No newline at end of file
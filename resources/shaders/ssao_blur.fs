@@ -0,0 +1,26 @@
+#version 330 core
+out float Occlusion;
+
+// one direction of the separable bilateral blur of the occlusion, see rg::Ssao: a Gaussian whose taps fade out when
+// their depth differs from the center's
+
+#include "post_block.glsl"
+#include "ssao.glsl"
+
+void main(){
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    ivec2 last = textureSize(ssaoTexture, 0) - 1;
+    ivec2 direction = horizontal ? ivec2(1, 0) : ivec2(0, 1);
+    float depth = texelFetch(ssaoDepth, coord, 0).r;
+
+    float sum = 0.0;
+    float weightSum = 0.0;
+    for(int i = -4; i <= 4; i++){
+        ivec2 texel = clamp(coord + direction * i, ivec2(0), last);
+        float difference = abs(texelFetch(ssaoDepth, texel, 0).r - depth) / depth;
+        float weight = exp(-float(i * i) / 8.0) * exp(-difference * 50.0);
+        sum += texelFetch(ssaoTexture, texel, 0).r * weight;
+        weightSum += weight;
+    }
+    Occlusion = sum / weightSum;
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#version 330 core
+out float Depth;
+
+// nearest linear depth of the ssaoScale x ssaoScale block of resolved scene depth this texel covers, see rg::Ssao
+
+#include "post_block.glsl"
+#include "ssao.glsl"
+
+void main(){
+    ivec2 base = ivec2(gl_FragCoord.xy) * ssaoScale;
+    ivec2 last = textureSize(sceneDepth, 0) - 1;
+    float nearest = 1.0;
+    for(int y = 0; y < ssaoScale; y++){
+        for(int x = 0; x < ssaoScale; x++)
+            nearest = min(nearest, texelFetch(sceneDepth, min(base + ivec2(x, y), last), 0).r);
+    }
+    Depth = LinearDepth(nearest);
+}
\ No newline at end of file
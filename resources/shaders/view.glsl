@@ -0,0 +1,19 @@
+// Single-pass multi-view rendering. Multi-view draws are instanced viewCount times and instance gl_InstanceID % viewCount
+// renders into that view's horizontal slice of the target: its clip space x is squeezed into the slice and
+// gl_ClipDistance cuts off what would spill into the neighbouring one. With viewCount = 1 the slice is the whole target
+// and ViewClipPosition is the plain projection * view transform. Include after frame_block.glsl.
+
+int ViewIndex(){
+    return gl_InstanceID % viewCount;
+}
+
+vec4 ToViewSlice(vec4 clip, int view){
+    gl_ClipDistance[0] = clip.w + clip.x;
+    gl_ClipDistance[1] = clip.w - clip.x;
+    clip.x = clip.x * viewSlices[view].x + viewSlices[view].y * clip.w;
+    return clip;
+}
+
+vec4 ViewClipPosition(vec3 worldPos, int view){
+    return ToViewSlice(projections[view] * (views[view] * vec4(worldPos, 1.0)), view);
+}
\ No newline at end of file
@@ -14,7 +14,35 @@
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
 
+#include <rg/Atmosphere.h>
+#include <rg/Bloom.h>
+#include <rg/Bounds.h>
+#include <rg/ClusteredLights.h>
+#include <rg/DeferredShading.h>
+#include <rg/DynamicResolution.h>
+#include <rg/ShadowCascades.h>
+#include <rg/DebugDraw.h>
+#include <rg/FramePacer.h>
+#include <rg/Fxaa.h>
+#include <rg/GLExt.h>
+#include <rg/GpuResources.h>
+#include <rg/InstanceCuller.h>
+#include <rg/LightBaker.h>
+#include <rg/Profiler.h>
+#include <rg/ReflectionProbes.h>
+#include <rg/RenderGraph.h>
+#include <rg/ShaderConstants.h>
+#include <rg/ShadingCache.h>
+#include <rg/SkyIrradiance.h>
+#include <rg/SpecularEnvironment.h>
+#include <rg/Ssao.h>
+#include <rg/Smoke.h>
+#include <rg/StaticBatch.h>
+#include <rg/UniformRing.h>
+#include <rg/WeightedOIT.h>
+
 #include <iostream>
+#include <memory>
 
 //FUNCTIONS-------------------------------------------------------------------------------------------------------------
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
@@ -22,13 +50,31 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
-unsigned int loadCubemap(vector<std::string> faces);
+
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
+
+void window_refresh_callback(GLFWwindow *window);
+rg::GpuRef loadCubemap(vector<std::string> faces);
 void renderQuad();
-void renderCube();
+void renderCube(int instanceCount = 1);
+
+void appendTracerLights(std::vector<rg::PointLightConstants> &lights, int count, float time);
 
 //SETTINGS--------------------------------------------------------------------------------------------------------------
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+//samples per pixel of the scene targets with MSAA
+const int SCENE_MSAA_SAMPLES = 4;
+
+//anti-aliasing of the 3D scene
+enum Antialiasing {
+    //multisampled scene targets, resolved in the composites
+    ANTIALIASING_MSAA,
+    //single-sample scene targets, FXAA on the tonemapped image
+    ANTIALIASING_FXAA,
+    //single-sample scene targets only
+    ANTIALIASING_NONE
+};
 
 //CAMERA----------------------------------------------------------------------------------------------------------------
 float lastX = SCR_WIDTH / 2.0f;
@@ -48,9 +94,351 @@ float exposure = 1.0f;
 bool grayscale = false;
 bool grayscaleON = false;
 
+//RENDERER SETTINGS-----------------------------------------------------------------------------------------------------
+struct RenderSettings {
+    //submit every static opaque mesh with one glMultiDrawElementsIndirect (GL 4.3+)
+    bool multiDrawIndirect = false;
+    //field of instanced T-90 copies drawn with Model::DrawInstanced, one draw call per tank mesh
+    bool tankArmy = false;
+    int tankArmySize = 10000;
+    //frustum cull the army in a compute shader and draw the survivors with indirect draws (GL 4.3+)
+    bool gpuCulling = false;
+    //lay down opaque depth with a position-only shader first, then shade with GL_EQUAL so each pixel is lit once
+    bool depthPrepass = false;
+    //smoke columns over the ruins and the tank, drawn unsorted through weighted blended OIT with the moon
+    bool smoke = true;
+    //debug lines for object bounds, point lights with their range and a frozen copy of the camera frustum
+    bool debugDraw = false;
+    bool debugBounds = true;
+    bool debugLights = true;
+    bool debugFrustum = false;
+    //second view from the tank's gunner sight, rendered in the same passes as the main camera (instanced multi-view)
+    bool splitScreen = false;
+    //render only when something changed (input, settings, resize) and let animations redraw at most animationRate
+    //times per second; otherwise the loop sleeps in glfwWaitEventsTimeout
+    bool onDemand = false;
+    int animationRate = 30;
+    //anti-aircraft tracers and flak bursts as small dynamic point lights, shaded through the light clusters
+    bool tracerLights = false;
+    int tracerLightCount = 4096;
+    //opaque geometry into a G-buffer, then lights added up as fullscreen passes and light volumes; split screen
+    //always draws forward
+    bool deferredShading = false;
+    //cascaded shadow maps for the directional light up to shadowDistance from the camera; the static casters are
+    //cached per cascade and only redrawn when a cascade moves on its snap grid
+    bool shadows = true;
+    float shadowDistance = 250.0f;
+    //light of the bullet lights and the first bounce of all static lights, baked per vertex into the ground objects
+    //at load time; those surfaces only evaluate the sun and the dynamic lights per pixel
+    bool bakedLighting = true;
+    //ambient terms coloured and shaped by the skybox's irradiance (nine spherical harmonics) instead of constant,
+    //scaled by skyAmbientStrength
+    bool skyAmbient = true;
+    float skyAmbientStrength = 1.0f;
+    //surfaces with a specular map reflect the sky, prefiltered by roughness at load time
+    bool environmentReflections = true;
+    float environmentStrength = 1.0f;
+    //near a reflection probe they reflect the scene around it instead, captured at run time a face (or the mips) at a
+    //time within probeBudgetMs of GPU time per frame
+    bool reflectionProbes = true;
+    float probeBudgetMs = 0.5f;
+    //ambient occlusion from the resolved depth at half (0) or quarter (1) resolution, with 8, 16 or 32 samples by
+    //quality, applied to the scene in the final composite; split screen has none
+    bool ssao = true;
+    int ssaoResolution = 0;
+    int ssaoQuality = rg::Ssao::MEDIUM;
+    float ssaoRadius = 2.0f;
+    float ssaoIntensity = 1.5f;
+    //the ground objects' diffuse light from the static lights is shaded into per-object atlases and reused; stale
+    //pages (after a light or shadow change) in view or near the camera are shaded again, at most
+    //shadingCachePageBudget pages per frame. Forward single view without multi-draw only
+    bool shadingCache = false;
+    int shadingCachePageBudget = 16;
+    //a daytime sky from atmospheric scattering instead of the skybox, with the sun at sunElevation and sunAzimuth
+    //(degrees) as the directional light; its ambient light and reflections follow the sky
+    bool atmosphere = false;
+    float sunElevation = 51.0f;
+    float sunAzimuth = 60.0f;
+    float turbidity = 1.0f;
+    //glow of the bright parts (B), blurred over a chain of bloomLevels half, quarter, ... resolution targets; the
+    //tent radius spreads each level by bloomRadius of its texels
+    int bloomLevels = 3;
+    float bloomRadius = 1.0f;
+    float bloomStrength = 1.0f;
+    //3D render resolution as a share of the window's per side: fixed at renderScale, or with dynamicResolution
+    //chosen from the GPU frame time to hold the target time within the scale bounds; the composite upscales it
+    float renderScale = 1.0f;
+    bool dynamicResolution = false;
+    rg::DynamicResolution::Settings resolution;
+    //anti-aliasing (Antialiasing): 4x MSAA, or FXAA after tonemapping on single-sample scene targets, which need a
+    //quarter of the memory and bandwidth, or none
+    int antialiasing = ANTIALIASING_MSAA;
+    //list the frame's render graph in ImGui: every pass with its GPU time and resources, culled ones greyed out,
+    //and which pool texture each transient target got
+    bool renderGraphView = false;
+};
+
+RenderSettings renderSettings;
+
+//started from ImGui: renders each light count with the forward and then the deferred path for FRAMES_PER_STEP frames
+//and records the GPU time of the opaque lighting (forward lit pass against G-buffer plus lighting passes)
+struct LightScalingSweep {
+    static const int STEPS = 6;
+    static const int FRAMES_PER_STEP = 120;
+    int lightCounts[STEPS] = {0, 256, 1024, 2048, 4096, 8192};
+    float forwardMs[STEPS] = {};
+    float deferredMs[STEPS] = {};
+    bool running = false;
+    int step = 0;
+    int frame = 0;
+
+    void Start() {
+        *this = LightScalingSweep();
+        running = true;
+    }
+
+    //overrides the settings the sweep is measuring
+    void Apply(RenderSettings &settings) const {
+        settings.tracerLights = true;
+        settings.tracerLightCount = lightCounts[step / 2];
+        settings.deferredShading = step % 2 == 1;
+        settings.splitScreen = false;
+    }
+
+    //called after every frame with the smoothed GPU times of both paths
+    void Record(float forwardFrameMs, float deferredFrameMs) {
+        if (++frame < FRAMES_PER_STEP)
+            return;
+        if (step % 2 == 0)
+            forwardMs[step / 2] = forwardFrameMs;
+        else
+            deferredMs[step / 2] = deferredFrameMs;
+        frame = 0;
+        running = ++step < 2 * STEPS;
+    }
+};
+
+LightScalingSweep lightScalingSweep;
+
+//started from ImGui: renders the current view at one instant (time stands still) with each anti-aliasing mode and
+//compares the window's image with a reference of 4x MSAA at twice the resolution per side, which the composite's
+//bilinear upscale averages down to 16 samples per pixel. Records the GPU time of the frame, the memory of the scene
+//and render graph targets, and the RMS error against the reference over the whole image and over its edges (pixels
+//with a luma step of EDGE_CONTRAST to a neighbour). FXAA's edges are acceptable when their error is at most
+//ACCEPTABLE_EDGE_RATIO of the error without anti-aliasing
+struct AntialiasingComparison {
+    static const int MODES = 4;
+    static const int SETTLE_FRAMES = 10;
+    static const int FRAMES_PER_MODE = 40;
+    static constexpr float EDGE_CONTRAST = 0.1f;
+    static constexpr float ACCEPTABLE_EDGE_RATIO = 0.85f;
+    const char *names[MODES] = {"reference", "4x MSAA", "FXAA", "none"};
+    int modes[MODES] = {ANTIALIASING_MSAA, ANTIALIASING_MSAA, ANTIALIASING_FXAA, ANTIALIASING_NONE};
+    float scales[MODES] = {2.0f, 1.0f, 1.0f, 1.0f};
+    float gpuMs[MODES] = {};
+    size_t targetBytes[MODES] = {};
+    //RMS difference from the reference in 8-bit levels, over all pixels and over the edges
+    float error[MODES] = {};
+    float edgeError[MODES] = {};
+    int edgePixels = 0;
+    bool running = false;
+    bool finished = false;
+    int mode = 0;
+    int frame = 0;
+    float time = 0.0f;
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> reference;
+    std::vector<bool> edges;
+    //the settings the comparison overrides, restored when it ends
+    int savedAntialiasing = ANTIALIASING_MSAA;
+    float savedRenderScale = 1.0f;
+    bool savedDynamicResolution = false;
+
+    void Start(const RenderSettings &settings, float now) {
+        *this = AntialiasingComparison();
+        running = true;
+        time = now;
+        savedAntialiasing = settings.antialiasing;
+        savedRenderScale = settings.renderScale;
+        savedDynamicResolution = settings.dynamicResolution;
+    }
+
+    void Apply(RenderSettings &settings) const {
+        settings.antialiasing = modes[mode];
+        settings.renderScale = scales[mode];
+        settings.dynamicResolution = false;
+    }
+
+    //called after the frame is in the window's back buffer, before ImGui draws over it
+    void Record(float frameMs, size_t bytes, int windowWidth, int windowHeight, RenderSettings &settings) {
+        frame++;
+        if (frame > SETTLE_FRAMES)
+            gpuMs[mode] += frameMs / (FRAMES_PER_MODE - SETTLE_FRAMES);
+        if (frame < FRAMES_PER_MODE)
+            return;
+
+        targetBytes[mode] = bytes;
+        std::vector<unsigned char> image((size_t) windowWidth * windowHeight * 4);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glReadPixels(0, 0, windowWidth, windowHeight, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+        if (mode == 0) {
+            width = windowWidth;
+            height = windowHeight;
+            reference = image;
+            findEdges();
+        } else if (windowWidth != width || windowHeight != height) {
+            //the window changed size, the images no longer match
+            stop(settings);
+            return;
+        } else {
+            compare(image);
+        }
+        frame = 0;
+        if (++mode == MODES) {
+            finished = true;
+            stop(settings);
+        }
+    }
+
+    bool Acceptable() const {
+        return edgeError[2] <= ACCEPTABLE_EDGE_RATIO * edgeError[3];
+    }
+
+private:
+    void stop(RenderSettings &settings) {
+        running = false;
+        settings.antialiasing = savedAntialiasing;
+        settings.renderScale = savedRenderScale;
+        settings.dynamicResolution = savedDynamicResolution;
+        reference.clear();
+    }
+
+    float luma(const std::vector<unsigned char> &image, int x, int y) const {
+        const unsigned char *pixel = &image[((size_t) y * width + x) * 4];
+        return (0.299f * pixel[0] + 0.587f * pixel[1] + 0.114f * pixel[2]) / 255.0f;
+    }
+
+    void findEdges() {
+        edges.assign((size_t) width * height, false);
+        edgePixels = 0;
+        for (int y = 0; y + 1 < height; y++) {
+            for (int x = 0; x + 1 < width; x++) {
+                float center = luma(reference, x, y);
+                if (std::abs(luma(reference, x + 1, y) - center) < EDGE_CONTRAST &&
+                    std::abs(luma(reference, x, y + 1) - center) < EDGE_CONTRAST)
+                    continue;
+                edges[(size_t) y * width + x] = true;
+                edgePixels++;
+            }
+        }
+    }
+
+    void compare(const std::vector<unsigned char> &image) {
+        double sum = 0.0;
+        double edgeSum = 0.0;
+        for (size_t pixel = 0; pixel < edges.size(); pixel++) {
+            double squared = 0.0;
+            for (int channel = 0; channel < 3; channel++) {
+                double difference = (double) image[pixel * 4 + channel] - reference[pixel * 4 + channel];
+                squared += difference * difference / 3.0;
+            }
+            sum += squared;
+            if (edges[pixel])
+                edgeSum += squared;
+        }
+        error[mode] = (float) std::sqrt(sum / edges.size());
+        edgeError[mode] = edgePixels > 0 ? (float) std::sqrt(edgeSum / edgePixels) : 0.0f;
+    }
+};
+
+AntialiasingComparison antialiasingComparison;
+
+//per-frame and per-object shader constants, streamed through a fenced ring of uniform buffer regions
+rg::UniformRing uniformRing;
+
+//lines and points recorded during the frame, drawn in one batch when debug geometry is enabled
+rg::DebugDraw debugDraw;
+
+//point lights binned into view-space clusters every frame, read by the lit shaders through texture buffers
+rg::ClusteredLights clusteredLights;
+
+//directional light shadow cascades with cached static casters
+rg::ShadowCascades shadowCascades;
+
+//static lighting baked at load time, or loaded from its cache file
+rg::LightBaker lightBaker;
+
+//ambient light from the skybox, projected at load time or loaded from its cache file
+rg::SkyIrradiance skyIrradiance;
+//set from ImGui: project the skybox again at every face size and show the times
+bool skyBenchmarkRequested = false;
+std::vector<rg::SkyIrradiance::BenchmarkResult> skyBenchmark;
+
+//specular sky reflections baked at load time, or loaded from their cache file
+rg::SpecularEnvironment specularEnvironment;
+//set from ImGui: bake the environment again and compare it with the one in use
+bool environmentVerifyRequested = false;
+std::string environmentVerifyResult;
+
+//scene reflections captured at run time, the stalest and nearest probe first
+rg::ReflectionProbes reflectionProbes;
+
+//ambient occlusion at a reduced resolution, upsampled in the final composite
+rg::Ssao ssao;
+
+//bloom down and back up a chain of smaller targets
+rg::Bloom bloomChain;
+
+//the frame's passes and their targets, declared again every frame; allocates the transient targets and skips what
+//nothing reads
+rg::RenderGraph renderGraph;
+
+//size of the default framebuffer, kept by the framebuffer size callback, and of the scene targets rendered at the
+//render scale
+int windowWidth = SCR_WIDTH;
+int windowHeight = SCR_HEIGHT;
+int sceneWidth = 0;
+int sceneHeight = 0;
+//render scale that holds the GPU frame time near its target
+rg::DynamicResolution dynamicResolution;
+//sample count of the scene targets, 1 without MSAA, and the texture target that goes with it
+int sceneSamples = 0;
+GLenum sceneTarget = GL_TEXTURE_2D_MULTISAMPLE;
+//memory of the scene colour, bright and depth targets (the render graph's own targets not included)
+size_t sceneTargetBytes = 0;
+//edge smoothing of the tonemapped image for single-sample scene targets
+rg::Fxaa fxaa;
+
+//diffuse light of the ground objects in texture space, shaded again page by page when it goes stale
+rg::ShadingCache shadingCache;
+
+//sky from atmospheric scattering, its tables built on worker threads whenever the sun moves
+rg::Atmosphere atmosphere;
+//the directional light, ambient light, reflections and sky currently come from the atmosphere
+bool atmosphereSun = false;
+
+//set from ImGui: load every scene model again, drop the copies and check that GPU memory returns to where it was
+bool modelReloadCheckRequested = false;
+std::string modelReloadCheckResult;
+
 //TIMING----------------------------------------------------------------------------------------------------------------
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
+rg::CpuTimer opaqueSubmitTimer;
+rg::CpuTimer lightBinningTimer;
+rg::GpuQuery depthPrepassGpuTimer;
+rg::GpuQuery opaqueLitGpuTimer;
+rg::GpuQuery opaqueLitSamples;
+rg::GpuQuery deferredGeometryGpuTimer;
+rg::GpuQuery deferredLightingGpuTimer;
+rg::GpuQuery shadowGpuTimer;
+rg::GpuQuery ssaoGpuTimer;
+rg::GpuQuery shadingCacheGpuTimer;
+rg::GpuQuery skyGpuTimer;
+rg::GpuQuery bloomGpuTimer;
+rg::GpuQuery fxaaGpuTimer;
+rg::FramePacer framePacer;
 
 //LIGHTS----------------------------------------------------------------------------------------------------------------
 struct PointLight {
@@ -148,10 +536,13 @@ int main() {
         return -1;
     }
     glfwMakeContextCurrent(window);
+    glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetKeyCallback(window, key_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
     //tell GLFW to capture our mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
@@ -161,6 +552,7 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    rg::LoadGLExtensions((GLADloadproc) glfwGetProcAddress);
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(true);
@@ -182,6 +574,8 @@ int main() {
 
 //GLOBAL OPENGL STATE---------------------------------------------------------------------------------------------------
     glEnable(GL_DEPTH_TEST);
+    //the prefiltered environment's rough mips are small, their face edges would show without it
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
 //BLENDING--------------------------------------------------------------------------------------------------------------
     glEnable(GL_BLEND);
@@ -192,14 +586,62 @@ int main() {
     glCullFace(GL_FRONT);
     glFrontFace(GL_CW);
 
+//BAKED LIGHT ATTRIBUTE-------------------------------------------------------------------------------------------------
+    //meshes that were not baked do not enable attribute 10 and read this value: no baked light
+    glVertexAttrib4f(10, 0.0f, 0.0f, 0.0f, 0.0f);
+
 //SHADERS---------------------------------------------------------------------------------------------------------------
     Shader modelShader("resources/shaders/model_lighting.vs", "resources/shaders/model_lighting.fs");
     Shader blendingShader("resources/shaders/model_lighting.vs", "resources/shaders/blending.fs" );
     Shader cubemapShader("resources/shaders/cubemaps.vs", "resources/shaders/cubemaps.fs");
     Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
+    Shader atmosphereShader("resources/shaders/atmosphere.vs", "resources/shaders/atmosphere.fs");
     Shader lightShader("resources/shaders/model_lighting.vs", "resources/shaders/lightBullet.fs");
-    Shader blurShader("resources/shaders/blur.vs", "resources/shaders/blur.fs");
+    Shader bloomDownShader("resources/shaders/bloomFinal.vs", "resources/shaders/bloom_down.fs");
+    Shader bloomUpShader("resources/shaders/bloomFinal.vs", "resources/shaders/bloom_up.fs");
     Shader bloomFinalShader("resources/shaders/bloomFinal.vs", "resources/shaders/bloomFinal.fs");
+    Shader instancedShader("resources/shaders/model_lighting_instanced.vs", "resources/shaders/model_lighting.fs");
+    Shader smokeShader("resources/shaders/smoke.vs", "resources/shaders/smoke.fs");
+    Shader debugShader("resources/shaders/debug.vs", "resources/shaders/debug.fs");
+    Shader oitCompositeShader("resources/shaders/bloomFinal.vs", "resources/shaders/oit_composite.fs");
+    Shader depthPrepassShader("resources/shaders/depth_prepass.vs", "resources/shaders/depth_prepass.fs");
+    Shader depthPrepassInstancedShader("resources/shaders/depth_prepass_instanced.vs", "resources/shaders/depth_prepass.fs");
+    Shader shadowShader("resources/shaders/shadow_depth.vs", "resources/shaders/depth_prepass.fs");
+    Shader gBufferShader("resources/shaders/model_lighting.vs", "resources/shaders/gbuffer.fs");
+    Shader gBufferInstancedShader("resources/shaders/model_lighting_instanced.vs", "resources/shaders/gbuffer.fs");
+    Shader deferredGlobalShader("resources/shaders/bloomFinal.vs", "resources/shaders/deferred_global.fs");
+    Shader deferredPointShader("resources/shaders/deferred_point.vs", "resources/shaders/deferred_point.fs");
+    Shader deferredCompositeShader("resources/shaders/bloomFinal.vs", "resources/shaders/deferred_composite.fs");
+    Shader probeShader("resources/shaders/model_lighting.vs", "resources/shaders/probe.fs");
+    Shader ssaoDepthShader("resources/shaders/bloomFinal.vs", "resources/shaders/ssao_depth.fs");
+    Shader ssaoShader("resources/shaders/bloomFinal.vs", "resources/shaders/ssao.fs");
+    Shader ssaoBlurShader("resources/shaders/bloomFinal.vs", "resources/shaders/ssao_blur.fs");
+    Shader shadingCacheShader("resources/shaders/shading_cache.vs", "resources/shaders/shading_cache.fs");
+    Shader cachedShader("resources/shaders/model_cached.vs", "resources/shaders/model_cached.fs");
+    //the shaders that read the scene targets again, for single-sample targets
+    Shader bloomFinalSingleShader("resources/shaders/bloomFinal.vs", "resources/shaders/bloomFinal_single.fs");
+    Shader oitCompositeSingleShader("resources/shaders/bloomFinal.vs", "resources/shaders/oit_composite_single.fs");
+    Shader deferredGlobalSingleShader("resources/shaders/bloomFinal.vs", "resources/shaders/deferred_global_single.fs");
+    Shader deferredPointSingleShader("resources/shaders/deferred_point.vs",
+                                     "resources/shaders/deferred_point_single.fs");
+    Shader deferredCompositeSingleShader("resources/shaders/bloomFinal.vs",
+                                         "resources/shaders/deferred_composite_single.fs");
+    Shader fxaaShader("resources/shaders/bloomFinal.vs", "resources/shaders/fxaa.fs");
+    //the GL 4.3 shaders exist only where the driver can compile them
+    std::unique_ptr<Shader> mdiShader;
+    std::unique_ptr<Shader> depthPrepassMdiShader;
+    std::unique_ptr<Shader> gBufferMdiShader;
+    if (rg::glCaps.multiDrawIndirect) {
+        mdiShader = std::make_unique<Shader>("resources/shaders/model_lighting_mdi.vs",
+                                             "resources/shaders/model_lighting_mdi.fs");
+        depthPrepassMdiShader = std::make_unique<Shader>("resources/shaders/depth_prepass_mdi.vs",
+                                                         "resources/shaders/depth_prepass.fs");
+        gBufferMdiShader = std::make_unique<Shader>("resources/shaders/model_lighting_mdi.vs",
+                                                    "resources/shaders/gbuffer_mdi.fs");
+    }
+    std::unique_ptr<Shader> instanceCullShader;
+    if (rg::glCaps.computeShader)
+        instanceCullShader = std::make_unique<Shader>("resources/shaders/instance_cull.comp");
 
 //MODELS----------------------------------------------------------------------------------------------------------------
     //set stbi false
@@ -207,88 +649,207 @@ int main() {
 
     // grass
     Model grassModel("resources/objects/grass/grass.obj");
-    grassModel.SetShaderTextureNamePrefix("material.");
 
     Model airdefModel("resources/objects/defense/zsu.obj");
-    grassModel.SetShaderTextureNamePrefix("material.");
 
     Model airplane1Model("resources/objects/airplane1/F-16D.obj");
-    airplane1Model.SetShaderTextureNamePrefix("material.");
 
     Model airplane2Model("resources/objects/airplane2/Harrier.obj");
-    airplane2Model.SetShaderTextureNamePrefix("material.");
 
     Model rocketModel("resources/objects/rocket/Missile AIM-120 D [AMRAAM].obj");
-    rocketModel.SetShaderTextureNamePrefix("material.");
 
     Model carModel("resources/objects/cascavel/car.obj");
-    carModel.SetShaderTextureNamePrefix("material.");
 
     Model houseModel("resources/objects/ruins/house.obj");
-    houseModel.SetShaderTextureNamePrefix("material.");
 
     Model tankModel("resources/objects/tank/t90a.obj");
-    houseModel.SetShaderTextureNamePrefix("material.");
 
     Model moonModel("resources/objects/moon/Moon 2K.obj");
-    moonModel.SetShaderTextureNamePrefix("material.");
+
+    std::vector<const Model *> sceneModels = {&grassModel, &airdefModel, &airplane1Model, &airplane2Model, &rocketModel,
+                                             &carModel, &houseModel, &tankModel, &moonModel};
 
     //set stbi true
     stbi_set_flip_vertically_on_load(true);
+
+//STATIC SCENE----------------------------------------------------------------------------------------------------------
+    //grass
+    glm::mat4 modelGrass = glm::mat4(1.0f);
+    modelGrass = glm::translate(modelGrass, glm::vec3(0.0f, -20.0f, 0.0f));
+    float angle1 = 90.0f * 3.14159f / 180.0f;
+    modelGrass = glm::rotate(modelGrass, angle1, glm::vec3(-1.0f, 0.0f, 0.0f)); // rotate
+    modelGrass = glm::scale(modelGrass, glm::vec3(glm::vec3(1.0f)));
+
+    //airplane1
+    glm::mat4 modelf16 = glm::mat4(1.0f);
+    modelf16 = glm::translate(modelf16, glm::vec3(-18, 180.0f, -241.0f));
+    modelf16 = glm::rotate(modelf16, -35.0f * 3.14159f / 160.0f , glm::vec3(0.0f, 0.0f, 1.0f));
+    modelf16 = glm::scale(modelf16, glm::vec3(glm::vec3(4.5f)));
+
+    //rocket
+    glm::mat4 modelRocket = glm::mat4(1.0f);
+    modelRocket = glm::translate(modelRocket, glm::vec3(-20, 181.5f, -80.0f));
+    modelRocket = glm::rotate(modelRocket, (float)glm::radians(-90.0), glm::vec3(0.0f, 0.0f, 1.0f));
+    modelRocket = glm::rotate(modelRocket, (float)glm::radians(90.0), glm::vec3(1.0f, 0.0f, 0.0f));
+    modelRocket = glm::scale(modelRocket, glm::vec3(glm::vec3(0.07f)));
+
+    //airplane2
+    glm::mat4 modelHarrier = glm::mat4(1.0f);
+    modelHarrier = glm::translate(modelHarrier, glm::vec3(-10, 180.0f, 55.0f));
+    modelHarrier = glm::rotate(modelHarrier, -35.0f * 3.14159f / 160.0f , glm::vec3(0.0f, 0.0f, 1.0f));
+    modelHarrier = glm::scale(modelHarrier, glm::vec3(glm::vec3(4.3f)));
+
+    //house
+    glm::mat4 modelRuins = glm::mat4(1.0f);
+    modelRuins = glm::translate(modelRuins, glm::vec3(-39.3, -10.0f, -41.3f));
+    modelRuins = glm::rotate(modelRuins, (float)glm::radians(75.0) , glm::vec3(0.0f, 1.0f, 0.0f));
+    modelRuins = glm::scale(modelRuins, glm::vec3(glm::vec3(10.3f)));
+
+    //tank
+    glm::mat4 modelT90 = glm::mat4(1.0f);
+    modelT90 = glm::translate(modelT90, glm::vec3(96, -17.0f, 6.0f));
+    modelT90 = glm::rotate(modelT90, (float)glm::radians(-93.0) , glm::vec3(0.0f, 1.0f, 0.0f));
+    modelT90 = glm::scale(modelT90, glm::vec3(glm::vec3(6.3f)));
+
+    //armored car
+    glm::mat4 modelCascavel = glm::mat4(1.0f);
+    modelCascavel = glm::translate(modelCascavel, glm::vec3(-71.3, -10.0f, -11.3f));
+    modelCascavel = glm::scale(modelCascavel, glm::vec3(glm::vec3(6.3f)));
+
+    //defense
+    glm::mat4 modelZsu = glm::mat4(1.0f);
+    modelZsu = glm::translate(modelZsu, glm::vec3(115.0f, -14.0f, 34.0f));
+    modelZsu = glm::rotate(modelZsu, (float)glm::radians(-90.0), glm::vec3(0.0f, 1.0, 0.0f));
+    modelZsu = glm::rotate(modelZsu, (float)glm::radians(180.0), glm::vec3(1.0f, 0.0f, 0.0f));
+    modelZsu = glm::scale(modelZsu, glm::vec3(glm::vec3(0.65f)));
+
+    //opaque models that never move, drawn either one mesh at a time or as one multi-draw-indirect batch. Ground
+    //objects are static shadow casters, cached in the cascades, and have baked light; the aircraft are in flight and
+    //cast every frame
+    struct SceneObject {
+        Model *model;
+        glm::mat4 transform;
+        bool staticCaster;
+    };
+    std::vector<SceneObject> staticObjects = {
+            {&grassModel, modelGrass, true},
+            {&airplane1Model, modelf16, false},
+            {&rocketModel, modelRocket, false},
+            {&airplane2Model, modelHarrier, false},
+            {&houseModel, modelRuins, true},
+            {&tankModel, modelT90, true},
+            {&carModel, modelCascavel, true},
+            {&airdefModel, modelZsu, true}
+    };
+
+    //tank army, a 100x100 grid of T-90s behind the scene with slightly different camouflage tints
+    std::vector<InstanceData> tankArmy;
+    for (int row = 0; row < 100; row++) {
+        for (int column = 0; column < 100; column++) {
+            InstanceData tank;
+            tank.model = glm::mat4(1.0f);
+            tank.model = glm::translate(tank.model, glm::vec3(200.0f + column * 12.0f, -17.0f, -1000.0f + row * 22.0f));
+            tank.model = glm::rotate(tank.model, (float)glm::radians(-93.0 + (row * 7 + column * 13) % 11), glm::vec3(0.0f, 1.0f, 0.0f));
+            tank.model = glm::scale(tank.model, glm::vec3(2.0f));
+            float shade = 0.8f + 0.04f * ((row * 31 + column * 17) % 6);
+            tank.tint = glm::vec4(shade, shade + 0.05f * (column % 2), shade * 0.9f, 1.0f);
+            tankArmy.push_back(tank);
+        }
+    }
+    //model space bounds for the debug view, world space ones for culling
+    std::vector<rg::Aabb> staticObjectBounds;
+    std::vector<rg::Aabb> staticObjectWorldBounds;
+    for (const SceneObject &object: staticObjects) {
+        staticObjectBounds.push_back(rg::ModelBounds(*object.model));
+        staticObjectWorldBounds.push_back(staticObjectBounds.back().Transformed(object.transform));
+    }
+    std::vector<bool> staticObjectVisible(staticObjects.size(), true);
+    rg::Aabb casterBounds;
+    for (const rg::Aabb &bounds: staticObjectWorldBounds) {
+        casterBounds.Extend(bounds.minimum);
+        casterBounds.Extend(bounds.maximum);
+    }
+    shadowCascades.Init(casterBounds);
+    rg::Aabb tankBounds = rg::ModelBounds(tankModel);
+
+    rg::InstanceCuller tankArmyCuller;
+    if (rg::glCaps.computeShader)
+        tankArmyCuller.Init(tankModel, tankArmy, *instanceCullShader);
 //HDR/BLOOM-------------------------------------------------------------------------------------------------------------
 
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
+    rg::GpuRef hdrFBO(rg::GPU_FRAMEBUFFER);
     glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++){
-        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, colorBuffers[i]);
-        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, GL_TRUE);
-        glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D_MULTISAMPLE, colorBuffers[i], 0);
-    }
-
-    unsigned int textureColorBufferMultiSampled;
-    glGenTextures(1, &textureColorBufferMultiSampled);
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled);
-    glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_RGB, SCR_WIDTH, SCR_HEIGHT, GL_TRUE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled, 0);
-
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
+    rg::GpuRef colorBuffers[2];
+
+    rg::GpuRef rboDepth(rg::GPU_RENDERBUFFER);
     glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+
+    //storage of the scene targets at the render size and sample count; on a resize the depth buffer stays, so every
+    //framebuffer that shares it stays attached, and the targets that copy the scene at its size are built again. A
+    //texture's target is fixed when it is first bound, so the colour textures are made anew when the sample count
+    //changes between multisampled and single-sample. The render graph's targets are declared at the new size, so its
+    //pool is dropped
+    auto resizeSceneTargets = [&](int width, int height, int samples) {
+        bool newTextures = samples != sceneSamples;
+        sceneWidth = width;
+        sceneHeight = height;
+        sceneSamples = samples;
+        sceneTarget = rg::RenderTargetDesc(width, height, GL_RGBA16F, samples, 8).Target();
+        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+        for (unsigned int i = 0; i < 2; i++) {
+            if (newTextures)
+                colorBuffers[i] = rg::GpuRef(rg::GPU_TEXTURE);
+            glBindTexture(sceneTarget, colorBuffers[i]);
+            if (samples > 1) {
+                glTexImage2DMultisample(sceneTarget, samples, GL_RGBA16F, width, height, GL_TRUE);
+            } else {
+                glTexImage2D(sceneTarget, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+                glTexParameteri(sceneTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(sceneTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(sceneTarget, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(sceneTarget, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            }
+            colorBuffers[i].SetBytes(rg::TextureBytes(width, height, 8, samples));
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, sceneTarget, colorBuffers[i], 0);
+        }
+        glBindTexture(sceneTarget, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        //0 samples is a plain single-sample renderbuffer
+        glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples > 1 ? samples : 0, GL_DEPTH_COMPONENT, width,
+                                         height);
+        rboDepth.SetBytes(rg::TextureBytes(width, height, 4, samples));
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        sceneTargetBytes = rg::TextureBytes(width, height, 2 * 8 + 4, samples);
+
+        //ambient occlusion, from a single-sample copy of the scene depth
+        ssao.Init(width, height, rboDepth);
+        //bloom chain, from a single-sample copy of the bright target
+        bloomChain.Init(width, height, sceneTarget, colorBuffers[1]);
+        renderGraph.ReleaseTargets();
+    };
+    resizeSceneTargets(windowWidth, windowHeight, SCENE_MSAA_SAMPLES);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
     //which color attachment we'll use for rendering
-    unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-    glDrawBuffers(3, attachments);
+    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
     //is framebuffer complete?
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "Framebuffer not complete!" << std::endl;
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    // ping-pong-framebuffer for blurring
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++){
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, pingpongColorbuffers[i]);
-        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, GL_TRUE);
-        glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, pingpongColorbuffers[i], 0);
-        //are framebuffers complete?
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
-    }
+    //transparency targets, sharing the scene depth buffer; the accumulation textures come from the render graph
+    rg::WeightedOIT oit;
+    oit.Init(rboDepth);
+
+    //G-buffer and light sum of the deferred path, also on the scene depth buffer and from the render graph
+    rg::DeferredShading deferredShading;
+    deferredShading.Init(rboDepth);
+
+    //framebuffer of the LDR image FXAA reads, the target itself from the render graph
+    fxaa.Init();
 
 //B nesto---------------------------------------------------------------------------------------------------------------
 
@@ -383,12 +944,11 @@ int main() {
             1.0f, -1.0f,  1.0f
     };
 
-    unsigned int skyboxVAO, skyboxVBO;
-    glGenVertexArrays(1, &skyboxVAO);
-    glGenBuffers(1, &skyboxVBO);
+    rg::GpuRef skyboxVAO(rg::GPU_VERTEX_ARRAY), skyboxVBO(rg::GPU_BUFFER);
     glBindVertexArray(skyboxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
+    skyboxVBO.SetBytes(sizeof(skyboxVertices));
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
@@ -401,235 +961,947 @@ int main() {
                     FileSystem::getPath("resources/textures/skybox/front.tga"),
                     FileSystem::getPath("resources/textures/skybox/back.tga")
             };
-    unsigned int cubemapTexture = loadCubemap(faces);
+    rg::GpuRef cubemapTexture = loadCubemap(faces);
+    skyIrradiance.Init(cubemapTexture, faces, FileSystem::getPath("resources/textures/skybox/irradiance_sh.bin"));
+    skyIrradiance.Bind();
+    specularEnvironment.Init(cubemapTexture, faces, rg::SpecularEnvironment::Settings(),
+                             FileSystem::getPath("resources/textures/skybox/specular_environment.bin"));
+    //one probe over the battlefield and one among the aircraft; the moon is the only thing they see move
+    reflectionProbes.Init();
+    reflectionProbes.Add(glm::vec3(20.0f, 0.0f, 0.0f), 160.0f);
+    reflectionProbes.Add(glm::vec3(-15.0f, 195.0f, -90.0f), 200.0f);
+    float moonRadius = rg::ModelBounds(moonModel).Radius();
+    atmosphere.Init();
 
 //SHADERS CONFIGURATION-------------------------------------------------------------------------------------------------
+    //per-frame, per-object and post-processing constants all come from uniform buffer ranges
+    std::vector<Shader *> shaders = {&modelShader, &blendingShader, &cubemapShader, &skyboxShader, &lightShader,
+                                     &bloomDownShader, &bloomUpShader, &bloomFinalShader, &instancedShader, &depthPrepassShader,
+                                     &depthPrepassInstancedShader, &smokeShader, &oitCompositeShader,
+                                     &debugShader, &gBufferShader, &gBufferInstancedShader, &deferredGlobalShader,
+                                     &deferredPointShader, &deferredCompositeShader, &shadowShader, &probeShader,
+                                     &ssaoDepthShader, &ssaoShader, &ssaoBlurShader, &shadingCacheShader,
+                                     &cachedShader, &atmosphereShader, &bloomFinalSingleShader,
+                                     &oitCompositeSingleShader, &deferredGlobalSingleShader, &deferredPointSingleShader,
+                                     &deferredCompositeSingleShader, &fxaaShader};
+    if (mdiShader) {
+        shaders.push_back(mdiShader.get());
+        shaders.push_back(depthPrepassMdiShader.get());
+        shaders.push_back(gBufferMdiShader.get());
+    }
+    if (instanceCullShader)
+        shaders.push_back(instanceCullShader.get());
+    for (Shader *shader: shaders) {
+        shader->setBlockBinding("FrameBlock", rg::FRAME_BLOCK);
+        shader->setBlockBinding("ObjectBlock", rg::OBJECT_BLOCK);
+        shader->setBlockBinding("PostBlock", rg::POST_BLOCK);
+        shader->setBlockBinding("SkyBlock", rg::SKY_BLOCK);
+        shader->setBlockBinding("ShadowBlock", rg::SHADOW_BLOCK);
+    }
+
+    //samplers of the model shaders point at the fixed material texture units once, meshes only bind textures
+    rg::SetMaterialSamplers(modelShader, "material.");
+    rg::SetMaterialSamplers(blendingShader, "material.");
+    rg::SetMaterialSamplers(instancedShader, "material.");
+    rg::ClusteredLights::SetSamplers(modelShader);
+    rg::ClusteredLights::SetSamplers(instancedShader);
+    rg::ClusteredLights::SetSamplers(shadingCacheShader);
+    rg::ClusteredLights::SetSamplers(cachedShader);
+    if (mdiShader)
+        rg::ClusteredLights::SetSamplers(*mdiShader);
+    rg::SetMaterialSamplers(gBufferShader, "material.");
+    rg::SetMaterialSamplers(gBufferInstancedShader, "material.");
+    rg::SetMaterialSamplers(probeShader, "material.");
+    rg::SetMaterialSamplers(cachedShader, "material.");
+    rg::ShadingCache::SetSamplers(cachedShader);
+    for (Shader *shader: {&deferredGlobalShader, &deferredPointShader, &deferredCompositeShader,
+                          &deferredGlobalSingleShader, &deferredPointSingleShader, &deferredCompositeSingleShader}) {
+        rg::ClusteredLights::SetSamplers(*shader);
+        rg::DeferredShading::SetSamplers(*shader);
+    }
+    for (Shader *shader: {&modelShader, &instancedShader, &deferredGlobalShader, &deferredPointShader,
+                          &deferredCompositeShader, &deferredGlobalSingleShader, &deferredPointSingleShader,
+                          &deferredCompositeSingleShader, &shadingCacheShader, &cachedShader})
+        rg::ShadowCascades::SetSamplers(*shader);
+    if (mdiShader)
+        rg::ShadowCascades::SetSamplers(*mdiShader);
+    for (Shader *shader: {&modelShader, &instancedShader, &deferredGlobalShader, &deferredPointShader,
+                          &deferredCompositeShader, &deferredGlobalSingleShader, &deferredPointSingleShader,
+                          &deferredCompositeSingleShader, &shadingCacheShader, &cachedShader}) {
+        rg::SpecularEnvironment::SetSamplers(*shader);
+        rg::ReflectionProbes::SetSamplers(*shader);
+    }
+    if (mdiShader) {
+        rg::SpecularEnvironment::SetSamplers(*mdiShader);
+        rg::ReflectionProbes::SetSamplers(*mdiShader);
+    }
+
     cubemapShader.use();
     cubemapShader.setInt("texture1", 0);
     blendingShader.use();
     blendingShader.setInt("texture1", 0);
+    blendingShader.setFloat("material.shininess", 32.0f);
+    blendingShader.setVec3("dirLight.direction", glm::vec3(-0.547f, -0.727f, 0.415f));
+    blendingShader.setVec3("dirLight.ambient", glm::vec3(0.35f));
+    blendingShader.setVec3("dirLight.diffuse", glm::vec3(0.4f));
+    blendingShader.setVec3("dirLight.specular", glm::vec3(0.2f));
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
+    rg::Atmosphere::SetSamplers(atmosphereShader);
+    for (Shader *shader: {&oitCompositeShader, &oitCompositeSingleShader}) {
+        shader->use();
+        shader->setInt("accumTexture", 0);
+        shader->setInt("weightTexture", 1);
+    }
     lightShader.use();
-    blurShader.use();
-    blurShader.setInt("image", 0);
-    bloomFinalShader.use();
-    bloomFinalShader.setInt("scene", 0);
-    bloomFinalShader.setInt("bloomBlur", 1);
+    for (Shader *shader: {&bloomDownShader, &bloomUpShader})
+        rg::Bloom::SetSamplers(*shader);
+    for (Shader *shader: {&bloomFinalShader, &bloomFinalSingleShader}) {
+        shader->use();
+        shader->setInt("scene", 0);
+        shader->setInt("bloomBlur", 1);
+    }
+    for (Shader *shader: {&bloomFinalShader, &bloomFinalSingleShader, &ssaoDepthShader, &ssaoShader, &ssaoBlurShader})
+        rg::Ssao::SetSamplers(*shader);
+    rg::Fxaa::SetSamplers(fxaaShader);
+    if (mdiShader) {
+        mdiShader->use();
+        mdiShader->setInt("materialTextures", 0);
+        gBufferMdiShader->use();
+        gBufferMdiShader->setInt("materialTextures", 0);
+    }
 
     //draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+//CONSTANT BUFFERS------------------------------------------------------------------------------------------------------
+    //worst case of one frame: an object block per static object in every pass that can draw them all (each shadow
+    //cascade, depth pre-pass, lit pass or G-buffer, shading cache update and every reflection probe step), the moon
+    //and the light bullets, the frame blocks of the camera and the probe steps, the cascade blocks and the post blocks
+    size_t objectPasses = rg::SHADOW_CASCADES + 3 + rg::ReflectionProbes::STEPS;
+    size_t objectBlocks = staticObjects.size() * objectPasses + 2 + rg::ReflectionProbes::STEPS +
+                          pointLightPositions.size();
+    uniformRing.Init(rg::UniformRing::BlockBytes<rg::ObjectConstants>(objectBlocks) +
+                     rg::UniformRing::BlockBytes<rg::FrameConstants>(1 + rg::ReflectionProbes::STEPS) +
+                     rg::UniformRing::BlockBytes<rg::ShadowConstants>(rg::SHADOW_CASCADES) +
+                     rg::UniformRing::BlockBytes<rg::PostConstants>(2));
+
+    //lights never change, only the camera part of the frame constants is updated every frame
+    rg::FrameConstants frameConstants = {};
+    frameConstants.shininess = 16.0f;
+    frameConstants.directional.direction = directional.direction;
+    frameConstants.directional.ambient = directional.ambient;
+    frameConstants.directional.diffuse = directional.diffuse;
+    frameConstants.directional.specular = directional.specular;
+    frameConstants.spotlight.ambient = spotlight.ambient;
+    frameConstants.spotlight.diffuse = spotlight.diffuse;
+    frameConstants.spotlight.cutOff = spotlight.cutOff;
+    frameConstants.spotlight.outerCutOff = spotlight.outerCutOff;
+
+    //point lights are binned into clusters every frame: the fixed bullet lights first, then the dynamic ones
+    std::vector<rg::PointLightConstants> staticPointLights;
+    for (unsigned int i = 0; i < pointLightPositions.size(); i++) {
+        rg::PointLightConstants light = {};
+        light.position = pointLightPositions[i];
+        light.ambient = pointLights.ambient * 1.0f;
+        light.diffuse = pointLights.diffuse * 0.05f;
+        light.specular = pointLights.specular * 0.01f;
+        light.radius = rg::PointLightRange(light);
+        staticPointLights.push_back(light);
+    }
+    std::vector<rg::PointLightConstants> frameLights;
+    clusteredLights.Init();
+
+//LIGHT BAKING----------------------------------------------------------------------------------------------------------
+    //the ground objects and the bullet lights never move, so the bullet lights and the first bounce of every static
+    //light are baked into the ground objects' vertices. The bullet lights come first in the cluster light list, the
+    //lit shaders skip them on baked surfaces. The batch is built afterwards so it picks the baked light up.
+    for (const SceneObject &object: staticObjects) {
+        if (object.staticCaster)
+            lightBaker.Add(*object.model, object.transform);
+    }
+    lightBaker.Bake(frameConstants.directional, staticPointLights, rg::LightBaker::Settings(),
+                    "resources/baked_lighting.bin");
+    frameConstants.bakedPointLights = staticPointLights.size();
+
+    //the same ground objects keep their diffuse light in the shading cache, built after the bake to carry its light
+    for (unsigned int i = 0; i < staticObjects.size(); i++) {
+        if (staticObjects[i].staticCaster)
+            shadingCache.Add(i, *staticObjects[i].model, staticObjects[i].transform);
+    }
+
+    //built the first time multi-draw indirect is turned on
+    rg::StaticBatch staticBatch;
+    if (rg::glCaps.multiDrawIndirect) {
+        for (const SceneObject &object: staticObjects)
+            staticBatch.Add(*object.model, object.transform);
+    }
+
+    std::vector<rg::ObjectConstants> staticObjectConstants;
+    for (const SceneObject &object: staticObjects)
+        staticObjectConstants.push_back(rg::ObjectConstants::From(object.transform));
+
+    std::vector<rg::ObjectConstants> lightBulletConstants;
+    for (unsigned int i = 0; i < 18; i++) {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, pointLightPositions[i]);
+        model = glm::scale(model, glm::vec3(0.45f)); // Make it a smaller cube
+        lightBulletConstants.push_back(rg::ObjectConstants::From(model, glm::vec4(0.2f, 0.0f, 0.0f, 1.0f)));
+    }
+
+    depthPrepassGpuTimer.Init(GL_TIME_ELAPSED);
+    opaqueLitGpuTimer.Init(GL_TIME_ELAPSED);
+    opaqueLitSamples.Init(GL_SAMPLES_PASSED);
+    deferredGeometryGpuTimer.Init(GL_TIME_ELAPSED);
+    deferredLightingGpuTimer.Init(GL_TIME_ELAPSED);
+    shadowGpuTimer.Init(GL_TIME_ELAPSED);
+    ssaoGpuTimer.Init(GL_TIME_ELAPSED);
+    shadingCacheGpuTimer.Init(GL_TIME_ELAPSED);
+    skyGpuTimer.Init(GL_TIME_ELAPSED);
+    bloomGpuTimer.Init(GL_TIME_ELAPSED);
+    fxaaGpuTimer.Init(GL_TIME_ELAPSED);
+
+    //static models (one mesh at a time or one multi-draw-indirect batch) and the instanced tank army, drawn with
+    //either the depth pre-pass shaders or the lit ones; the tank instances are uploaded by the first pass of a frame.
+    //With several views only the per-draw path is multi-view aware: every draw is instanced once per view. When
+    //cachedPassShader is set the objects in the shading cache are drawn with it, after the others.
+    auto drawOpaque = [&](Shader &perDrawPassShader, Shader *mdiPassShader, Shader &instancedPassShader,
+                          bool uploadInstances, Shader *cachedPassShader) {
+        int viewCount = frameConstants.viewCount;
+        unsigned int drawCallsBefore = rg::frameStats.drawCalls;
+        if (renderSettings.multiDrawIndirect && viewCount == 1) {
+            mdiPassShader->use();
+            staticBatch.Draw(*mdiPassShader);
+        } else {
+            perDrawPassShader.use();
+            for (unsigned int i = 0; i < staticObjects.size(); i++) {
+                if (!staticObjectVisible[i] || (cachedPassShader && shadingCache.Contains(i)))
+                    continue;
+                uniformRing.PushAndBind(rg::OBJECT_BLOCK, staticObjectConstants[i]);
+                if (viewCount > 1)
+                    staticObjects[i].model->DrawInstanced(perDrawPassShader, viewCount);
+                else
+                    staticObjects[i].model->Draw(perDrawPassShader);
+            }
+            if (cachedPassShader) {
+                cachedPassShader->use();
+                for (unsigned int i = 0; i < staticObjects.size(); i++) {
+                    if (staticObjectVisible[i] && shadingCache.Contains(i))
+                        shadingCache.Draw(i, uniformRing);
+                }
+            }
+        }
+        rg::frameStats.opaqueDrawCalls = rg::frameStats.drawCalls - drawCallsBefore;
+
+        if (renderSettings.tankArmy && viewCount == 1) {
+            drawCallsBefore = rg::frameStats.drawCalls;
+            instancedPassShader.use();
+            if (renderSettings.gpuCulling)
+                tankArmyCuller.Draw(instancedPassShader);
+            else if (uploadInstances)
+                tankModel.DrawInstanced(instancedPassShader, tankArmy.data(), renderSettings.tankArmySize);
+            else
+                tankModel.DrawInstanced(instancedPassShader, renderSettings.tankArmySize);
+            rg::frameStats.instancedDrawCalls = rg::frameStats.drawCalls - drawCallsBefore;
+        }
+    };
+
+    //shadow casters with the shadow shader, either the cached static ones or the ones drawn every frame
+    auto drawShadowCasters = [&](bool staticCasters) {
+        for (unsigned int i = 0; i < staticObjects.size(); i++) {
+            if (staticObjects[i].staticCaster != staticCasters)
+                continue;
+            uniformRing.PushAndBind(rg::OBJECT_BLOCK, staticObjectConstants[i]);
+            staticObjects[i].model->Draw(shadowShader);
+        }
+    };
+
+    //gunner sight of the T-90, looking down the barrel towards the ruins
+    glm::vec3 gunnerPosition = glm::vec3(96.0f, 5.0f, 6.0f);
+    glm::vec3 gunnerForward = glm::vec3(glm::rotate(glm::mat4(1.0f), (float)glm::radians(-93.0), glm::vec3(0.0f, 1.0f, 0.0f)) * glm::vec4(0.0f, 0.0f, 1.0f, 0.0f));
+    glm::mat4 gunnerView = glm::lookAt(gunnerPosition, gunnerPosition + gunnerForward, glm::vec3(0.0f, 1.0f, 0.0f));
+
+    debugDraw.Init();
+    glm::mat4 frozenViewProjection = glm::mat4(1.0f);
+    bool frustumFrozen = false;
+
+    rg::SmokeColumn smokeColumns[2];
+    smokeColumns[0].Init(glm::vec3(-39.3f, -10.0f, -41.3f), 120, 90.0f);
+    smokeColumns[1].Init(glm::vec3(96.0f, -12.0f, 6.0f), 80, 60.0f);
+
 //RENDER LOOP-----------------------------------------------------------------------------------------------------------
+    glm::vec3 lastCameraPosition = programState->camera.Position;
+    float lastExposure = exposure;
+    //what the shading cache's light depends on when it was last used; a change makes every page stale
+    glm::vec3 shadingCacheLightingKey(-1.0f);
+    //pages this close to the camera are kept fresh even when out of view, so turning around finds them shaded
+    const float SHADING_CACHE_NEAR_DISTANCE = 30.0f;
     while (!glfwWindowShouldClose(window)) {
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        //the anti-aliasing comparison renders one instant in every mode, and the camera must not move in between
+        if (antialiasingComparison.running) {
+            currentFrame = antialiasingComparison.time;
+            deltaTime = 0.0f;
+        }
 
         processInput(window);
+        if (lightScalingSweep.running) {
+            lightScalingSweep.Apply(renderSettings);
+            framePacer.MarkDirty();
+        }
+        if (antialiasingComparison.running) {
+            antialiasingComparison.Apply(renderSettings);
+            framePacer.MarkDirty();
+        }
+
+        //held keys move the camera or change the exposure without new events, so compare against the last frame
+        if (programState->camera.Position != lastCameraPosition || exposure != lastExposure ||
+            !renderSettings.onDemand)
+            framePacer.MarkDirty();
+        lastCameraPosition = programState->camera.Position;
+        lastExposure = exposure;
+        if (!framePacer.BeginFrame(currentFrame)) {
+            framePacer.Wait(currentFrame);
+            //time spent waiting must not turn into camera movement
+            lastFrame = glfwGetTime();
+            continue;
+        }
+
+        rg::frameStats.Reset();
+        uniformRing.BeginFrame();
+        if (renderSettings.multiDrawIndirect && !staticBatch.Built())
+            staticBatch.Build();
 
         //render
 //        glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
 //        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        //render size: the dynamic resolution scale follows the GPU time of the frames before, and the scene targets
+        //follow the render size and the sample count of the anti-aliasing mode
+        if (renderSettings.dynamicResolution &&
+            dynamicResolution.Update(renderGraph.FrameMilliseconds(), renderSettings.resolution))
+            framePacer.MarkDirty();
+        float renderScale = renderSettings.dynamicResolution ? dynamicResolution.Scale() : renderSettings.renderScale;
+        int renderWidth = std::max(1, (int) (windowWidth * renderScale + 0.5f));
+        int renderHeight = std::max(1, (int) (windowHeight * renderScale + 0.5f));
+        int renderSamples = renderSettings.antialiasing == ANTIALIASING_MSAA ? SCENE_MSAA_SAMPLES : 1;
+        if (renderWidth != sceneWidth || renderHeight != sceneHeight || renderSamples != sceneSamples)
+            resizeSceneTargets(renderWidth, renderHeight, renderSamples);
+        //single-sample scene targets are read by the _single variants of the shaders that resolve them
+        bool multisampled = sceneSamples > 1;
+        bool fxaaFrame = renderSettings.antialiasing == ANTIALIASING_FXAA;
+
+        //view/projection transformations; in split screen every view gets a vertical strip of the target
+        int viewCount = renderSettings.splitScreen ? 2 : 1;
+        float viewAspect = (float) windowWidth / viewCount / (float) windowHeight;
+        const float farPlane = 700.0f;
+        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom), viewAspect, 0.1f, farPlane);
+        glm::mat4 view = programState->camera.GetViewMatrix();
 
-        //don't forget to enable shader before setting uniforms
-        modelShader.use();
+        //per-frame constants, shared by every shader through FrameBlock
+        frameConstants.projection = projection;
+        frameConstants.view = view;
+        frameConstants.viewPos = programState->camera.Position;
+        frameConstants.blinn = blinn;
+        frameConstants.spotlight.position = programState->camera.Position;
+        frameConstants.spotlight.direction = programState->camera.Front;
+        frameConstants.viewCount = viewCount;
+        frameConstants.bakedLighting = renderSettings.bakedLighting;
+        frameConstants.skyAmbient = renderSettings.skyAmbient ? renderSettings.skyAmbientStrength : 0.0f;
+        frameConstants.environmentStrength =
+                renderSettings.environmentReflections ? renderSettings.environmentStrength : 0.0f;
+        frameConstants.environmentMaxLod = specularEnvironment.Levels() - 1;
+        frameConstants.SetView(0, viewCount, view, projection, programState->camera.Position);
+        if (viewCount > 1)
+            frameConstants.SetView(1, viewCount, gunnerView,
+                                   glm::perspective(glm::radians(30.0f), viewAspect, 0.1f, farPlane), gunnerPosition);
+
+        //the atmosphere's sun replaces the directional light once its first build is in, dimmed by the air it crosses,
+        //and the ambient light by the sky's brightness; whatever the sun lit goes stale. Turning it off restores the
+        //skybox's light
+        if (renderSettings.atmosphere) {
+            rg::Atmosphere::Parameters sky;
+            sky.sunElevation = renderSettings.sunElevation;
+            sky.sunAzimuth = renderSettings.sunAzimuth;
+            sky.turbidity = renderSettings.turbidity;
+            if (atmosphere.Update(sky, skyIrradiance, specularEnvironment) || (!atmosphereSun && atmosphere.Ready())) {
+                frameConstants.directional.direction = -atmosphere.SunDirection();
+                frameConstants.directional.ambient = directional.ambient * atmosphere.SkyBrightness();
+                frameConstants.directional.diffuse = directional.diffuse * atmosphere.SunColor();
+                frameConstants.directional.specular = directional.specular * atmosphere.SunColor();
+                atmosphere.SetFrameConstants(frameConstants);
+                atmosphereSun = true;
+                shadowCascades.Invalidate();
+                reflectionProbes.Invalidate();
+                shadingCache.Invalidate();
+            }
+        } else if (atmosphereSun) {
+            frameConstants.directional.direction = directional.direction;
+            frameConstants.directional.ambient = directional.ambient;
+            frameConstants.directional.diffuse = directional.diffuse;
+            frameConstants.directional.specular = directional.specular;
+            skyIrradiance.Reset();
+            specularEnvironment.Reset();
+            atmosphere.Suspend();
+            atmosphereSun = false;
+            shadowCascades.Invalidate();
+            reflectionProbes.Invalidate();
+            shadingCache.Invalidate();
+        }
 
-        //view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 700.0f);
-        glm::mat4 view = programState->camera.GetViewMatrix();
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
-        modelShader.setFloat("material.shininess", 16.0f);
-
-        //Directional light
-        modelShader.setVec3("directional.direction", directional.direction);
-        modelShader.setVec3("directional.ambient", directional.ambient);
-        modelShader.setVec3("directional.diffuse", directional.diffuse);
-        modelShader.setVec3("directional.specular", directional.specular);
-
-        //Point Lights
-        for(unsigned int i = 0; i < pointLightPositions.size(); i++){
-            modelShader.setVec3("pointlight[" + std::to_string(i) + "].position", pointLightPositions[i]);
-            modelShader.setVec3("pointlight[" + std::to_string(i) + "].ambient", pointLights.ambient * 1.0f);
-            modelShader.setVec3("pointlight[" + std::to_string(i) + "].diffuse", pointLights.diffuse * 0.05f);
-            modelShader.setVec3("pointlight[" + std::to_string(i) + "].specular", pointLights.specular * 0.01f);
-        }
-
-        //Spotlight
-        modelShader.setVec3("spotlight.position", programState->camera.Position);
-        modelShader.setVec3("spotlight.direction", programState->camera.Front);
-        modelShader.setVec3("spotlight.ambient", spotlight.ambient);
-        modelShader.setVec3("spotlight.diffuse", spotlight.diffuse);
-        modelShader.setFloat("spotlight.cutOff", spotlight.cutOff);
-        modelShader.setFloat("spotlight.outerCutOff", spotlight.outerCutOff);
-        modelShader.setBool("blinn", blinn);
-
-//      light bullets
-        glm::mat4 model = glm::mat4(1.0f);
-        lightShader.setMat4("projection", projection);
-        lightShader.setMat4("view", view);
-        for (unsigned int i = 0; i < 18; i++)
-        {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, pointLightPositions[i]);
-            model = glm::scale(model, glm::vec3(0.45f)); // Make it a smaller cube
-            lightShader.setMat4("model", model);
-            lightShader.setVec3("lightColor",glm::vec3(0.2f, 0.0f, 0.0f));
-            renderCube();
-        }
-
-        //render grass
-        glm::mat4 modelGrass = glm::mat4(1.0f);
-        modelGrass = glm::translate(modelGrass, glm::vec3(0.0f, -20.0f, 0.0f));
-        float angle1 = 90.0f * 3.14159f / 180.0f;
-        modelGrass = glm::rotate(modelGrass, angle1, glm::vec3(-1.0f, 0.0f, 0.0f)); // rotate
-        modelGrass = glm::scale(modelGrass, glm::vec3(glm::vec3(1.0f)));
-        modelShader.setMat4("model", modelGrass);
-        grassModel.Draw(modelShader);
-
-        //render airplane1
-        glm::mat4 modelf16 = glm::mat4(1.0f);
-        modelf16 = glm::translate(modelf16, glm::vec3(-18, 180.0f, -241.0f));
-        modelf16 = glm::rotate(modelf16, -35.0f * 3.14159f / 160.0f , glm::vec3(0.0f, 0.0f, 1.0f));
-        modelf16 = glm::scale(modelf16, glm::vec3(glm::vec3(4.5f)));
-        modelShader.setMat4("model", modelf16);
-        airplane1Model.Draw(modelShader);
-
-        //render rocket
-        glm::mat4 modelRocket = glm::mat4(1.0f);
-        modelRocket = glm::translate(modelRocket, glm::vec3(-20, 181.5f, -80.0f));
-        modelRocket = glm::rotate(modelRocket, (float)glm::radians(-90.0), glm::vec3(0.0f, 0.0f, 1.0f));
-        modelRocket = glm::rotate(modelRocket, (float)glm::radians(90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        modelRocket = glm::scale(modelRocket, glm::vec3(glm::vec3(0.07f)));
-        modelShader.setMat4("model", modelRocket);
-        rocketModel.Draw(modelShader);
-
-        //render airplane2
-        glm::mat4 modelHarrier = glm::mat4(1.0f);
-        modelHarrier = glm::translate(modelHarrier, glm::vec3(-10, 180.0f, 55.0f));
-        modelHarrier = glm::rotate(modelHarrier, -35.0f * 3.14159f / 160.0f , glm::vec3(0.0f, 0.0f, 1.0f));
-        modelHarrier = glm::scale(modelHarrier, glm::vec3(glm::vec3(4.3f)));
-        modelShader.setMat4("model", modelHarrier);
-        airplane2Model.Draw(modelShader);
-
-        //render house
-        glm::mat4 modelRuins = glm::mat4(1.0f);
-        modelRuins = glm::translate(modelRuins, glm::vec3(-39.3, -10.0f, -41.3f));
-        modelRuins = glm::rotate(modelRuins, (float)glm::radians(75.0) , glm::vec3(0.0f, 1.0f, 0.0f));
-        modelRuins = glm::scale(modelRuins, glm::vec3(glm::vec3(10.3f)));
-        modelShader.setMat4("model", modelRuins);
-        houseModel.Draw(modelShader);
-
-        //render tank
-        glm::mat4 modelT90 = glm::mat4(1.0f);
-        modelT90 = glm::translate(modelT90, glm::vec3(96, -17.0f, 6.0f));
-        modelT90 = glm::rotate(modelT90, (float)glm::radians(-93.0) , glm::vec3(0.0f, 1.0f, 0.0f));
-        modelT90 = glm::scale(modelT90, glm::vec3(glm::vec3(6.3f)));
-        modelShader.setMat4("model", modelT90);
-        tankModel.Draw(modelShader);
-
-        //render armored car
-        glm::mat4 modelCascavel = glm::mat4(1.0f);
-        modelCascavel = glm::translate(modelCascavel, glm::vec3(-71.3, -10.0f, -11.3f));
-        modelCascavel = glm::scale(modelCascavel, glm::vec3(glm::vec3(6.3f)));
-        modelShader.setMat4("model", modelCascavel);
-        carModel.Draw(modelShader);
-
-        //reder defense
-        glm::mat4 modelZsu = glm::mat4(1.0f);
-        modelZsu = glm::translate(modelZsu, glm::vec3(115.0f, -14.0f, 34.0f));
-        modelZsu = glm::rotate(modelZsu, (float)glm::radians(-90.0), glm::vec3(0.0f, 1.0, 0.0f));
-       modelZsu = glm::rotate(modelZsu, (float)glm::radians(180.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        modelZsu = glm::scale(modelZsu, glm::vec3(glm::vec3(0.65f)));
-        modelShader.setMat4("model", modelZsu);
-        airdefModel.Draw(modelShader);
-
-        //blending
-        blendingShader.use();
-        blendingShader.setVec3("viewPosition", programState->camera.Position);
-        blendingShader.setFloat("material.shininess", 32.0f);
-        blendingShader.setMat4("projection", projection);
-        blendingShader.setMat4("view", view);
-        blendingShader.setVec3("dirLight.direction", glm::vec3(-0.547f, -0.727f, 0.415f));
-        blendingShader.setVec3("dirLight.ambient", glm::vec3(0.35f));
-        blendingShader.setVec3("dirLight.diffuse", glm::vec3(0.4f));
-        blendingShader.setVec3("dirLight.specular", glm::vec3(0.2f));
-
-        //render moon
+        //bin this frame's point lights into the clusters of every view; fills the cluster part of the frame constants
+        lightBinningTimer.Begin();
+        frameLights.assign(staticPointLights.begin(), staticPointLights.end());
+        if (renderSettings.tracerLights) {
+            appendTracerLights(frameLights, renderSettings.tracerLightCount, currentFrame);
+            framePacer.RequestAnimation(renderSettings.animationRate);
+        }
+        clusteredLights.Build(frameLights, frameConstants, farPlane);
+        clusteredLights.Bind();
+        lightBinningTimer.End();
+
+        //shadow cascades fitted to the main camera, also for the gunner view
+        if (renderSettings.shadows)
+            shadowCascades.Fit(programState->camera.Position, programState->camera.Front,
+                               glm::radians(programState->camera.Zoom), viewAspect, 0.1f,
+                               renderSettings.shadowDistance, frameConstants.directional.direction, frameConstants);
+        else
+            frameConstants.shadowSplits.w = 0.0f;
+        if (renderSettings.reflectionProbes)
+            reflectionProbes.Select(programState->camera.Position, frameConstants);
+        else
+            frameConstants.reflectionProbe = glm::vec4(0.0f);
+        GLintptr frameOffset = uniformRing.Push(frameConstants);
+        uniformRing.BindRange(rg::FRAME_BLOCK, frameOffset, sizeof(frameConstants));
+
+        //cull static objects once against every view; a draw goes to all views when any of them sees it
+        rg::Frustum viewFrusta[rg::MAX_VIEWS];
+        for (int v = 0; v < viewCount; v++)
+            viewFrusta[v] = rg::Frustum(frameConstants.projections[v] * frameConstants.views[v]);
+        for (unsigned int i = 0; i < staticObjects.size(); i++) {
+            bool visible = false;
+            for (int v = 0; v < viewCount && !visible; v++)
+                visible = viewFrusta[v].IntersectsSphere(staticObjectWorldBounds[i].Center(), staticObjectWorldBounds[i].Radius());
+            staticObjectVisible[i] = visible;
+            rg::frameStats.culledObjects += !visible;
+        }
+
+        //the frame as a render graph: targets owned elsewhere are imported, the per-frame ones are created and
+        //allocated by the graph. A pass whose writes nothing reads is culled, so disabled features only stop reading
+        typedef rg::RenderGraph::Resource Resource;
+        renderGraph.Reset();
+        Resource shadowMaps = renderGraph.Import("Shadow cascades");
+        Resource probeCubemaps = renderGraph.Import("Reflection probes");
+        Resource shadingAtlas = renderGraph.Import("Shading atlas");
+        Resource tankInstances = renderGraph.Import("Visible tanks");
+        Resource sceneColor = renderGraph.Import("Scene colour");
+        Resource sceneBright = renderGraph.Import("Scene bright");
+        Resource sceneDepth = renderGraph.Import("Scene depth");
+        Resource occlusion = renderGraph.Import("SSAO");
+        Resource glow = renderGraph.Import("Bloom");
+        Resource backbuffer = renderGraph.Import("Backbuffer");
+        renderGraph.Output(backbuffer);
+        //OIT accumulation has the format of the light sum and of the baked light of the G-buffer, so it takes one of
+        //their textures in deferred frames
+        Resource oitAccum = renderGraph.Create("OIT accumulation",
+                rg::RenderTargetDesc(sceneWidth, sceneHeight, rg::WeightedOIT::ACCUM_FORMAT, sceneSamples,
+                                     rg::WeightedOIT::ACCUM_BYTES));
+        Resource oitWeight = renderGraph.Create("OIT weight",
+                rg::RenderTargetDesc(sceneWidth, sceneHeight, rg::WeightedOIT::WEIGHT_FORMAT, sceneSamples,
+                                     rg::WeightedOIT::WEIGHT_BYTES));
+
+        //what the scene passes read depends on the settings; Read ignores NONE
+        Resource shadowInput = renderSettings.shadows ? shadowMaps : rg::RenderGraph::NONE;
+        Resource probeInput = renderSettings.reflectionProbes ? probeCubemaps : rg::RenderGraph::NONE;
+        bool instancesCulled = renderSettings.tankArmy && renderSettings.gpuCulling && viewCount == 1;
+        Resource instanceInput = instancesCulled ? tankInstances : rg::RenderGraph::NONE;
+
+        renderGraph.AddPass("Shadows", [&](rg::RenderGraph::PassBuilder &pass) {
+            pass.Write(shadowMaps);
+        }, [&]() {
+            shadowGpuTimer.Begin();
+            shadowCascades.Render(shadowShader, uniformRing, [&]() { drawShadowCasters(true); },
+                                  [&]() { drawShadowCasters(false); });
+            shadowGpuTimer.End();
+        });
+
+        //the moon spins, so the probes that see it go stale
         glm::mat4 modelMoon= glm::mat4(1.0f);
         modelMoon = glm::translate(modelMoon,glm::vec3(-57.0f, 300.0f, 28.0f));
         modelMoon = glm::scale(modelMoon, glm::vec3(4.0f));
         modelMoon = glm::rotate( modelMoon,glm::radians(90.0f), glm::vec3(1.0f,0.0f , 0.0f));
         modelMoon = glm::rotate(modelMoon,glm::radians(currentFrame*20), glm::vec3(0.0f ,1.0f, 0.0f));
         modelMoon = glm::rotate(modelMoon,glm::radians(currentFrame*40), glm::vec3(1.0f , 0.0f,0.0f));
-        blendingShader.setMat4("model", modelMoon);
-        moonModel.Draw(blendingShader);
-
-        //render skybox
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix()));
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-
-        //skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS);
+        reflectionProbes.Track(0, modelMoon, moonRadius);
+
+        //reflection probe faces with the probe shader: static objects larger than about a degree seen from the probe,
+        //the moon (opaque) and the sky
+        renderGraph.AddPass("Reflection probes", [&](rg::RenderGraph::PassBuilder &pass) {
+            pass.Write(probeCubemaps);
+        }, [&]() {
+            reflectionProbes.Update(programState->camera.Position, renderSettings.probeBudgetMs, frameConstants,
+                                    uniformRing, [&](const glm::vec3 &probePosition) {
+                probeShader.use();
+                for (unsigned int i = 0; i < staticObjects.size(); i++) {
+                    const rg::Aabb &bounds = staticObjectWorldBounds[i];
+                    if (bounds.Radius() < 0.02f * glm::length(bounds.Center() - probePosition))
+                        continue;
+                    uniformRing.PushAndBind(rg::OBJECT_BLOCK, staticObjectConstants[i]);
+                    staticObjects[i].model->Draw(probeShader);
+                }
+                uniformRing.PushAndBind(rg::OBJECT_BLOCK, rg::ObjectConstants::From(modelMoon));
+                moonModel.Draw(probeShader);
+
+                glDepthFunc(GL_LEQUAL);
+                skyboxShader.use();
+                glBindVertexArray(skyboxVAO);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_CUBE_MAP, atmosphereSun ? atmosphere.SkyCubemap() : cubemapTexture);
+                glDrawArraysInstanced(GL_TRIANGLES, 0, 36, 1);
+                rg::frameStats.drawCalls++;
+                glBindVertexArray(0);
+                glDepthFunc(GL_LESS);
+            });
+            uniformRing.BindRange(rg::FRAME_BLOCK, frameOffset, sizeof(frameConstants));
+        });
+
+        //clears the scene targets and binds what the scene passes sample, the shadow maps and probes once they are
+        //drawn; multi-view shaders clip every view to its strip up to the transparent pass
+        renderGraph.AddPass("Scene setup", [&](rg::RenderGraph::PassBuilder &pass) {
+            pass.Write(sceneColor);
+            pass.Write(sceneBright);
+            pass.Write(sceneDepth);
+        }, [&]() {
+            glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+            glViewport(0, 0, sceneWidth, sceneHeight);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            shadowCascades.Bind();
+            specularEnvironment.Bind();
+            reflectionProbes.Bind();
+            if (viewCount > 1) {
+                glEnable(GL_CLIP_DISTANCE0);
+                glEnable(GL_CLIP_DISTANCE1);
+            }
+        });
+
+        //stale pages of the shading cache: all of them when the static lighting changed, the ones a redrawn shadow
+        //cascade reaches when the static shadows moved
+        bool deferred = renderSettings.deferredShading && viewCount == 1;
+        bool shadingCached = renderSettings.shadingCache && viewCount == 1 && !deferred &&
+                             !renderSettings.multiDrawIndirect;
+        if (shadingCached) {
+            glm::vec3 lightingKey(renderSettings.bakedLighting, frameConstants.skyAmbient, frameConstants.shadowSplits.w);
+            if (lightingKey != shadingCacheLightingKey)
+                shadingCache.Invalidate();
+            shadingCacheLightingKey = lightingKey;
+            for (int i = 0; i < rg::SHADOW_CASCADES && renderSettings.shadows; i++) {
+                if (shadowCascades.StaticUpdated(i))
+                    shadingCache.InvalidateSphere(programState->camera.Position, frameConstants.shadowSplits[i]);
+            }
+        } else {
+            //pages shaded before the cache was turned off may be stale by the time it is on again
+            shadingCacheLightingKey = glm::vec3(-1.0f);
+        }
+        renderGraph.AddPass("Shading cache", [&](rg::RenderGraph::PassBuilder &pass) {
+            pass.Read(shadowInput);
+            pass.Write(shadingAtlas);
+        }, [&]() {
+            shadingCacheGpuTimer.Begin();
+            shadingCache.Update(shadingCacheShader, uniformRing, viewFrusta[0], programState->camera.Position,
+                                SHADING_CACHE_NEAR_DISTANCE, renderSettings.shadingCachePageBudget);
+            shadingCacheGpuTimer.End();
+            glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+        });
+
+        renderGraph.AddPass("Instance culling", [&](rg::RenderGraph::PassBuilder &pass) {
+            pass.Write(tankInstances);
+        }, [&]() {
+            tankArmyCuller.Cull(*instanceCullShader, renderSettings.tankArmySize);
+            rg::frameStats.visibleInstances = tankArmyCuller.VisibleCount();
+        });
+
+        //opaque models: once into the depth buffer only when the pre-pass is on, then lit (forward) or written to
+        //the G-buffer (deferred)
+        if (renderSettings.depthPrepass) {
+            renderGraph.AddPass("Depth pre-pass", [&](rg::RenderGraph::PassBuilder &pass) {
+                pass.Read(instanceInput);
+                pass.Read(sceneDepth);
+                pass.Write(sceneDepth);
+            }, [&]() {
+                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                depthPrepassGpuTimer.Begin();
+                drawOpaque(depthPrepassShader, depthPrepassMdiShader.get(), depthPrepassInstancedShader, true, nullptr);
+                depthPrepassGpuTimer.End();
+                glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                glDepthFunc(GL_EQUAL);
+                glDepthMask(GL_FALSE);
+            });
+        }
+
+        if (deferred) {
+            rg::RenderTargetDesc albedoDesc(sceneWidth, sceneHeight, rg::DeferredShading::ALBEDO_FORMAT, sceneSamples,
+                                            rg::DeferredShading::ALBEDO_BYTES);
+            rg::RenderTargetDesc normalDesc(sceneWidth, sceneHeight, rg::DeferredShading::NORMAL_FORMAT, sceneSamples,
+                                            rg::DeferredShading::NORMAL_BYTES);
+            rg::RenderTargetDesc depthDesc(sceneWidth, sceneHeight, rg::DeferredShading::DEPTH_FORMAT, sceneSamples,
+                                           rg::DeferredShading::DEPTH_BYTES);
+            rg::RenderTargetDesc bakedDesc(sceneWidth, sceneHeight, rg::DeferredShading::BAKED_FORMAT, sceneSamples,
+                                           rg::DeferredShading::BAKED_BYTES);
+            rg::RenderTargetDesc accumDesc(sceneWidth, sceneHeight, rg::DeferredShading::ACCUM_FORMAT, sceneSamples,
+                                           rg::DeferredShading::ACCUM_BYTES);
+            Resource gAlbedo = renderGraph.Create("G-buffer albedo", albedoDesc);
+            Resource gNormal = renderGraph.Create("G-buffer normal", normalDesc);
+            Resource gDepth = renderGraph.Create("G-buffer depth", depthDesc);
+            Resource gBaked = renderGraph.Create("G-buffer baked light", bakedDesc);
+            Resource lightSum = renderGraph.Create("Light sum", accumDesc);
+
+            renderGraph.AddPass("G-buffer", [=](rg::RenderGraph::PassBuilder &pass) {
+                pass.Read(instanceInput);
+                pass.Read(sceneDepth);
+                pass.Write(gAlbedo);
+                pass.Write(gNormal);
+                pass.Write(gDepth);
+                pass.Write(gBaked);
+                pass.Write(sceneDepth);
+            }, [&, gAlbedo, gNormal, gDepth, gBaked, lightSum]() {
+                deferredShading.SetTargets(sceneTarget, renderGraph.Texture(gAlbedo), renderGraph.Texture(gNormal),
+                                           renderGraph.Texture(gDepth), renderGraph.Texture(gBaked),
+                                           renderGraph.Texture(lightSum));
+                deferredShading.BeginGeometry();
+                deferredGeometryGpuTimer.Begin();
+                opaqueSubmitTimer.Begin();
+                rg::CountAllocations submitAllocations;
+                drawOpaque(gBufferShader, gBufferMdiShader.get(), gBufferInstancedShader, !renderSettings.depthPrepass,
+                           nullptr);
+                rg::frameStats.submitAllocations = submitAllocations.Count();
+                opaqueSubmitTimer.End();
+                deferredGeometryGpuTimer.End();
+                deferredShading.EndGeometry();
+                if (renderSettings.depthPrepass) {
+                    glDepthFunc(GL_LESS);
+                    glDepthMask(GL_TRUE);
+                }
+            });
+
+            //deferred lighting: directional and spotlight over the whole screen, one volume per point light, then the
+            //sum goes to the HDR target
+            renderGraph.AddPass("Deferred lighting", [=](rg::RenderGraph::PassBuilder &pass) {
+                pass.Read(gAlbedo);
+                pass.Read(gNormal);
+                pass.Read(gDepth);
+                pass.Read(gBaked);
+                pass.Read(sceneDepth);
+                pass.Read(shadowInput);
+                pass.Read(probeInput);
+                pass.Write(lightSum);
+                pass.Write(sceneColor);
+                pass.Write(sceneBright);
+            }, [&]() {
+                deferredLightingGpuTimer.Begin();
+                deferredShading.BeginLighting();
+                (multisampled ? deferredGlobalShader : deferredGlobalSingleShader).use();
+                renderQuad();
+                (multisampled ? deferredPointShader : deferredPointSingleShader).use();
+                deferredShading.DrawPointLights(frameLights.size());
+                deferredShading.BeginComposite(hdrFBO);
+                (multisampled ? deferredCompositeShader : deferredCompositeSingleShader).use();
+                renderQuad();
+                deferredShading.EndComposite();
+                deferredLightingGpuTimer.End();
+            });
+        } else {
+            renderGraph.AddPass("Forward opaque", [&](rg::RenderGraph::PassBuilder &pass) {
+                pass.Read(instanceInput);
+                pass.Read(sceneDepth);
+                pass.Read(shadowInput);
+                pass.Read(probeInput);
+                if (shadingCached)
+                    pass.Read(shadingAtlas);
+                pass.Write(sceneColor);
+                pass.Write(sceneBright);
+                pass.Write(sceneDepth);
+            }, [&]() {
+                opaqueLitGpuTimer.Begin();
+                opaqueLitSamples.Begin();
+                opaqueSubmitTimer.Begin();
+                rg::CountAllocations submitAllocations;
+                drawOpaque(modelShader, mdiShader.get(), instancedShader, !renderSettings.depthPrepass,
+                           shadingCached ? &cachedShader : nullptr);
+                rg::frameStats.submitAllocations = submitAllocations.Count();
+                opaqueSubmitTimer.End();
+                opaqueLitSamples.End();
+                opaqueLitGpuTimer.End();
+                if (renderSettings.depthPrepass) {
+                    glDepthFunc(GL_LESS);
+                    glDepthMask(GL_TRUE);
+                }
+            });
+        }
+
+        //light bullets, after the opaque pass so the deferred composite does not cover them, then the sky: the
+        //atmosphere as one fullscreen triangle, or the skybox cube
+        renderGraph.AddPass("Light bullets and sky", [&](rg::RenderGraph::PassBuilder &pass) {
+            pass.Read(sceneDepth);
+            pass.Write(sceneColor);
+            pass.Write(sceneBright);
+        }, [&]() {
+            lightShader.use();
+            for (const rg::ObjectConstants &bullet: lightBulletConstants)
+            {
+                uniformRing.PushAndBind(rg::OBJECT_BLOCK, bullet);
+                renderCube(viewCount);
+            }
+
+            skyGpuTimer.Begin();
+            if (atmosphereSun) {
+                atmosphere.Draw(atmosphereShader, viewCount);
+            } else {
+                glDepthFunc(GL_LEQUAL);
+                skyboxShader.use();
+
+                //skybox cube
+                glBindVertexArray(skyboxVAO);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+                glDrawArraysInstanced(GL_TRIANGLES, 0, 36, viewCount);
+                rg::frameStats.drawCalls++;
+                glBindVertexArray(0);
+                glDepthFunc(GL_LESS);
+            }
+            skyGpuTimer.End();
+        });
+
+        //post-processing constants, used by the OIT composite and the bloom passes
+        rg::PostConstants postConstants;
+        postConstants.screenWidth = sceneWidth;
+        postConstants.screenHeight = sceneHeight;
+        //with FXAA the composite stays at the scene size and the FXAA pass upscales
+        postConstants.outputWidth = fxaaFrame ? sceneWidth : windowWidth;
+        postConstants.outputHeight = fxaaFrame ? sceneHeight : windowHeight;
+        postConstants.hdr = hdr;
+        postConstants.bloom = bloom;
+        postConstants.exposure = exposure;
+        postConstants.gammaEnabled = gammaEnabled;
+        postConstants.grayscale = grayscale;
+        postConstants.ssao = renderSettings.ssao && viewCount == 1;
+        postConstants.ssaoScale = 2 << renderSettings.ssaoResolution;
+        postConstants.ssaoSamples = rg::Ssao::Samples(renderSettings.ssaoQuality);
+        postConstants.ssaoRadius = renderSettings.ssaoRadius;
+        postConstants.ssaoProjection = glm::vec4(projection[0][0], projection[1][1], 0.1f, farPlane);
+        postConstants.ssaoIntensity = renderSettings.ssaoIntensity;
+        //every level adds a copy of the glow on the way up
+        postConstants.bloomStrength = renderSettings.bloomStrength /
+                                      std::min(renderSettings.bloomLevels, bloomChain.LevelCount());
+        postConstants.bloomRadius = renderSettings.bloomRadius;
+        //one copy of the post constants per blur direction, the passes alternate between the two ranges
+        GLintptr postOffsets[2];
+        for (int direction = 0; direction < 2; direction++) {
+            postConstants.horizontal = direction;
+            postOffsets[direction] = uniformRing.Push(postConstants);
+        }
+
+        //transparent surfaces: weighted blended OIT, submitted in any order and composited over the scene before bloom
+        renderGraph.AddPass("Transparency", [&](rg::RenderGraph::PassBuilder &pass) {
+            pass.Read(sceneDepth);
+            pass.Write(oitAccum);
+            pass.Write(oitWeight);
+        }, [&]() {
+            oit.SetTargets(sceneTarget, renderGraph.Texture(oitAccum), renderGraph.Texture(oitWeight));
+            oit.BeginAccumulate();
+            blendingShader.use();
+
+            //render moon
+            uniformRing.PushAndBind(rg::OBJECT_BLOCK, rg::ObjectConstants::From(modelMoon));
+            moonModel.DrawInstanced(blendingShader, viewCount);
+
+            if (renderSettings.smoke && viewCount == 1) {
+                smokeShader.use();
+                for (rg::SmokeColumn &column: smokeColumns) {
+                    column.Update(currentFrame);
+                    column.Draw();
+                }
+            }
+            oit.EndAccumulate(hdrFBO);
+            glDisable(GL_CLIP_DISTANCE0);
+            glDisable(GL_CLIP_DISTANCE1);
+        });
+        framePacer.RequestAnimation(renderSettings.animationRate);
+
+        renderGraph.AddPass("OIT composite", [&](rg::RenderGraph::PassBuilder &pass) {
+            pass.Read(oitAccum);
+            pass.Read(oitWeight);
+            pass.Write(sceneColor);
+        }, [&]() {
+            oit.BeginComposite(GL_TEXTURE0, GL_TEXTURE1);
+            (multisampled ? oitCompositeShader : oitCompositeSingleShader).use();
+            uniformRing.BindRange(rg::POST_BLOCK, postOffsets[0], sizeof(rg::PostConstants));
+            renderQuad();
+            oit.EndComposite();
+        });
+
+        //debug geometry, depth tested against the scene
+        debugDraw.enabled = renderSettings.debugDraw;
+        if (debugDraw.enabled) {
+            if (renderSettings.debugBounds) {
+                for (unsigned int i = 0; i < staticObjects.size(); i++)
+                    debugDraw.Box(staticObjectBounds[i], staticObjects[i].transform, glm::vec3(1.0f, 1.0f, 0.0f));
+                //boxes for the whole army would dwarf the scene geometry, the first thousand show the culling well enough
+                if (renderSettings.tankArmy) {
+                    for (int i = 0; i < std::min(renderSettings.tankArmySize, 1000); i++)
+                        debugDraw.Box(tankBounds, tankArmy[i].model, glm::vec3(0.0f, 1.0f, 0.3f));
+                }
+            }
+            if (renderSettings.debugLights) {
+                for (unsigned int i = 0; i < std::min<size_t>(frameLights.size(), 1000); i++) {
+                    const rg::PointLightConstants &light = frameLights[i];
+                    debugDraw.Point(light.position, glm::vec3(1.0f, 0.3f, 0.0f));
+                    debugDraw.Sphere(light.position, light.radius, glm::vec3(0.6f, 0.15f, 0.0f));
+                }
+            }
+            if (renderSettings.debugFrustum) {
+                if (!frustumFrozen) {
+                    frozenViewProjection = projection * view;
+                    frustumFrozen = true;
+                }
+                debugDraw.Frustum(frozenViewProjection, glm::vec3(0.2f, 0.6f, 1.0f));
+            } else {
+                frustumFrozen = false;
+            }
+            renderGraph.AddPass("Debug geometry", [&](rg::RenderGraph::PassBuilder &pass) {
+                pass.Read(sceneDepth);
+                pass.Write(sceneColor);
+            }, [&]() {
+                debugShader.use();
+                if (viewCount > 1) {
+                    glEnable(GL_CLIP_DISTANCE0);
+                    glEnable(GL_CLIP_DISTANCE1);
+                }
+                debugDraw.Flush(debugShader, viewCount);
+                glDisable(GL_CLIP_DISTANCE0);
+                glDisable(GL_CLIP_DISTANCE1);
+            });
+        }
+
+        //ambient occlusion of the finished scene depth, applied in the final composite
+        renderGraph.AddPass("SSAO", [&](rg::RenderGraph::PassBuilder &pass) {
+            pass.Read(sceneDepth);
+            pass.Write(occlusion);
+        }, [&]() {
+            ssaoGpuTimer.Begin();
+            ssao.Render(hdrFBO, postConstants.ssaoScale, ssaoDepthShader, ssaoShader, ssaoBlurShader, uniformRing,
+                        postOffsets[1], postOffsets[0], renderQuad);
+            ssaoGpuTimer.End();
+        });
 
         //bloom, hdr
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 12;
-        blurShader.use();
-        for (unsigned int i = 0; i < amount; i++)
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            blurShader.setInt("horizontal", horizontal);
-            blurShader.setInt("SCR_WIDTH", SCR_WIDTH);
-            blurShader.setInt("SCR_HEIGHT", SCR_HEIGHT);
+        renderGraph.AddPass("Bloom", [&](rg::RenderGraph::PassBuilder &pass) {
+            pass.Read(sceneBright);
+            pass.Write(glow);
+        }, [&]() {
+            bloomGpuTimer.Begin();
+            bloomChain.Render(hdrFBO, GL_COLOR_ATTACHMENT1, renderSettings.bloomLevels, bloomDownShader,
+                              bloomUpShader, uniformRing, postOffsets[0], renderQuad);
+            bloomGpuTimer.End();
+        });
+
+        //the glow and the occlusion are only read when they are shown, otherwise their passes are culled. With FXAA
+        //the tonemapped image goes to an LDR target first
+        Resource ldrScene = fxaaFrame ? renderGraph.Create("LDR scene",
+                rg::RenderTargetDesc(sceneWidth, sceneHeight, rg::Fxaa::LDR_FORMAT, 1, rg::Fxaa::LDR_BYTES)) :
+                rg::RenderGraph::NONE;
+        renderGraph.AddPass("Composite", [&](rg::RenderGraph::PassBuilder &pass) {
+            pass.Read(sceneColor);
+            if (postConstants.ssao)
+                pass.Read(occlusion);
+            if (bloom)
+                pass.Read(glow);
+            pass.Write(fxaaFrame ? ldrScene : backbuffer);
+        }, [&]() {
+            if (fxaaFrame) {
+                fxaa.BeginComposite(renderGraph.Texture(ldrScene));
+                glViewport(0, 0, sceneWidth, sceneHeight);
+            } else {
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                glViewport(0, 0, windowWidth, windowHeight);
+            }
+            uniformRing.BindRange(rg::POST_BLOCK, postOffsets[0], sizeof(rg::PostConstants));
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            (multisampled ? bloomFinalShader : bloomFinalSingleShader).use();
             glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);
+            glBindTexture(sceneTarget, colorBuffers[0]);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, bloomChain.Result());
             renderQuad();
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
+        });
+
+        if (fxaaFrame) {
+            renderGraph.AddPass("FXAA", [=](rg::RenderGraph::PassBuilder &pass) {
+                pass.Read(ldrScene);
+                pass.Write(backbuffer);
+            }, [&]() {
+                fxaaGpuTimer.Begin();
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                glViewport(0, 0, windowWidth, windowHeight);
+                fxaa.Apply(fxaaShader, renderQuad);
+                fxaaGpuTimer.End();
+            });
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        renderGraph.Execute();
 
-        bloomFinalShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, pingpongColorbuffers[!horizontal]);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled);
-        bloomFinalShader.setInt("SCR_WIDTH", SCR_WIDTH);
-        bloomFinalShader.setInt("SCR_HEIGHT", SCR_HEIGHT);
+        if (lightScalingSweep.running)
+            lightScalingSweep.Record(opaqueLitGpuTimer.Milliseconds(),
+                                     deferredGeometryGpuTimer.Milliseconds() + deferredLightingGpuTimer.Milliseconds());
+        if (antialiasingComparison.running)
+            antialiasingComparison.Record(renderGraph.FrameMilliseconds(), sceneTargetBytes + renderGraph.PoolBytes(),
+                                          windowWidth, windowHeight, renderSettings);
 
-        bloomFinalShader.setInt("hdr", hdr);
-        bloomFinalShader.setInt("bloom", bloom);
-        bloomFinalShader.setFloat("exposure", exposure);
-        bloomFinalShader.setInt("gammaEnabled",gammaEnabled);
-        bloomFinalShader.setInt("grayscale", grayscale);
-        renderQuad();
+        if (programState->ImGuiEnabled)
+            DrawImGui(programState);
 
-        std::cout << "hdr: " << (hdr ? "on" : "off") << std::endl;
-        std::cout << "bloom: " << (bloom ? "on" : "off") << " | exposure: " << exposure << std::endl;
-        std::cout << (gammaEnabled ? "Gamma enabled" : "Gamma disabled") << std::endl;
+        uniformRing.EndFrame();
+        rg::gpuResources.EndFrame();
+
+        //every resource of the copies has to be released again; the deletes themselves follow a few frames later
+        if (modelReloadCheckRequested) {
+            modelReloadCheckRequested = false;
+            unsigned baselineCounts[rg::GPU_RESOURCE_TYPES];
+            for (int type = 0; type < rg::GPU_RESOURCE_TYPES; type++)
+                baselineCounts[type] = rg::gpuResources.Count((rg::GpuResourceType) type);
+            size_t baselineBytes = rg::gpuResources.TotalLiveBytes();
+            size_t loadedBytes;
+            stbi_set_flip_vertically_on_load(false);
+            {
+                std::vector<Model> copies;
+                copies.reserve(sceneModels.size());
+                for (const Model *model: sceneModels)
+                    copies.emplace_back(model->path);
+                loadedBytes = rg::gpuResources.TotalLiveBytes();
+            }
+            stbi_set_flip_vertically_on_load(true);
+            bool balanced = rg::gpuResources.TotalLiveBytes() == baselineBytes;
+            for (int type = 0; type < rg::GPU_RESOURCE_TYPES; type++)
+                balanced = balanced && rg::gpuResources.Count((rg::GpuResourceType) type) == baselineCounts[type];
+            modelReloadCheckResult = (balanced ? "passed: " : "FAILED: ") +
+                                     std::to_string((loadedBytes - baselineBytes) >> 20) + " MB loaded and released";
+            framePacer.MarkDirty();
+        }
 
+        if (skyBenchmarkRequested) {
+            skyBenchmarkRequested = false;
+            skyBenchmark = skyIrradiance.Benchmark();
+            framePacer.MarkDirty();
+        }
 
-        if (programState->ImGuiEnabled)
-            DrawImGui(programState);
+        if (environmentVerifyRequested) {
+            environmentVerifyRequested = false;
+            environmentVerifyResult = specularEnvironment.Verify();
+            framePacer.MarkDirty();
+        }
 
         //glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         glfwSwapBuffers(window);
@@ -638,6 +1910,14 @@ int main() {
 
     programState->SaveToFile("resources/program_state.txt");
     delete programState;
+    //the optional shaders go before the last deletes, so their programs are freed with the rest
+    mdiShader.reset();
+    depthPrepassMdiShader.reset();
+    gBufferMdiShader.reset();
+    instanceCullShader.reset();
+    tankArmyCuller.Release();
+    glFinish();
+    rg::gpuResources.DeleteReleased();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -726,9 +2006,11 @@ void processInput(GLFWwindow *window) {
 
 //GLFW: whenever the window size changed (by OS or user resize) this callback function executes-------------------------
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
-    // make sure the viewport matches the new window dimensions; note that width and
-    // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    // the scene targets follow the new window dimensions in the next frame; note that width and
+    // height will be significantly larger than specified on retina displays. A minimized window reports 0
+    windowWidth = std::max(width, 1);
+    windowHeight = std::max(height, 1);
+    framePacer.MarkDirty();
 }
 
 //GLFW: whenever the mouse moves, this callback is called---=-----------------------------------------------------------
@@ -744,6 +2026,7 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
 
     lastX = xpos;
     lastY = ypos;
+    framePacer.MarkDirty();
 
     if (programState->CameraMouseMovementUpdateEnabled)
         programState->camera.ProcessMouseMovement(xoffset, yoffset);
@@ -752,22 +2035,34 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
 //GLFW: whenever the mouse scroll wheel scrolls, this callback is called------------------------------------------------
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
     programState->camera.ProcessMouseScroll(yoffset);
+    framePacer.MarkDirty();
+}
+
+//GLFW: mouse buttons only matter to ImGui, but a click has to redraw the frame in on-demand mode---------------------
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods) {
+    framePacer.MarkDirty();
+}
+
+//GLFW: the window contents were damaged (uncovered, restored) and have to be drawn again-----------------------------
+void window_refresh_callback(GLFWwindow *window) {
+    framePacer.MarkDirty();
 }
 
 //CUBEMAP LOADING-------------------------------------------------------------------------------------------------------
-unsigned int loadCubemap(vector<std::string> faces)
+rg::GpuRef loadCubemap(vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    rg::GpuRef textureID(rg::GPU_TEXTURE);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
     int width, height, nrChannels;
+    size_t bytes = 0;
     for (unsigned int i = 0; i < faces.size(); i++)
     {
         unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
         if (data)
         {
             glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+            bytes += rg::TextureBytes(width, height, 3);
             stbi_image_free(data);
         }
         else
@@ -781,6 +2076,7 @@ unsigned int loadCubemap(vector<std::string> faces)
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    textureID.SetBytes(bytes);
 
     return textureID;
 }
@@ -816,12 +2112,247 @@ void DrawImGui(ProgramState *programState) {
         ImGui::End();
     }
 
+    {
+        ImGui::Begin("Renderer");
+        ImGui::Text("OpenGL %d.%d", rg::glCaps.major, rg::glCaps.minor);
+        ImGui::Text("HDR: %s, bloom: %s, exposure: %.3f, gamma: %s", hdr ? "on" : "off", bloom ? "on" : "off",
+                    exposure, gammaEnabled ? "on" : "off");
+        if (bloom) {
+            ImGui::SliderInt("Bloom levels", &renderSettings.bloomLevels, 1, bloomChain.LevelCount());
+            ImGui::SliderFloat("Bloom radius", &renderSettings.bloomRadius, 0.5f, 3.0f);
+            ImGui::SliderFloat("Bloom strength", &renderSettings.bloomStrength, 0.0f, 4.0f);
+            ImGui::Text("Bloom: %d levels down to %dx%d, GPU %.3f ms", bloomChain.ActiveLevels(),
+                        bloomChain.LevelWidth(bloomChain.ActiveLevels() - 1),
+                        bloomChain.LevelHeight(bloomChain.ActiveLevels() - 1), bloomGpuTimer.Milliseconds());
+        }
+        ImGui::Text("Window: %dx%d, scene targets: %dx%d", windowWidth, windowHeight, sceneWidth, sceneHeight);
+        if (ImGui::Checkbox("Dynamic resolution", &renderSettings.dynamicResolution))
+            dynamicResolution.Reset(renderSettings.renderScale);
+        if (renderSettings.dynamicResolution) {
+            rg::DynamicResolution::Settings &resolution = renderSettings.resolution;
+            ImGui::SliderFloat("Target GPU time (ms)", &resolution.targetMs, 2.0f, 33.0f);
+            ImGui::SliderFloat("Minimum scale", &resolution.minScale, 0.25f, resolution.maxScale);
+            ImGui::SliderFloat("Maximum scale", &resolution.maxScale, resolution.minScale, 1.0f);
+            ImGui::Text("Scale: %.2f, GPU %.3f ms (last frame %.3f ms)", dynamicResolution.Scale(),
+                        dynamicResolution.FilteredMilliseconds(), renderGraph.FrameMilliseconds());
+        } else {
+            ImGui::SliderFloat("Render scale", &renderSettings.renderScale, 0.25f, 1.0f);
+        }
+        const char *antialiasingModes[] = {"4x MSAA", "FXAA", "None"};
+        ImGui::Combo("Anti-aliasing", &renderSettings.antialiasing, antialiasingModes, 3);
+        ImGui::Text("Scene targets: %d sample%s, %.1f MB, graph targets %.1f MB; frame GPU %.3f ms", sceneSamples,
+                    sceneSamples > 1 ? "s" : "", sceneTargetBytes / 1048576.0, renderGraph.PoolBytes() / 1048576.0,
+                    renderGraph.FrameMilliseconds());
+        if (renderSettings.antialiasing == ANTIALIASING_FXAA)
+            ImGui::Text("FXAA GPU: %.3f ms", fxaaGpuTimer.Milliseconds());
+        if (antialiasingComparison.running)
+            ImGui::Text("Anti-aliasing comparison: %s, frame %d of %d",
+                        antialiasingComparison.names[antialiasingComparison.mode], antialiasingComparison.frame + 1,
+                        AntialiasingComparison::FRAMES_PER_MODE);
+        else if (ImGui::Button("Compare anti-aliasing with a supersampled reference"))
+            antialiasingComparison.Start(renderSettings, (float) glfwGetTime());
+        if (antialiasingComparison.finished) {
+            ImGui::Text("%10s %10s %10s %10s %10s", "mode", "GPU ms", "MB", "RMS", "edge RMS");
+            for (int i = 0; i < AntialiasingComparison::MODES; i++)
+                ImGui::Text("%10s %10.3f %10.1f %10.2f %10.2f", antialiasingComparison.names[i],
+                            antialiasingComparison.gpuMs[i], antialiasingComparison.targetBytes[i] / 1048576.0,
+                            antialiasingComparison.error[i], antialiasingComparison.edgeError[i]);
+            ImGui::Text("%d edge pixels; FXAA edges %s (error %.0f%% of no anti-aliasing)",
+                        antialiasingComparison.edgePixels,
+                        antialiasingComparison.Acceptable() ? "acceptable" : "not acceptable",
+                        antialiasingComparison.edgeError[3] > 0.0f ?
+                        100.0f * antialiasingComparison.edgeError[2] / antialiasingComparison.edgeError[3] : 0.0f);
+        }
+        ImGui::Checkbox("Render graph", &renderSettings.renderGraphView);
+        if (renderSettings.renderGraphView) {
+            for (int i = 0; i < renderGraph.PassCount(); i++) {
+                if (renderGraph.PassCulled(i))
+                    ImGui::TextDisabled("%2d %s: culled", i, renderGraph.PassName(i));
+                else
+                    ImGui::Text("%2d %s: GPU %.3f ms", i, renderGraph.PassName(i), renderGraph.PassMilliseconds(i));
+                ImGui::TextDisabled("   %s", renderGraph.PassResources(i).c_str());
+            }
+            for (int i = 0; i < renderGraph.ResourceCount(); i++) {
+                if (!renderGraph.ResourceTransient(i))
+                    continue;
+                if (renderGraph.ResourceSlot(i) < 0)
+                    ImGui::TextDisabled("%s: unused", renderGraph.ResourceName(i));
+                else
+                    ImGui::Text("%s: texture %d, passes %d-%d", renderGraph.ResourceName(i),
+                                renderGraph.ResourceSlot(i), renderGraph.ResourceFirstPass(i),
+                                renderGraph.ResourceLastPass(i));
+            }
+            ImGui::Text("Transient targets: %.1f MB in %d textures (%.1f MB without sharing)",
+                        renderGraph.PoolBytes() / 1048576.0, renderGraph.PoolSize(),
+                        renderGraph.TransientBytes() / 1048576.0);
+        }
+        ImGui::Checkbox("Render on demand", &renderSettings.onDemand);
+        ImGui::SliderInt("Animation rate (Hz)", &renderSettings.animationRate, 0, 60);
+        ImGui::Text("Frames rendered: %u, skipped: %u", framePacer.RenderedFrames(), framePacer.SkippedFrames());
+        if (rg::glCaps.multiDrawIndirect)
+            ImGui::Checkbox("Multi-draw indirect", &renderSettings.multiDrawIndirect);
+        else
+            ImGui::TextDisabled("Multi-draw indirect (needs GL 4.3)");
+        ImGui::Text("Draw calls: %u (static opaque: %u)", rg::frameStats.drawCalls, rg::frameStats.opaqueDrawCalls);
+        if (rg::CountAllocations::Available())
+            ImGui::Text("Opaque submit: %.3f ms CPU, %u heap allocations", opaqueSubmitTimer.Milliseconds(),
+                        rg::frameStats.submitAllocations);
+        else
+            ImGui::Text("Opaque submit: %.3f ms CPU, heap allocations unavailable (RG_COUNT_ALLOCATIONS)",
+                        opaqueSubmitTimer.Milliseconds());
+        ImGui::Checkbox("T-90 army (instanced)", &renderSettings.tankArmy);
+        ImGui::SliderInt("Tanks", &renderSettings.tankArmySize, 1, 10000);
+        if (rg::glCaps.computeShader)
+            ImGui::Checkbox("GPU frustum culling", &renderSettings.gpuCulling);
+        else
+            ImGui::TextDisabled("GPU frustum culling (needs GL 4.3)");
+        ImGui::Text("Instanced draw calls: %u", rg::frameStats.instancedDrawCalls);
+        if (renderSettings.gpuCulling)
+            ImGui::Text("Visible tanks: %u", rg::frameStats.visibleInstances);
+        ImGui::Checkbox("Smoke (order-independent transparency)", &renderSettings.smoke);
+        ImGui::Checkbox("Depth pre-pass", &renderSettings.depthPrepass);
+        ImGui::Checkbox("Tracer lights (clustered)", &renderSettings.tracerLights);
+        ImGui::SliderInt("Tracers", &renderSettings.tracerLightCount, 0, 8192);
+        ImGui::Text("Point lights: %u, in view: %u, cluster entries: %u, max per cluster: %u%s",
+                    clusteredLights.LightCount(), clusteredLights.VisibleLights(), clusteredLights.IndexCount(),
+                    clusteredLights.MaxLightsPerCluster(), clusteredLights.Overflowed() ? " (overflow)" : "");
+        ImGui::Text("Light binning: %.3f ms CPU", lightBinningTimer.Milliseconds());
+        ImGui::Checkbox("Shadows (cascaded, cached)", &renderSettings.shadows);
+        if (renderSettings.shadows) {
+            ImGui::SliderFloat("Shadow distance", &renderSettings.shadowDistance, 50.0f, 700.0f);
+            ImGui::Text("Shadow draws: static %u (%d cascades redrawn), dynamic %u, GPU %.3f ms",
+                        rg::frameStats.shadowStaticDrawCalls, shadowCascades.StaticUpdates(),
+                        rg::frameStats.shadowDynamicDrawCalls, shadowGpuTimer.Milliseconds());
+        }
+        ImGui::Checkbox("Baked static lighting", &renderSettings.bakedLighting);
+        ImGui::Text("Bake: %zu vertices, %zu triangles, %s", lightBaker.VertexCount(), lightBaker.TriangleCount(),
+                    lightBaker.FromCache() ? "loaded from cache" : "baked");
+        if (!lightBaker.FromCache())
+            ImGui::Text("Baked in %.2f s on %u threads, %.1f M rays", lightBaker.Seconds(), lightBaker.Threads(),
+                        lightBaker.RayCount() / 1000000.0);
+        ImGui::Checkbox("Sky ambient (spherical harmonics)", &renderSettings.skyAmbient);
+        if (renderSettings.skyAmbient)
+            ImGui::SliderFloat("Sky ambient strength", &renderSettings.skyAmbientStrength, 0.0f, 4.0f);
+        glm::vec3 skyColor = skyIrradiance.AverageColor();
+        ImGui::Text("Sky SH: average (%.2f, %.2f, %.2f), %s in %.2f ms", skyColor.r, skyColor.g, skyColor.b,
+                    skyIrradiance.FromCache() ? "loaded from cache" : "projected", skyIrradiance.Milliseconds());
+        if (ImGui::Button("Benchmark SH projection"))
+            skyBenchmarkRequested = true;
+        for (const rg::SkyIrradiance::BenchmarkResult &result: skyBenchmark)
+            ImGui::Text("  %4d x %4d faces: %.3f ms on %u threads", result.faceSize, result.faceSize,
+                        result.milliseconds, skyIrradiance.Threads());
+        ImGui::Checkbox("Environment reflections (GGX prefiltered)", &renderSettings.environmentReflections);
+        if (renderSettings.environmentReflections)
+            ImGui::SliderFloat("Environment strength", &renderSettings.environmentStrength, 0.0f, 4.0f);
+        ImGui::Text("Environment: %d levels from %dx%d, %s in %.1f ms on %u threads", specularEnvironment.Levels(),
+                    specularEnvironment.Size(), specularEnvironment.Size(),
+                    specularEnvironment.FromCache() ? "loaded from cache" : "baked",
+                    specularEnvironment.Milliseconds(), specularEnvironment.Threads());
+        if (ImGui::Button("Verify environment bake"))
+            environmentVerifyRequested = true;
+        if (!environmentVerifyResult.empty())
+            ImGui::Text("Environment bake check %s", environmentVerifyResult.c_str());
+        ImGui::Checkbox("Atmosphere (scattering sky, movable sun)", &renderSettings.atmosphere);
+        if (renderSettings.atmosphere) {
+            ImGui::SliderFloat("Sun elevation", &renderSettings.sunElevation, -10.0f, 90.0f);
+            ImGui::SliderFloat("Sun azimuth", &renderSettings.sunAzimuth, 0.0f, 360.0f);
+            ImGui::SliderFloat("Turbidity", &renderSettings.turbidity, 0.0f, 10.0f);
+            ImGui::Text("Atmosphere tables %.1f ms, sky view %.1f ms, cubemap and environment %.1f ms on %u threads%s",
+                        atmosphere.TablesMilliseconds(), atmosphere.SkyViewMilliseconds(),
+                        atmosphere.CubemapMilliseconds(), atmosphere.Threads(),
+                        atmosphere.Building() ? " (building)" : "");
+            ImGui::Text("Sky faces to upload %d, sky brightness %.2f", atmosphere.FacesPending(),
+                        atmosphere.SkyBrightness());
+        }
+        ImGui::Text("Sky draw: GPU %.3f ms (%s)", skyGpuTimer.Milliseconds(), atmosphereSun ? "atmosphere" : "skybox");
+        ImGui::Checkbox("Reflection probes (runtime, budgeted)", &renderSettings.reflectionProbes);
+        if (renderSettings.reflectionProbes) {
+            ImGui::SliderFloat("Probe budget (ms)", &renderSettings.probeBudgetMs, 0.05f, 4.0f);
+            ImGui::Text("Probe steps: %d this frame, %.3f ms GPU each, %u draws; showing probe %d",
+                        reflectionProbes.StepsLastFrame(), reflectionProbes.StepMilliseconds(),
+                        rg::frameStats.probeDrawCalls, reflectionProbes.Selected());
+            for (int i = 0; i < reflectionProbes.ProbeCount(); i++)
+                ImGui::Text("  probe %d: %u refreshes, staleness %.4f%s", i, reflectionProbes.Refreshes(i),
+                            reflectionProbes.Staleness(i), reflectionProbes.Active() == i ? " (refreshing)" : "");
+        }
+        ImGui::Checkbox("SSAO (reduced resolution, bilateral upsample)", &renderSettings.ssao);
+        if (renderSettings.ssao) {
+            const char *ssaoResolutions[] = {"Half", "Quarter"};
+            const char *ssaoQualities[] = {"Low (8)", "Medium (16)", "High (32)"};
+            ImGui::Combo("SSAO resolution", &renderSettings.ssaoResolution, ssaoResolutions, 2);
+            ImGui::Combo("SSAO quality", &renderSettings.ssaoQuality, ssaoQualities, 3);
+            ImGui::SliderFloat("SSAO radius", &renderSettings.ssaoRadius, 0.25f, 8.0f);
+            ImGui::SliderFloat("SSAO intensity", &renderSettings.ssaoIntensity, 0.5f, 4.0f);
+            ImGui::Text("SSAO: %dx%d, GPU %.3f ms%s", ssao.Width(), ssao.Height(), ssaoGpuTimer.Milliseconds(),
+                        renderSettings.splitScreen ? " (off in split screen)" : "");
+        }
+        ImGui::Checkbox("Texture-space shading cache (ground objects)", &renderSettings.shadingCache);
+        if (renderSettings.shadingCache) {
+            ImGui::SliderInt("Cache page budget", &renderSettings.shadingCachePageBudget, 1, 128);
+            ImGui::Text("Cache: %d pages shaded this frame, %d stale of %d, GPU %.3f ms",
+                        shadingCache.PagesLastFrame(), shadingCache.StalePages(), shadingCache.PageCount(),
+                        shadingCacheGpuTimer.Milliseconds());
+            ImGui::Text("Cache atlases: %.1f M texels%s", shadingCache.Texels() / 1000000.0,
+                        renderSettings.splitScreen || renderSettings.deferredShading ||
+                        renderSettings.multiDrawIndirect ? " (unused: forward single view per-draw only)" : "");
+        }
+        ImGui::Checkbox("Deferred shading (light volumes)", &renderSettings.deferredShading);
+        if (renderSettings.deferredShading)
+            ImGui::Text("G-buffer pass GPU: %.3f ms, lighting GPU: %.3f ms%s",
+                        deferredGeometryGpuTimer.Milliseconds(), deferredLightingGpuTimer.Milliseconds(),
+                        renderSettings.splitScreen ? " (split screen draws forward)" : "");
+        if (lightScalingSweep.running)
+            ImGui::Text("Light scaling sweep: step %d of %d", lightScalingSweep.step + 1, 2 * LightScalingSweep::STEPS);
+        else if (ImGui::Button("Light scaling sweep (forward vs deferred)"))
+            lightScalingSweep.Start();
+        if (lightScalingSweep.step > 0) {
+            ImGui::Text("%8s %14s %14s", "tracers", "forward ms", "deferred ms");
+            for (int i = 0; i < LightScalingSweep::STEPS; i++)
+                ImGui::Text("%8d %14.3f %14.3f", lightScalingSweep.lightCounts[i], lightScalingSweep.forwardMs[i],
+                            lightScalingSweep.deferredMs[i]);
+        }
+        ImGui::Checkbox("Gunner camera (split screen, one pass)", &renderSettings.splitScreen);
+        ImGui::Text("Culled static objects: %u", rg::frameStats.culledObjects);
+        ImGui::Checkbox("Debug geometry", &renderSettings.debugDraw);
+        if (renderSettings.debugDraw) {
+            ImGui::Checkbox("Bounds", &renderSettings.debugBounds);
+            ImGui::Checkbox("Point lights and ranges", &renderSettings.debugLights);
+            ImGui::Checkbox("Freeze camera frustum", &renderSettings.debugFrustum);
+            ImGui::Text("Debug lines: %u, points: %u", debugDraw.LineCount(), debugDraw.PointCount());
+        }
+        if (renderSettings.depthPrepass)
+            ImGui::Text("Depth pre-pass GPU: %.3f ms", depthPrepassGpuTimer.Milliseconds());
+        ImGui::Text("Opaque lit pass GPU: %.3f ms", opaqueLitGpuTimer.Milliseconds());
+        ImGui::Text("Opaque lit samples: %.0f", opaqueLitSamples.Value());
+        ImGui::Text("glUniform calls: %u", rg::frameStats.uniformCalls);
+        ImGui::Text("Materials: %u, material binds: %u", rg::materialLibrary.Count(), rg::frameStats.materialBinds);
+        ImGui::Text("GPU memory: buffers %.1f MB, textures %.1f MB, renderbuffers %.1f MB",
+                    rg::gpuResources.LiveBytes(rg::GPU_BUFFER) / 1048576.0,
+                    rg::gpuResources.LiveBytes(rg::GPU_TEXTURE) / 1048576.0,
+                    rg::gpuResources.LiveBytes(rg::GPU_RENDERBUFFER) / 1048576.0);
+        ImGui::Text("GPU objects: %u buffers, %u textures, %u VAOs, %u programs, %u framebuffers",
+                    rg::gpuResources.Count(rg::GPU_BUFFER), rg::gpuResources.Count(rg::GPU_TEXTURE),
+                    rg::gpuResources.Count(rg::GPU_VERTEX_ARRAY), rg::gpuResources.Count(rg::GPU_PROGRAM),
+                    rg::gpuResources.Count(rg::GPU_FRAMEBUFFER));
+        ImGui::Text("Waiting for delete: %u (%.1f MB)", rg::gpuResources.PendingCount(),
+                    rg::gpuResources.PendingBytes() / 1048576.0);
+        if (ImGui::Button("Reload all models (leak check)"))
+            modelReloadCheckRequested = true;
+        if (!modelReloadCheckResult.empty())
+            ImGui::Text("Reload check %s", modelReloadCheckResult.c_str());
+        ImGui::Text("Uniform ring: %s, %u stalls, %.1f of %.1f KB per frame",
+                    uniformRing.Persistent() ? "persistent mapping" : "glBufferSubData", uniformRing.Stalls(),
+                    uniformRing.LastFrameBytes() / 1024.0, uniformRing.RegionSize() / 1024.0);
+        ImGui::End();
+    }
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
 //KEYCALLBACK-----------------------------------------------------------------------------------------------------------
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    framePacer.MarkDirty();
     if (key == GLFW_KEY_F1 && action == GLFW_PRESS) {
         programState->ImGuiEnabled = !programState->ImGuiEnabled;
         if (programState->ImGuiEnabled) {
@@ -861,13 +2392,14 @@ void renderQuad(){
     }
     glBindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
+    rg::frameStats.drawCalls++;
     glBindVertexArray(0);
 }
 
 //DRAW LIGHTCUBES - BULLETS---------------------------------------------------------------------------------------------
 unsigned int cubeVAO = 0;
 unsigned int cubeVBO = 0;
-void renderCube(){
+void renderCube(int instanceCount){
     // initialize (if necessary)
     if (cubeVAO == 0){
         float vertices[] = {
@@ -933,6 +2465,49 @@ void renderCube(){
     }
     // render Cube
     glBindVertexArray(cubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, instanceCount);
+    rg::frameStats.drawCalls++;
     glBindVertexArray(0);
-}
\ No newline at end of file
+}
+
+//TRACER LIGHTS---------------------------------------------------------------------------------------------------------
+// Deterministic stream of tracer rounds from the air defence gun towards the planes, plus an occasional flak burst
+// around them. Every light is a pure function of its index and the time, so nothing has to be simulated or stored.
+void appendTracerLights(std::vector<rg::PointLightConstants> &lights, int count, float time){
+    const glm::vec3 gunPosition(115.0f, -9.0f, 34.0f);
+    const glm::vec3 targets[2] = {glm::vec3(-10.0f, 180.0f, 55.0f), glm::vec3(-18.0f, 180.0f, -241.0f)};
+    const float speed = 90.0f;
+    const float lifetime = 3.0f;
+
+    auto hash = [](unsigned int x) {
+        x ^= x >> 16; x *= 0x7feb352du;
+        x ^= x >> 15; x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return (x & 0xffffffu) / 16777216.0f;
+    };
+
+    for (int i = 0; i < count; i++) {
+        unsigned int seed = i * 4u;
+        rg::PointLightConstants light = {};
+        glm::vec3 target = targets[i & 1];
+        glm::vec3 spread(hash(seed) - 0.5f, hash(seed + 1) - 0.5f, hash(seed + 2) - 0.5f);
+        if (i % 16 == 0) {
+            // flak burst: flares up and fades out near the target
+            float phase = std::fmod(time / lifetime + hash(seed + 3), 1.0f);
+            float flash = (1.0f - phase) * (1.0f - phase);
+            light.position = target + spread * 120.0f;
+            light.diffuse = glm::vec3(40.0f, 18.0f, 5.0f) * flash;
+            light.specular = light.diffuse * 0.2f;
+            light.radius = 40.0f;
+        } else {
+            // tracer: flies from the gun along its own direction, restarting every lifetime seconds
+            float age = std::fmod(time + hash(seed + 3) * lifetime, lifetime);
+            glm::vec3 direction = glm::normalize(target + spread * 80.0f - gunPosition);
+            light.position = gunPosition + direction * (speed * age);
+            light.diffuse = glm::vec3(6.0f, 3.0f, 0.8f);
+            light.specular = light.diffuse * 0.2f;
+            light.radius = 8.0f;
+        }
+        lights.push_back(light);
+    }
+}